@@ -0,0 +1,549 @@
+#include "AsyncIo.hpp"
+#include "JobSystem.hpp"
+#include "FrameStats.hpp"
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+#ifdef __linux__
+	#include <linux/io_uring.h>
+	#include <sys/eventfd.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+	#include <sys/uio.h>
+	#include <cerrno>
+	#include <cstring>
+#endif
+
+AsyncIo::File::File(const char *fileName)
+{
+	#ifdef _WIN32
+		// Shared for deletion so a save can be renamed over the file while it is open
+		handle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) handle = nullptr;
+	#else
+		descriptor = open(fileName, O_RDONLY | O_CLOEXEC);
+	#endif
+	if (!IsOpen()) Log::Error(std::string("AsyncIo::File: Failed to open ") + fileName);
+}
+
+AsyncIo::File::~File()
+{
+	#ifdef _WIN32
+		if (handle) CloseHandle(handle);
+	#else
+		if (descriptor != -1) close(descriptor);
+	#endif
+}
+
+bool AsyncIo::File::IsOpen() const
+{
+	#ifdef _WIN32
+		return handle != nullptr;
+	#else
+		return descriptor != -1;
+	#endif
+}
+
+uint64_t AsyncIo::File::GetSize() const
+{
+	#ifdef _WIN32
+		LARGE_INTEGER size;
+		return GetFileSizeEx(handle, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+	#else
+		struct stat status;
+		return fstat(descriptor, &status) == 0 ? static_cast<uint64_t>(status.st_size) : 0;
+	#endif
+}
+
+bool AsyncIo::File::Read(uint64_t offset, void *data, uint64_t size) const
+{
+	uint8_t *bytes = static_cast<uint8_t*>(data);
+	while (size > 0) {
+		#ifdef _WIN32
+			OVERLAPPED overlapped = {};
+			overlapped.Offset     = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD read = 0;
+			if (!ReadFile(handle, bytes, static_cast<DWORD>(std::min<uint64_t>(size, 1u << 30)), &read, &overlapped) || read == 0) return false;
+		#else
+			const ssize_t read = pread(descriptor, bytes, size, static_cast<off_t>(offset));
+			if (read < 0 && errno == EINTR) continue;
+			if (read <= 0) return false;
+		#endif
+		bytes  += read;
+		offset += read;
+		size   -= read;
+	}
+	return true;
+}
+
+bool AsyncIo::File::ReadRows(uint64_t offset, uint64_t rowSize, uint64_t stride, uint64_t rowCount, void *data) const
+{
+	for (uint64_t row = 0; row < rowCount; row++) {
+		if (!Read(offset + (row * stride), static_cast<uint8_t*>(data) + (row * rowSize), rowSize)) return false;
+	}
+	return true;
+}
+
+namespace AsyncIo
+{
+	static const int      slotCount           = 32;         // Reads in flight at once, each with a buffer of its own
+	static const uint64_t bufferSize          = 128 * 1024; // Larger reads allocate a buffer while they are in flight
+	static const int      fallbackThreadCount = 4;
+
+	struct Request
+	{
+		std::shared_ptr<const File> file;
+		uint64_t                    offset;
+		uint64_t                    size;     // Of all rows together
+		uint64_t                    rowSize;
+		uint64_t                    stride;
+		uint32_t                    rowCount;
+		Completion                  completion;
+		std::chrono::steady_clock::time_point queueTime;
+	};
+
+	// Taken from when a read starts until its completion has run, or was dropped by the job system
+	struct Slot
+	{
+		Request              request;
+		uint32_t             nextRow  = 0; // Rows before it were submitted to the ring
+		uint32_t             rowsLeft = 0; // Rows not finished yet
+		bool                 failed   = false;
+		std::vector<uint8_t> largeBuffer;
+	};
+
+	static std::mutex              lock;
+	static std::condition_variable changed;
+	static std::deque<Request>     pending;
+	static std::array<Slot, slotCount> slots;
+	static std::vector<int>        freeSlots;
+	static std::vector<uint8_t>    buffers;       // One per slot
+	static int                     reading = 0;   // Slots whose completion has not been queued yet
+	static bool                    stopping = false;
+	static std::vector<std::thread> threads;
+
+	static uint64_t readCount      = 0;
+	static uint64_t totalLatency   = 0; // Nanoseconds
+	static uint64_t maxLatency     = 0;
+	static size_t   peakQueueDepth = 0;
+
+	static uint8_t *GetData(int slot)
+	{
+		return slots[slot].largeBuffer.empty() ? buffers.data() + (slot * bufferSize) : slots[slot].largeBuffer.data();
+	}
+
+	// Moves waiting reads into free slots, called with the lock held
+	static void TakePending(std::vector<int> &started, size_t limit)
+	{
+		while (!pending.empty() && !freeSlots.empty() && started.size() < limit) {
+			const int slot = freeSlots.back();
+			freeSlots.pop_back();
+			slots[slot].request = std::move(pending.front());
+			slots[slot].nextRow  = 0;
+			slots[slot].rowsLeft = slots[slot].request.rowCount;
+			slots[slot].failed   = false;
+			if (slots[slot].request.size > bufferSize) slots[slot].largeBuffer.resize(slots[slot].request.size);
+			pending.pop_front();
+			reading++;
+			started.push_back(slot);
+		}
+	}
+
+	static void Wake();
+
+	static void Release(int slot)
+	{
+		Request request;
+		std::vector<uint8_t> largeBuffer;
+		bool wake;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			request = std::move(slots[slot].request);
+			largeBuffer.swap(slots[slot].largeBuffer);
+			freeSlots.push_back(slot);
+			wake = !pending.empty();
+		}
+		changed.notify_all();
+		if (wake) Wake();
+	}
+
+	// The slot is released when the job has run, or when a stopping job system drops it
+	struct Lease
+	{
+		explicit Lease(int slot) : slot(slot) {}
+		~Lease() { Release(slot); }
+		Lease(const Lease &) = delete;
+		Lease &operator=(const Lease &) = delete;
+
+		const int slot;
+	};
+
+	static void Complete(int slot, bool succeeded)
+	{
+		const uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - slots[slot].request.queueTime).count();
+		FrameStats::AddReadLatency(latency);
+
+		const auto lease = std::make_shared<Lease>(slot);
+		const uint8_t *data = succeeded ? GetData(slot) : nullptr;
+		JobSystem::AddJob([lease, data]() {
+			PROFILE_ZONE("Read completion");
+			const Request &request = slots[lease->slot].request;
+			request.completion(data, data ? request.size : 0);
+		});
+
+		// Only once the job is queued, so JobSystem::WaitForIdle after WaitForIdle includes it
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			readCount++;
+			totalLatency += latency;
+			maxLatency    = std::max(maxLatency, latency);
+			reading--;
+		}
+		changed.notify_all();
+	}
+
+	// Blocking reads on a few threads, where io_uring is unavailable
+	static void ThreadLoop([[maybe_unused]] int index)
+	{
+		#ifdef PROFILER
+			const std::string threadName = "I/O " + std::to_string(index);
+			PROFILE_THREAD_NAME(threadName.c_str());
+		#endif
+		std::vector<int> started;
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			changed.wait(guard, []() { return stopping || (!pending.empty() && !freeSlots.empty()); });
+			if (stopping) break;
+			started.clear();
+			TakePending(started, 1); // One at a time, so the other threads pick up the rest
+			guard.unlock();
+			for (const int slot : started) {
+				const Request &request = slots[slot].request;
+				Complete(slot, request.file->ReadRows(request.offset, request.rowSize, request.stride, request.rowCount, GetData(slot)));
+			}
+			guard.lock();
+		}
+	}
+
+	#ifdef __linux__
+		// Row reads in flight stay below the entries, so with the wake read neither queue ever fills
+		static const unsigned ringEntries = 256;
+		static const unsigned maxInFlight = ringEntries - 1;
+		static const uint64_t wakeTag     = UINT64_MAX;
+
+		static int            ringDescriptor = -1;
+		static int            wakeDescriptor = -1;
+		static uint64_t       wakeValue;
+		static bool           wakeSignaled   = false; // A wake is on its way, so further ones are left out
+		static bool           registered     = false;
+		static void          *sqRing         = nullptr;
+		static void          *cqRing         = nullptr;
+		static size_t         sqRingSize     = 0;
+		static size_t         cqRingSize     = 0;
+		static size_t         sqesSize       = 0;
+		static io_uring_sqe  *sqes           = nullptr;
+		static unsigned      *sqTail;
+		static unsigned      *sqMask;
+		static unsigned      *sqArray;
+		static unsigned      *cqHead;
+		static unsigned      *cqTail;
+		static unsigned      *cqMask;
+		static io_uring_cqe  *cqes;
+		static unsigned       unsubmitted    = 0;
+		static unsigned       inFlight       = 0; // Row reads in the ring
+		static std::deque<int> submitting;        // Slots with rows left to submit, oldest first
+
+		static bool SetupRing()
+		{
+			io_uring_params params = {};
+			wakeSignaled   = false;
+			inFlight       = 0;
+			ringDescriptor = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &params));
+			if (ringDescriptor < 0) return false;
+
+			// Plain reads, which the wake and buffers that could not be registered use, came with the current position feature
+			if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+				close(ringDescriptor);
+				ringDescriptor = -1;
+				return false;
+			}
+
+			sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+			cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+			if (params.features & IORING_FEAT_SINGLE_MMAP) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+			sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_SQ_RING);
+			cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_CQ_RING);
+			sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			void *sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringDescriptor, IORING_OFF_SQES);
+			if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMemory == MAP_FAILED) {
+				Log::Error("AsyncIo::SetupRing: Failed to map the ring");
+				close(ringDescriptor);
+				ringDescriptor = -1;
+				return false;
+			}
+			sqes    = static_cast<io_uring_sqe*>(sqeMemory);
+			sqTail  = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(sqRing) + params.sq_off.tail);
+			sqMask  = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(sqRing) + params.sq_off.ring_mask);
+			sqArray = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(sqRing) + params.sq_off.array);
+			cqHead  = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(cqRing) + params.cq_off.head);
+			cqTail  = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(cqRing) + params.cq_off.tail);
+			cqMask  = reinterpret_cast<unsigned*>(static_cast<uint8_t*>(cqRing) + params.cq_off.ring_mask);
+			cqes    = reinterpret_cast<io_uring_cqe*>(static_cast<uint8_t*>(cqRing) + params.cq_off.cqes);
+
+			// Registered buffers are pinned once instead of on every read, plain reads into the same buffers are used if the kernel refuses
+			std::vector<iovec> vectors(slotCount);
+			for (int i = 0; i < slotCount; i++) vectors[i] = {buffers.data() + (i * bufferSize), bufferSize};
+			registered = syscall(__NR_io_uring_register, ringDescriptor, IORING_REGISTER_BUFFERS, vectors.data(), slotCount) == 0;
+
+			wakeDescriptor = eventfd(0, EFD_CLOEXEC);
+			return wakeDescriptor != -1;
+		}
+
+		static void CloseRing()
+		{
+			if (ringDescriptor == -1) return;
+			munmap(sqes, sqesSize);
+			if (cqRing != sqRing) munmap(cqRing, cqRingSize);
+			munmap(sqRing, sqRingSize);
+			close(ringDescriptor);
+			if (wakeDescriptor != -1) close(wakeDescriptor);
+			ringDescriptor = -1;
+			wakeDescriptor = -1;
+		}
+
+		static io_uring_sqe *GetSqe(uint64_t tag)
+		{
+			const unsigned tail  = *sqTail;
+			const unsigned index = tail & *sqMask;
+			io_uring_sqe *sqe = &sqes[index];
+			std::memset(sqe, 0, sizeof(*sqe));
+			sqe->user_data = tag;
+			sqArray[index] = index;
+			__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+			unsubmitted++;
+			return sqe;
+		}
+
+		// The tag holds the slot, the row and how much of the row was read already, so a short read continues where it stopped
+		static void PrepareRow(int slot, uint32_t row, uint32_t done)
+		{
+			const Request &request = slots[slot].request;
+			const bool fixed = registered && slots[slot].largeBuffer.empty();
+			io_uring_sqe *sqe = GetSqe(static_cast<uint64_t>(slot) | (static_cast<uint64_t>(row) << 8) | (static_cast<uint64_t>(done) << 32));
+			sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+			sqe->fd     = request.file->descriptor;
+			sqe->off    = request.offset + (row * request.stride) + done;
+			sqe->addr   = reinterpret_cast<uint64_t>(GetData(slot) + (row * request.rowSize) + done);
+			sqe->len    = static_cast<uint32_t>(request.rowSize - done);
+			if (fixed) sqe->buf_index = static_cast<uint16_t>(slot);
+			inFlight++;
+		}
+
+		static void SubmitRows()
+		{
+			while (!submitting.empty() && inFlight < maxInFlight) {
+				const int slot = submitting.front();
+				PrepareRow(slot, slots[slot].nextRow++, 0);
+				if (slots[slot].nextRow == slots[slot].request.rowCount) submitting.pop_front();
+			}
+		}
+
+		// A failed row skips the rows not submitted yet, the read completes once the rows in the ring have finished
+		static void FinishRow(int slot, bool succeeded)
+		{
+			Slot &state = slots[slot];
+			state.rowsLeft--;
+			if (!succeeded && !state.failed) {
+				state.failed    = true;
+				state.rowsLeft -= state.request.rowCount - state.nextRow;
+				state.nextRow   = state.request.rowCount;
+				submitting.erase(std::remove(submitting.begin(), submitting.end(), slot), submitting.end());
+			}
+			if (state.rowsLeft == 0) Complete(slot, !state.failed);
+		}
+
+		// Requests and released slots write to the eventfd, whose read is always in the ring, so the thread only ever waits in io_uring_enter
+		static void PrepareWake()
+		{
+			io_uring_sqe *sqe = GetSqe(wakeTag);
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd     = wakeDescriptor;
+			sqe->addr   = reinterpret_cast<uint64_t>(&wakeValue);
+			sqe->len    = sizeof(wakeValue);
+		}
+
+		static void RingLoop()
+		{
+			PROFILE_THREAD_NAME("I/O");
+			std::vector<int> started;
+			PrepareWake();
+			while (true) {
+				started.clear();
+				bool stopped;
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (!stopping) TakePending(started, slotCount);
+					stopped = stopping && reading == 0;
+				}
+				if (stopped) break;
+				for (const int slot : started) submitting.push_back(slot);
+				SubmitRows();
+
+				// Everything prepared since the last call is submitted with one system call
+				const int result = static_cast<int>(syscall(__NR_io_uring_enter, ringDescriptor, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+				if (result >= 0) unsubmitted -= std::min<unsigned>(unsubmitted, result);
+				else if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+					Log::Error(std::string("AsyncIo::RingLoop: io_uring_enter failed - ") + std::strerror(errno));
+					break;
+				}
+
+				unsigned head = *cqHead;
+				const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+				for (; head != tail; head++) {
+					const io_uring_cqe &cqe = cqes[head & *cqMask];
+					if (cqe.user_data == wakeTag) {
+						{
+							std::lock_guard<std::mutex> guard(lock);
+							wakeSignaled = false;
+						}
+						PrepareWake();
+						continue;
+					}
+
+					// Short reads continue where they stopped, a read that returns nothing has reached the end of the file
+					const int      slot = static_cast<int>(cqe.user_data & 0xFF);
+					const uint32_t row  = static_cast<uint32_t>((cqe.user_data >> 8) & 0xFFFFFF);
+					const uint32_t done = static_cast<uint32_t>(cqe.user_data >> 32);
+					inFlight--;
+					if (cqe.res > 0 && done + cqe.res < slots[slot].request.rowSize) PrepareRow(slot, row, done + cqe.res);
+					else if (cqe.res == -EAGAIN || cqe.res == -EINTR) PrepareRow(slot, row, done);
+					else FinishRow(slot, cqe.res > 0);
+				}
+				__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+				SubmitRows();
+			}
+		}
+	#endif
+
+	static void Wake()
+	{
+		#ifdef __linux__
+			if (ringDescriptor != -1) {
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (wakeSignaled) return;
+					wakeSignaled = true;
+				}
+				const uint64_t one = 1;
+				if (write(wakeDescriptor, &one, sizeof(one)) < 0) Log::Error("AsyncIo::Wake: Failed to signal the I/O thread");
+				return;
+			}
+		#endif
+		changed.notify_all();
+	}
+}
+
+void AsyncIo::Start(bool allowUring)
+{
+	stopping       = false;
+	readCount      = 0;
+	totalLatency   = 0;
+	maxLatency     = 0;
+	peakQueueDepth = 0;
+	buffers.resize(slotCount * bufferSize);
+	freeSlots.clear();
+	for (int i = slotCount - 1; i >= 0; i--) freeSlots.push_back(i);
+
+	#ifdef __linux__
+		if (allowUring && SetupRing()) {
+			threads.emplace_back(RingLoop);
+			Log::Info("AsyncIo: Reading with io_uring", {{"registeredBuffers", registered ? slotCount : 0}});
+			return;
+		}
+		CloseRing();
+	#endif
+	for (int i = 0; i < fallbackThreadCount; i++) threads.emplace_back(ThreadLoop, i);
+	Log::Info("AsyncIo: Reading on threads", {{"threads", fallbackThreadCount}});
+}
+
+void AsyncIo::Stop()
+{
+	std::deque<Request> dropped;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		dropped.swap(pending);
+	}
+	changed.notify_all();
+	#ifdef __linux__
+		if (ringDescriptor != -1) {
+			const uint64_t one = 1;
+			if (write(wakeDescriptor, &one, sizeof(one)) < 0) Log::Error("AsyncIo::Stop: Failed to signal the I/O thread");
+		}
+	#endif
+	for (std::thread &thread : threads) thread.join();
+	threads.clear();
+
+	// Completions that were queued hold their slot until the job system runs or drops them
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, []() { return freeSlots.size() == static_cast<size_t>(slotCount); });
+	}
+	#ifdef __linux__
+		CloseRing();
+	#endif
+	std::vector<uint8_t>().swap(buffers);
+}
+
+void AsyncIo::Read(std::shared_ptr<const File> file, uint64_t offset, uint64_t size, Completion completion)
+{
+	ReadRows(std::move(file), offset, size, size, 1, std::move(completion));
+}
+
+void AsyncIo::ReadRows(std::shared_ptr<const File> file, uint64_t offset, uint64_t rowSize, uint64_t stride, uint64_t rowCount, Completion completion)
+{
+	bool wake;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.push_back({std::move(file), offset, rowSize * rowCount, rowSize, stride, static_cast<uint32_t>(rowCount), std::move(completion), std::chrono::steady_clock::now()});
+		peakQueueDepth = std::max(peakQueueDepth, pending.size() + reading);
+		wake = !freeSlots.empty();
+	}
+	if (wake) Wake();
+}
+
+void AsyncIo::WaitForIdle()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, []() { return stopping || (pending.empty() && reading == 0); });
+}
+
+size_t AsyncIo::GetQueueDepth()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return pending.size() + reading;
+}
+
+void AsyncIo::LogReport()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	Log::Info("AsyncIo: Report", {{"reads", readCount}, {"peakQueueDepth", peakQueueDepth}, {"averageLatencyMs", readCount ? totalLatency / 1e6 / readCount : 0.0}, {"maxLatencyMs", maxLatency / 1e6}});
+}
\ No newline at end of file
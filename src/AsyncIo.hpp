@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// Reads files off the job system, so a read never blocks a worker. On Linux one thread submits the reads in batches to an io_uring that
+// reads into registered buffers, elsewhere or where io_uring is unavailable a few threads make blocking reads instead.
+// Each finished read is handed to the job system, which runs its completion with the bytes that were read
+namespace AsyncIo
+{
+	// Open for reading until the last reference is dropped, the file can be replaced on disk meanwhile
+	class File
+	{
+	public:
+		File(const char *fileName);
+		~File();
+
+		File(const File &) = delete;
+		File &operator=(const File &) = delete;
+
+		bool IsOpen() const;
+		bool Read(uint64_t offset, void *data, uint64_t size) const; // Blocking, false if fewer bytes were read
+		bool ReadRows(uint64_t offset, uint64_t rowSize, uint64_t stride, uint64_t rowCount, void *data) const; // Blocking, packs the rows
+		uint64_t GetSize() const; // Of the file that was opened, 0 if it cannot be queried
+
+		#ifdef _WIN32
+			void *handle = nullptr;
+		#else
+			int descriptor = -1;
+		#endif
+	};
+
+	// Runs on the job system with the bytes read, or with nullptr if the read failed or the file ended first. The data is only valid during the call
+	using Completion = std::function<void(const uint8_t *data, uint64_t size)>;
+
+	void Start(bool allowUring = true);
+	void Stop(); // Call before JobSystem::StopThreads, reads that have not started are dropped and the ones in flight are waited for
+
+	void Read(std::shared_ptr<const File> file, uint64_t offset, uint64_t size, Completion completion);
+
+	// Reads rowCount rows of rowSize bytes, each stride bytes after the one before, into one buffer with the rows packed back to back and
+	// hands them to one completion. Each row is a read of its own, so the bytes between rows are never read. Rows must be under 4GB
+	void ReadRows(std::shared_ptr<const File> file, uint64_t offset, uint64_t rowSize, uint64_t stride, uint64_t rowCount, Completion completion);
+
+	// Blocks until every read so far has been handed to the job system, JobSystem::WaitForIdle then waits for the completions
+	void WaitForIdle();
+
+	size_t GetQueueDepth(); // Reads waiting or in flight
+	void LogReport(); // Reads, the peak queue depth and the average and longest time from a read being requested to its completion being queued
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "BakeFile.hpp"
+#include "SaveFile.hpp"
+#include "AsyncIo.hpp"
+#include "Log.hpp"
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t seed;
+		uint32_t chunkCount;
+		uint32_t padding;
+	};
+
+	struct DirectoryEntry
+	{
+		int32_t  x;
+		int32_t  z;
+		uint32_t size;
+		uint32_t padding;
+		uint64_t offset;
+	};
+
+	// In front of each chunk's voxel runs, light runs and faces
+	struct ChunkHeader
+	{
+		uint32_t    runCount;
+		uint32_t    lightRunCount;
+		FaceOffsets faceOffsets;
+	};
+
+	const uint32_t magic   = 0x4B425856; // VXBK
+	const uint32_t version = 1;
+}
+
+// Light is mostly full sky above the terrain and dark below it, so its bytes are stored as runs just like the voxels
+static void EncodeBytes(const uint8_t *data, uint64_t size, std::vector<SaveFile::Run> &runs)
+{
+	runs.clear();
+	for (uint64_t i = 0; i < size; i++) {
+		if (!runs.empty() && runs.back().voxel == data[i] && runs.back().length < UINT16_MAX) runs.back().length++;
+		else runs.push_back({1, data[i], 0});
+	}
+}
+
+static bool DecodeBytes(const SaveFile::Run *runs, uint32_t runCount, uint8_t *data, uint64_t size)
+{
+	uint64_t position = 0;
+	for (uint32_t run = 0; run < runCount; run++) {
+		if (position + runs[run].length > size) return false;
+		memset(data + position, runs[run].voxel, runs[run].length);
+		position += runs[run].length;
+	}
+	return position == size;
+}
+
+void BakeFile::EncodeChunk(const WorldChunk::Snapshot &snapshot, const uint8_t *light, const std::vector<MeshFace> &faces, const FaceOffsets &faceOffsets, std::vector<uint8_t> &data)
+{
+	static thread_local std::vector<SaveFile::Run> runs;
+	static thread_local std::vector<SaveFile::Run> lightRuns;
+	SaveFile::EncodeRuns(snapshot, runs);
+	EncodeBytes(light, WorldChunk::lightBytes, lightRuns);
+
+	const ChunkHeader header    = {static_cast<uint32_t>(runs.size()), static_cast<uint32_t>(lightRuns.size()), faceOffsets};
+	const uint64_t    runBytes  = runs.size() * sizeof(SaveFile::Run);
+	const uint64_t    lightSize = lightRuns.size() * sizeof(SaveFile::Run);
+	data.resize(sizeof(header) + runBytes + lightSize + (faces.size() * sizeof(MeshFace)));
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + sizeof(header), runs.data(), runBytes);
+	memcpy(data.data() + sizeof(header) + runBytes, lightRuns.data(), lightSize);
+	memcpy(data.data() + sizeof(header) + runBytes + lightSize, faces.data(), faces.size() * sizeof(MeshFace));
+}
+
+bool BakeFile::DecodeChunk(const uint8_t *data, uint64_t size, DecodedChunk &chunk)
+{
+	static thread_local std::vector<uint8_t> light(WorldChunk::lightBytes);
+	if (size < sizeof(ChunkHeader)) return false;
+	ChunkHeader header;
+	memcpy(&header, data, sizeof(header));
+	for (size_t face = 0; face < static_cast<size_t>(Face::Count); face++) {
+		if (header.faceOffsets[face] > header.faceOffsets[face + 1]) return false;
+	}
+	const uint64_t runBytes  = static_cast<uint64_t>(header.runCount) * sizeof(SaveFile::Run);
+	const uint64_t lightSize = static_cast<uint64_t>(header.lightRunCount) * sizeof(SaveFile::Run);
+	const uint64_t faceBytes = static_cast<uint64_t>(header.faceOffsets.back()) * sizeof(MeshFace);
+	if (header.faceOffsets[0] != 0 || size != sizeof(header) + runBytes + lightSize + faceBytes) return false;
+
+	const uint8_t *runs = data + sizeof(header);
+	if (!SaveFile::DecodeSnapshot(runs, header.runCount, chunk.snapshot)) return false;
+	if (!DecodeBytes(reinterpret_cast<const SaveFile::Run*>(runs + runBytes), header.lightRunCount, light.data(), light.size())) return false;
+	chunk.light       = light.data();
+	chunk.faces       = reinterpret_cast<const MeshFace*>(runs + runBytes + lightSize);
+	chunk.faceOffsets = header.faceOffsets;
+	return true;
+}
+
+bool BakeFile::LoadDirectory(const char *fileName, const AsyncIo::File &file, uint32_t &seed, std::vector<std::pair<glm::ivec2, Location>> &locations)
+{
+	const uint64_t fileSize = file.GetSize();
+	Header header;
+	if (fileSize < sizeof(header) || !file.Read(0, &header, sizeof(header)) || header.magic != magic || header.version != version) {
+		Log::Error(std::string("BakeFile: ") + fileName + " is not a bake, or was baked by another version");
+		return false;
+	}
+	if (header.width != chunkWidth || header.height != chunkHeight || header.depth != chunkDepth) {
+		Log::Error(std::string("BakeFile: ") + fileName + " was baked with a different chunk size");
+		return false;
+	}
+
+	// Checked against the size of the file before the directory is allocated, and every chunk must lie within the file
+	if (fileSize - sizeof(Header) < (uint64_t)header.chunkCount * sizeof(DirectoryEntry)) {
+		Log::Error(std::string("BakeFile::LoadDirectory: ") + fileName + " is truncated");
+		return false;
+	}
+	std::vector<DirectoryEntry> directory(header.chunkCount);
+	if (!file.Read(sizeof(Header), directory.data(), directory.size() * sizeof(DirectoryEntry))) {
+		Log::Error(std::string("BakeFile::LoadDirectory: ") + fileName + " is truncated");
+		return false;
+	}
+	for (const DirectoryEntry &entry : directory) {
+		if (entry.offset > fileSize || fileSize - entry.offset < entry.size) {
+			Log::Error(std::string("BakeFile::LoadDirectory: ") + fileName + " has chunks beyond its end");
+			locations.clear();
+			return false;
+		}
+		locations.push_back({glm::ivec2(entry.x, entry.z), {entry.offset, entry.size}});
+	}
+	seed = header.seed;
+	return true;
+}
+
+// The directory is written last, once the offsets of the chunks are known
+BakeFile::Writer::Writer(const char *fileName, uint32_t seed, uint32_t chunkCount) : fileName(fileName), temporaryName(std::string(fileName) + ".tmp"), file(temporaryName, std::ios::binary | std::ios::trunc), chunkCount(chunkCount)
+{
+	const Header header = {magic, version, chunkWidth, chunkHeight, chunkDepth, seed, chunkCount, 0};
+	const std::vector<DirectoryEntry> directory(chunkCount);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DirectoryEntry));
+	offset = sizeof(Header) + (directory.size() * sizeof(DirectoryEntry));
+	locations.reserve(chunkCount);
+}
+
+BakeFile::Writer::~Writer()
+{
+	if (finished) return;
+	file.close();
+	std::error_code error;
+	std::filesystem::remove(temporaryName, error);
+}
+
+bool BakeFile::Writer::Add(const glm::ivec2 &coordinate, const std::vector<uint8_t> &data)
+{
+	if (locations.size() >= chunkCount) return false;
+	locations.push_back({coordinate, {offset, static_cast<uint32_t>(data.size())}});
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	offset += data.size();
+	return static_cast<bool>(file);
+}
+
+bool BakeFile::Writer::Finish()
+{
+	if (locations.size() != chunkCount) {
+		Log::Error("BakeFile::Writer: " + std::to_string(locations.size()) + " of " + std::to_string(chunkCount) + " chunks were added to " + fileName);
+		return false;
+	}
+	std::vector<DirectoryEntry> directory;
+	for (const auto &location : locations) directory.push_back({location.first.x, location.first.y, location.second.size, 0, location.second.offset});
+	file.seekp(sizeof(Header));
+	file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DirectoryEntry));
+	file.close();
+	if (!file) {
+		Log::Error("BakeFile::Writer: Failed to write " + temporaryName);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryName, fileName, error);
+	if (error) {
+		Log::Error("BakeFile::Writer: Failed to write " + fileName + " - " + error.message());
+		return false;
+	}
+	finished = true;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include "World.hpp"
+#include <glm/vec2.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace AsyncIo
+{
+	class File;
+}
+
+// Chunks baked offline with their voxels, light and exposed faces, so they are restored without being generated, lit or meshed.
+// A directory of where each chunk is follows the header, so chunks can be read one at a time as they are loaded
+namespace BakeFile
+{
+	// Of a chunk's record in a bake
+	struct Location
+	{
+		uint64_t offset = 0;
+		uint32_t size   = 0;
+	};
+
+	// The light and faces point into the record and into memory of the decoding thread, both are only valid until its next decode
+	struct DecodedChunk
+	{
+		WorldChunk::Snapshot snapshot;
+		const uint8_t       *light       = nullptr; // WorldChunk::lightBytes, as CopyLight writes them
+		const MeshFace      *faces       = nullptr;
+		FaceOffsets          faceOffsets = {};
+	};
+
+	// Voxels and light are stored as runs, the faces as they are
+	void EncodeChunk(const WorldChunk::Snapshot &snapshot, const uint8_t *light, const std::vector<MeshFace> &faces, const FaceOffsets &faceOffsets, std::vector<uint8_t> &data);
+	bool DecodeChunk(const uint8_t *data, uint64_t size, DecodedChunk &chunk); // False if the record is malformed
+
+	// Reads only the header and the directory
+	bool LoadDirectory(const char *fileName, const AsyncIo::File &file, uint32_t &seed, std::vector<std::pair<glm::ivec2, Location>> &locations);
+
+	// Writes chunks as they are added and the directory once the last one is, the bake only replaces an existing file once it is finished
+	class Writer
+	{
+	public:
+		Writer(const char *fileName, uint32_t seed, uint32_t chunkCount);
+		~Writer(); // Removes the unfinished file
+
+		Writer(const Writer &) = delete;
+		Writer &operator=(const Writer &) = delete;
+
+		bool IsOpen() const { return file.is_open(); }
+		bool Add(const glm::ivec2 &coordinate, const std::vector<uint8_t> &data);
+		bool Finish(); // False if a write failed or fewer chunks were added than the writer was created for
+
+		uint64_t GetSize() const { return offset; }
+	private:
+		std::string   fileName;
+		std::string   temporaryName;
+		std::ofstream file;
+		uint32_t      chunkCount;
+		uint64_t      offset   = 0;
+		bool          finished = false;
+		std::vector<std::pair<glm::ivec2, Location>> locations;
+	};
+}
\ No newline at end of file
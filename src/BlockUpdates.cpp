@@ -0,0 +1,270 @@
+#include "BlockUpdates.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "FrameStats.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <shared_mutex>
+
+static const glm::ivec2 sideOffsets[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+static uint8_t GetWaterVoxel(int level)
+{
+	return level > 0 ? waterVoxel + level - 1 : airVoxel;
+}
+
+static int GetWaterLevel(uint8_t voxel)
+{
+	if (voxel == airVoxel) return 0;
+	return IsWater(voxel) ? voxel - waterVoxel + 1 : waterLevels; // Solid voxels count as full so nothing flows into them
+}
+
+static bool IsGenerated(const WorldChunk &chunk)
+{
+	const ChunkState state = chunk.GetState();
+	return state != ChunkState::Queued && state != ChunkState::Generating && state != ChunkState::Evicting;
+}
+
+uint64_t BlockUpdates::GetKey(int x, int z)
+{
+	uint64_t key;
+	*(reinterpret_cast<int*>(&key) + 0) = x;
+	*(reinterpret_cast<int*>(&key) + 1) = z;
+	return key;
+}
+
+// Y is the most significant so sorted voxels update from the bottom up, and a falling column moves together
+uint32_t BlockUpdates::PackPosition(int x, int y, int z)
+{
+	return (static_cast<uint32_t>(y) << 16) | (static_cast<uint32_t>(z) << 8) | static_cast<uint32_t>(x);
+}
+
+void BlockUpdates::VoxelsChanged(int x, int z, const std::vector<glm::ivec3> &positions)
+{
+	std::lock_guard<std::mutex> guard(inputLock);
+	inputs.push_back({glm::ivec2(x, z), positions});
+}
+
+void BlockUpdates::Activate(const glm::ivec2 &coordinate, const glm::ivec3 &position)
+{
+	const glm::ivec3 world = position + glm::ivec3(coordinate.x * chunkWidth, 0, coordinate.y * chunkDepth);
+	for (int i = 0; i < 7; i++) {
+		const glm::ivec3 neighbour = i < 6 ? world + faceNormals[i] : world;
+		if (neighbour.y < 0 || neighbour.y >= chunkHeight) continue;
+		const int chunkX = (neighbour.x >= 0 ? neighbour.x : neighbour.x - chunkWidth + 1) / chunkWidth;
+		const int chunkZ = (neighbour.z >= 0 ? neighbour.z : neighbour.z - chunkDepth + 1) / chunkDepth;
+		ActiveChunk &entry = active[GetKey(chunkX, chunkZ)];
+		entry.coordinate = glm::ivec2(chunkX, chunkZ);
+		entry.voxels.push_back(PackPosition(neighbour.x - (chunkX * chunkWidth), neighbour.y, neighbour.z - (chunkZ * chunkDepth)));
+	}
+}
+
+std::vector<BlockUpdates::ChunkChanges> BlockUpdates::Tick(const ChunkLookup &lookup)
+{
+	PROFILE_ZONE("Block tick");
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<ChunkChanges> pending;
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		pending.swap(inputs);
+	}
+	for (const ChunkChanges &changes : pending) {
+		for (const glm::ivec3 &position : changes.positions) Activate(changes.coordinate, position);
+	}
+
+	// Active voxels in chunks that were unloaded are dropped, chunks that are still loading keep theirs
+	std::vector<ActiveChunk *> colours[4];
+	activeCount = 0;
+	for (auto it = active.begin(); it != active.end();) {
+		ActiveChunk &entry = it->second;
+		entry.chunk = lookup(entry.coordinate.x, entry.coordinate.y);
+		if (!entry.chunk) {
+			it = active.erase(it);
+			continue;
+		}
+		std::sort(entry.voxels.begin(), entry.voxels.end());
+		entry.voxels.erase(std::unique(entry.voxels.begin(), entry.voxels.end()), entry.voxels.end());
+		activeCount += entry.voxels.size();
+		for (int side = 0; side < 4; side++) {
+			entry.neighbours[side] = lookup(entry.coordinate.x + sideOffsets[side].x, entry.coordinate.y + sideOffsets[side].y);
+		}
+		colours[(entry.coordinate.x & 1) | ((entry.coordinate.y & 1) << 1)].push_back(&entry);
+		it++;
+	}
+
+	for (const auto &colour : colours) {
+		std::vector<JobSystem::Job> jobs;
+		for (ActiveChunk *entry : colour) jobs.push_back(std::bind(UpdateChunk, std::ref(*entry)));
+		JobSystem::RunBatch(jobs);
+	}
+
+	// Moves across borders are applied last and only if neither voxel changed since, so nothing is created or lost
+	std::map<uint64_t, ChunkChanges> changes;
+	std::vector<glm::ivec3> foreign;
+	for (auto &it : active) {
+		ActiveChunk &entry = it.second;
+		if (!entry.changed.empty()) {
+			ChunkChanges &chunkChanges = changes[it.first];
+			chunkChanges.coordinate = entry.coordinate;
+			chunkChanges.positions.insert(chunkChanges.positions.end(), entry.changed.begin(), entry.changed.end());
+		}
+		for (const Transfer &transfer : entry.transfers) {
+			const uint64_t targetKey = GetKey(transfer.targetChunk.x, transfer.targetChunk.y);
+			const auto target = lookup(transfer.targetChunk.x, transfer.targetChunk.y);
+			if (!target) continue;
+			{
+				// Locked in key order, the same as chunk updates
+				auto sourceGuard = std::unique_lock<std::shared_mutex>();
+				auto targetGuard = std::unique_lock<std::shared_mutex>();
+				if (it.first < targetKey) {
+					sourceGuard = entry.chunk->LockVoxels();
+					targetGuard = target->LockVoxels();
+				}
+				else {
+					targetGuard = target->LockVoxels();
+					sourceGuard = entry.chunk->LockVoxels();
+				}
+				const glm::ivec3 &s = transfer.source;
+				const glm::ivec3 &t = transfer.target;
+				if (entry.chunk->GetVoxel(s.x, s.y, s.z) != transfer.sourceBefore || target->GetVoxel(t.x, t.y, t.z) != transfer.targetBefore) continue;
+				entry.chunk->SetVoxel(s.x, s.y, s.z, transfer.sourceAfter);
+				target->SetVoxel(t.x, t.y, t.z, transfer.targetAfter);
+			}
+			ChunkChanges &sourceChanges = changes[it.first];
+			sourceChanges.coordinate = entry.coordinate;
+			sourceChanges.positions.push_back(transfer.source);
+			ChunkChanges &targetChanges = changes[targetKey];
+			targetChanges.coordinate = transfer.targetChunk;
+			targetChanges.positions.push_back(transfer.target);
+		}
+		for (const glm::ivec3 &position : entry.foreign) foreign.push_back(position);
+
+		entry.changed.clear();
+		entry.transfers.clear();
+		entry.foreign.clear();
+		entry.chunk.reset();
+		for (auto &neighbour : entry.neighbours) neighbour.reset();
+	}
+
+	// Transfers and moves next to a border wake voxels in other chunks, which only happens once no job can touch the map
+	for (const glm::ivec3 &position : foreign) {
+		const int chunkX = (position.x >= 0 ? position.x : position.x - chunkWidth + 1) / chunkWidth;
+		const int chunkZ = (position.z >= 0 ? position.z : position.z - chunkDepth + 1) / chunkDepth;
+		ActiveChunk &entry = active[GetKey(chunkX, chunkZ)];
+		entry.coordinate = glm::ivec2(chunkX, chunkZ);
+		entry.voxels.push_back(PackPosition(position.x - (chunkX * chunkWidth), position.y, position.z - (chunkZ * chunkDepth)));
+	}
+	std::vector<ChunkChanges> result;
+	for (auto &it : changes) result.push_back(std::move(it.second));
+	for (const ChunkChanges &chunkChanges : result) {
+		for (const glm::ivec3 &position : chunkChanges.positions) Activate(chunkChanges.coordinate, position);
+	}
+	for (auto it = active.begin(); it != active.end();) {
+		if (it->second.voxels.empty()) it = active.erase(it);
+		else it++;
+	}
+
+	const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	FrameStats::AddBlockTick(elapsed, activeCount);
+	PROFILE_GAUGE(ActiveVoxels, activeCount);
+	return result;
+}
+
+// Only touches this chunk's voxels and entry, neighbours are read but never written
+void BlockUpdates::UpdateChunk(ActiveChunk &entry)
+{
+	WorldChunk &chunk = *entry.chunk;
+	// Own chunk and neighbours are locked in key order, so a reader elsewhere can never deadlock against an update
+	std::unique_lock<std::shared_mutex> guard;
+	std::shared_lock<std::shared_mutex> neighbourGuards[4];
+	std::array<int, 5> order = {0, 1, 2, 3, 4};
+	std::array<uint64_t, 5> keys;
+	for (int side = 0; side < 4; side++) keys[side] = GetKey(entry.coordinate.x + sideOffsets[side].x, entry.coordinate.y + sideOffsets[side].y);
+	keys[4] = GetKey(entry.coordinate.x, entry.coordinate.y);
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+	for (const int side : order) {
+		if (side == 4) guard = chunk.LockVoxels();
+		else if (entry.neighbours[side]) neighbourGuards[side] = entry.neighbours[side]->LockVoxelsShared();
+	}
+	if (!IsGenerated(chunk)) return; // Tried again next tick
+
+	bool neighbourReady[4] = {};
+	for (int side = 0; side < 4; side++) neighbourReady[side] = entry.neighbours[side] && IsGenerated(*entry.neighbours[side]);
+
+	// Chunks that are not loaded yet read as solid, so nothing flows off the edge of the world
+	const auto read = [&](int x, int y, int z) -> uint8_t {
+		if (y < 0)            return stoneVoxel;
+		if (y >= chunkHeight) return airVoxel;
+		const int side = x < 0 ? 0 : (x >= chunkWidth ? 1 : (z < 0 ? 2 : (z >= chunkDepth ? 3 : -1)));
+		if (side < 0) return chunk.GetVoxel(x, y, z);
+		if (!neighbourReady[side]) return stoneVoxel;
+		return entry.neighbours[side]->GetVoxel(x - (sideOffsets[side].x * chunkWidth), y, z - (sideOffsets[side].y * chunkDepth));
+	};
+
+	const auto write = [&](int x, int y, int z, uint8_t voxel) {
+		chunk.SetVoxel(x, y, z, voxel);
+		entry.changed.push_back(glm::ivec3(x, y, z));
+		for (int i = 0; i < 7; i++) {
+			const glm::ivec3 neighbour = i < 6 ? glm::ivec3(x, y, z) + faceNormals[i] : glm::ivec3(x, y, z);
+			if (neighbour.y < 0 || neighbour.y >= chunkHeight) continue;
+			if (neighbour.x >= 0 && neighbour.z >= 0 && neighbour.x < chunkWidth && neighbour.z < chunkDepth) {
+				entry.voxels.push_back(PackPosition(neighbour.x, neighbour.y, neighbour.z));
+			}
+			else {
+				entry.foreign.push_back(neighbour + glm::ivec3(entry.coordinate.x * chunkWidth, 0, entry.coordinate.y * chunkDepth));
+			}
+		}
+	};
+
+	std::vector<uint32_t> current;
+	current.swap(entry.voxels);
+	for (const uint32_t packed : current) {
+		const int x = packed & 0xFF;
+		const int z = (packed >> 8) & 0xFF;
+		const int y = packed >> 16;
+		const uint8_t voxel = chunk.GetVoxel(x, y, z);
+
+		// Sand sinks through air and water, pushing the water up
+		if (voxel == sandVoxel) {
+			const uint8_t below = read(x, y - 1, z);
+			if (below == airVoxel || IsWater(below)) {
+				write(x, y - 1, z, sandVoxel);
+				write(x, y, z, below);
+			}
+			continue;
+		}
+		if (!IsWater(voxel)) continue;
+
+		// Water pours down as far as the voxel below can hold
+		int level = GetWaterLevel(voxel);
+		const int belowLevel = GetWaterLevel(read(x, y - 1, z));
+		if (belowLevel < waterLevels) {
+			const int amount = std::min(level, waterLevels - belowLevel);
+			write(x, y - 1, z, GetWaterVoxel(belowLevel + amount));
+			write(x, y, z, GetWaterVoxel(level - amount));
+			continue;
+		}
+
+		// Then spreads one level at a time to neighbours at least two levels lower, so a puddle levels out and stops
+		for (const glm::ivec2 &offset : sideOffsets) {
+			if (level <= 1) break;
+			const int nX = x + offset.x;
+			const int nZ = z + offset.y;
+			const uint8_t neighbour      = read(nX, y, nZ);
+			const int     neighbourLevel = GetWaterLevel(neighbour);
+			if (neighbourLevel >= level - 1) continue;
+			if (nX >= 0 && nZ >= 0 && nX < chunkWidth && nZ < chunkDepth) {
+				write(nX, y, nZ, GetWaterVoxel(neighbourLevel + 1));
+				write(x, y, z, GetWaterVoxel(--level));
+			}
+			else {
+				const glm::ivec2 targetChunk = entry.coordinate + offset;
+				const glm::ivec3 target(nX - (offset.x * chunkWidth), y, nZ - (offset.y * chunkDepth));
+				entry.transfers.push_back({entry.coordinate, glm::ivec3(x, y, z), voxel, GetWaterVoxel(level - 1), targetChunk, target, neighbour, GetWaterVoxel(neighbourLevel + 1)});
+				break; // The voxel itself only changes once the transfer is applied
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include "World.hpp"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Falling sand and cellular automaton water, ticked at a fixed rate by the world thread. Only voxels that changed or
+// had a neighbour change are active, and chunks without active voxels are never visited
+class BlockUpdates
+{
+public:
+	static constexpr float tickInterval = 1.0f / 20.0f;
+
+	struct ChunkChanges
+	{
+		glm::ivec2              coordinate;
+		std::vector<glm::ivec3> positions; // Local to the chunk
+	};
+
+	using ChunkLookup = std::function<std::shared_ptr<WorldChunk>(int x, int z)>;
+
+	// Can be called from any thread, positions are local to the chunk
+	void VoxelsChanged(int x, int z, const std::vector<glm::ivec3> &positions);
+
+	// Chunks are split into a checkerboard of four colours and one colour at a time is updated in parallel, so no two
+	// neighbours are ever updated at once. Moves into another chunk are applied after every colour is done
+	std::vector<ChunkChanges> Tick(const ChunkLookup &lookup);
+
+	uint64_t GetActiveCount() const { return activeCount; }
+private:
+	struct Transfer
+	{
+		glm::ivec2 sourceChunk;
+		glm::ivec3 source;
+		uint8_t    sourceBefore;
+		uint8_t    sourceAfter;
+		glm::ivec2 targetChunk;
+		glm::ivec3 target;
+		uint8_t    targetBefore;
+		uint8_t    targetAfter;
+	};
+
+	// Written only by the job updating the chunk, or by the world thread between colours
+	struct ActiveChunk
+	{
+		glm::ivec2                  coordinate;
+		std::vector<uint32_t>       voxels;  // Packed by PackPosition, sorted so lower voxels update first
+		std::vector<glm::ivec3>     changed;
+		std::vector<Transfer>       transfers;
+		std::vector<glm::ivec3>     foreign; // World positions to activate in other chunks
+		std::shared_ptr<WorldChunk> chunk;
+		std::shared_ptr<WorldChunk> neighbours[4];
+	};
+
+	std::mutex                          inputLock;
+	std::vector<ChunkChanges>           inputs;
+	std::map<uint64_t, ActiveChunk>     active;
+	uint64_t                            activeCount = 0;
+
+	static uint64_t GetKey(int x, int z);
+	static uint32_t PackPosition(int x, int y, int z);
+
+	void Activate(const glm::ivec2 &coordinate, const glm::ivec3 &position); // Also activates the neighbours, local position
+	static void UpdateChunk(ActiveChunk &chunk);
+};
\ No newline at end of file
@@ -1,16 +1,30 @@
 #pragma once
-#include "VertexBuffer.hpp"
+#include "Profiler.hpp"
+#include "UploadManager.hpp"
+#include "MemoryManager.hpp"
+#include "VoxelLayout.hpp"
+#include "Pool.hpp"
+#include <glm/vec3.hpp>
 #include <vector>
 #include <array>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
 
 // TODO: Greedy meshing
 
+class VertexBuffer;
+
 struct Vertex
 {
 	uint8_t pX, pY, pZ; // Position
 	int8_t  nX, nY, nZ; // Normal
 	int8_t  tX, tY, tZ;     // Texture coordinate
+	uint8_t light = 0;      // Sky light in the high nibble, block light in the low one, set per face when meshing
 
 	Vertex operator+(const glm::vec3 &pos) const
 	{
@@ -19,7 +33,8 @@ struct Vertex
 			(uint8_t)(this->pY + pos.y),
 			(uint8_t)(this->pZ + pos.z),
 			this->nX, this->nY, this->nZ,
-			this->tX, this->tY, this->tZ
+			this->tX, this->tY, this->tZ,
+			this->light
 		};
 	}
 };
@@ -78,108 +93,519 @@ const std::array<Vertex, 6> topFace = {
 	Vertex{0, 1, 0,  0,  1,  0, 0,  0,  0}
 };
 
-template<int Width, int Height, int Depth, typename VoxelType, VoxelType NullVoxel>
+// Meshes are grouped by face direction in this order, so a direction that faces away from the camera can be skipped as a whole
+enum struct Face : uint8_t
+{
+	Back,
+	Front,
+	Left,
+	Right,
+	Bottom,
+	Top,
+	Count
+};
+
+const std::array<const std::array<Vertex, 6> *, 6> faceVertices = {&backFace, &frontFace, &leftFace, &rightFace, &bottomFace, &topFace};
+const std::array<glm::ivec3, 6> faceNormals = {
+	glm::ivec3( 0,  0, -1),
+	glm::ivec3( 0,  0,  1),
+	glm::ivec3(-1,  0,  0),
+	glm::ivec3( 1,  0,  0),
+	glm::ivec3( 0, -1,  0),
+	glm::ivec3( 0,  1,  0)
+};
+
+// First face or vertex of each face direction, the last entry is the count
+using FaceOffsets = std::array<uint32_t, static_cast<size_t>(Face::Count) + 1>;
+
+// An exposed face and the light it takes, meshes are baked as these and expanded into the face's vertices when they are built
+struct MeshFace
+{
+	uint8_t x, y, z;
+	uint8_t light;
+};
+
+// Queued -> Generating -> Meshing -> ReadyToUpload -> Resident, edits go back to Meshing and any state without a job in flight can move to Evicting
+enum struct ChunkState : uint8_t
+{
+	Queued,
+	Generating,
+	Meshing,
+	ReadyToUpload,
+	Resident,
+	Evicting
+};
+
+// Vertices are only kept in system memory when they could not be staged for upload
+struct ChunkMesh
+{
+	std::vector<Vertex>       vertices;
+	uint64_t                  vertexCount = 0;
+	uint64_t                  generation  = 0;
+	UploadManager::Allocation staging;
+
+	FaceOffsets               faceOffsets = {};
+
+	// Set by the renderer before any chunk is meshed, worlds that are never drawn leave them unset and keep every mesh in system memory
+	static inline bool (*allocateStaging)(uint64_t size, UploadManager::Allocation &allocation) = nullptr;
+	static inline void (*releaseStaging)(UploadManager::Allocation &allocation)                  = nullptr;
+
+	~ChunkMesh()
+	{
+		if (staging.id != 0) releaseStaging(staging);
+		MemoryManager::Free(MemoryManager::Category::Meshes, vertices.capacity() * sizeof(Vertex));
+	}
+};
+
+template<int Width, int Height, int Depth, typename VoxelType, VoxelType NullVoxel, template<int, int, int> class Layout = LinearLayout>
 class Chunk
 {
 public:
+	using VoxelLayout = Layout<Width, Height, Depth>;
+
+	static const int width  = Width;
+	static const int height = Height;
+	static const int depth  = Depth;
+
+	// Voxels are stored in sections of contiguous storage that snapshots share with the chunk
+	static const int      sectionCount = 16;
+	static const uint64_t sectionSize  = (VoxelLayout::size + sectionCount - 1) / sectionCount;
+
+	// Point in time copy of a chunk's voxels that shares its sections, a section is only copied when the chunk writes to it while a snapshot holds it
+	class Snapshot
+	{
+	public:
+		VoxelType GetVoxel(int x, int y, int z) const
+		{
+			const uint64_t index = VoxelLayout::Index(x, y, z);
+			return sections[index / sectionSize][index % sectionSize];
+		}
+
+		// Builds a snapshot that no chunk holds, the function is called with (x, y, z) and returns the voxel
+		template<typename Function>
+		static Snapshot Create(Function &&function)
+		{
+			Snapshot snapshot;
+			std::array<VoxelType *, sectionCount> voxels; // Written through plain pointers, so filling never touches the reference counts
+			for (int section = 0; section < sectionCount; section++) {
+				auto allocated = AllocateSection();
+				voxels[section] = allocated.get();
+				snapshot.sections[section] = std::move(allocated);
+			}
+			VoxelLayout::ForEach([&](int x, int y, int z, uint64_t index) {
+				voxels[index / sectionSize][index % sectionSize] = function(x, y, z);
+			});
+			return snapshot;
+		}
+	private:
+		friend class Chunk;
+		std::array<std::shared_ptr<const VoxelType[]>, sectionCount> sections;
+	};
+
+	// Chunks can be created and destroyed on any thread, their vertex buffer only exists on the render thread and is deleted there
 	Chunk()
 	{
-		vertexBuffer = new VertexBuffer({VertexType::Uint8_3, VertexType::Int8_3, VertexType::Int8_3});
-		UpdateVertices();
+		MemoryManager::Allocate(MemoryManager::Category::Voxels, lightBytes);
+		for (auto &section : sections) section = AllocateSection();
+		memset(borderLight, 0xF0, sizeof(borderLight)); // Open sky until the neighbours are lit
 	}
 
 	~Chunk()
 	{
-		delete vertexBuffer;
+		MemoryManager::Free(MemoryManager::Category::Voxels, lightBytes);
+		if (vertexBuffer) {
+			std::lock_guard<std::mutex> guard(unusedBufferLock);
+			unusedBuffers.push_back(vertexBuffer);
+		}
+	}
+
+	// Buffers of the chunks destroyed since the last call, for the render thread to delete
+	static void TakeUnusedBuffers(std::vector<VertexBuffer *> &buffers)
+	{
+		std::lock_guard<std::mutex> guard(unusedBufferLock);
+		buffers.swap(unusedBuffers);
 	}
 
+	ChunkState GetState() const
+	{
+		return static_cast<ChunkState>(status.load(std::memory_order_acquire) & stateMask);
+	}
+
+	// Whoever moves the chunk out of a state owns it until they move it on, voxels may only be touched by the owner of Generating or Meshing,
+	// or by block updates holding the voxel lock once the chunk is generated
+	bool TransitionState(ChunkState from, ChunkState to)
+	{
+		uint64_t expected = status.load(std::memory_order_acquire);
+		if ((expected & stateMask) != static_cast<uint64_t>(from)) return false;
+		return status.compare_exchange_strong(expected, (expected & ~stateMask) | static_cast<uint64_t>(to), std::memory_order_acq_rel);
+	}
+
+	// Builds the mesh into a new buffer and publishes it, the previous mesh stays valid for the render thread. Requires the Meshing state and leaves the chunk ReadyToUpload, or Resident when meshing is off or the chunk is not drawn
 	void UpdateVertices()
 	{
-		vertices.clear();
-		for (int y = 0; y < Height; y++) {
-			for (int z = 0; z < Depth; z++) {
-				for (int x = 0; x < Width; x++) {
-					// Back
-					if (TestPos(x, y, z) && !TestPos(x, y, z - 1)) {
-						for (const auto &vertex : backFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
-
-					// Front
-					if (TestPos(x, y, z) && !TestPos(x, y, z + 1)) {
-						for (const auto &vertex : frontFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
-
-					// Left
-					if (TestPos(x, y, z) && !TestPos(x - 1, y, z)) {
-						for (const auto &vertex : leftFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
-
-					// Right
-					if (TestPos(x, y, z) && !TestPos(x + 1, y, z)) {
-						for (const auto &vertex : rightFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
-
-					// Bottom
-					if (TestPos(x, y, z) && !TestPos(x, y - 1, z)) {
-						for (const auto &vertex : bottomFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
-
-					// Top
-					if (TestPos(x, y, z) && !TestPos(x, y + 1, z)) {
-						for (const auto &vertex : topFace) {
-							vertices.emplace_back(vertex + glm::vec3(x, y, z));
-						}
-					}
+		if (!meshing || !drawn.load(std::memory_order_relaxed)) {
+			PublishFaces(nullptr, {});
+			return;
+		}
+		PROFILE_ZONE("Mesh chunk");
+		std::vector<MeshFace> &faces = faceScratch; // Keeps its capacity, so steady state meshing never allocates it
+		FaceOffsets faceOffsets;
+		BuildFaces(faces, faceOffsets);
+		PublishFaces(faces.data(), faceOffsets);
+		PROFILE_COUNTER(ChunksMeshed, 1);
+	}
+
+	// Exposed faces grouped by direction in voxel storage order, takes the voxel lock shared since light can change meanwhile
+	void BuildFaces(std::vector<MeshFace> &faces, FaceOffsets &faceOffsets) const
+	{
+		std::vector<ExposedVoxel> &exposed = exposedScratch;
+		exposed.clear();
+		std::array<uint32_t, static_cast<size_t>(Face::Count)> faceCounts = {};
+		auto guard = LockVoxelsShared();
+		// Counting the exposed faces first lets every face be written once, straight to where it belongs.
+		// Storage order keeps the voxel and most of its neighbours in cache whichever layout is used
+		VoxelLayout::ForEach([&](int x, int y, int z, uint64_t index) {
+			if (sections[index / sectionSize][index % sectionSize] == NullVoxel) return;
+			uint8_t mask = 0;
+			for (size_t face = 0; face < faceCounts.size(); face++) {
+				if (TestNeighbour(index, x, y, z, static_cast<Face>(face))) continue;
+				mask |= 1 << face;
+				faceCounts[face]++;
+			}
+			if (mask) exposed.push_back({(uint8_t)x, (uint8_t)y, (uint8_t)z, mask});
+		});
+
+		uint32_t faceCount = 0;
+		for (size_t face = 0; face < faceCounts.size(); face++) {
+			faceOffsets[face] = faceCount;
+			faceCount += faceCounts[face];
+		}
+		faceOffsets[faceCounts.size()] = faceCount;
+		faces.resize(faceCount);
+
+		std::array<uint32_t, static_cast<size_t>(Face::Count)> next;
+		std::copy(faceOffsets.begin(), faceOffsets.begin() + next.size(), next.begin());
+		for (const ExposedVoxel &voxel : exposed) {
+			for (size_t face = 0; face < next.size(); face++) {
+				if (!(voxel.faces & (1 << face))) continue;
+				const glm::ivec3 &normal = faceNormals[face];
+				// Faces take the light of the empty voxel they face
+				faces[next[face]++] = {voxel.x, voxel.y, voxel.z, GetFaceLight(voxel.x + normal.x, voxel.y + normal.y, voxel.z + normal.z)};
+			}
+		}
+	}
+
+	// Expands faces from BuildFaces, or baked ones, into a new mesh and publishes it. Requires the Meshing state and leaves the chunk
+	// ReadyToUpload, or Resident without looking at the faces when meshing is off or the chunk is not drawn
+	void PublishFaces(const MeshFace *faces, const FaceOffsets &faceOffsets)
+	{
+		const bool deferred = meshing && !drawn.load(std::memory_order_relaxed);
+		meshDeferred.store(deferred, std::memory_order_relaxed);
+		if (deferred) std::atomic_store_explicit(&publishedMesh, std::shared_ptr<const ChunkMesh>(), std::memory_order_release); // Never uploaded now
+		if (!meshing || deferred) {
+			status.store((status.load(std::memory_order_relaxed) & ~stateMask) | static_cast<uint64_t>(ChunkState::Resident), std::memory_order_release);
+			return;
+		}
+		const auto mesh = std::allocate_shared<ChunkMesh>(Pool::Allocator<ChunkMesh>());
+		uint32_t vertexCount = 0;
+		for (size_t face = 0; face < static_cast<size_t>(Face::Count); face++) {
+			mesh->faceOffsets[face] = vertexCount;
+			vertexCount += (faceOffsets[face + 1] - faceOffsets[face]) * faceVertices[face]->size();
+		}
+		mesh->faceOffsets[static_cast<size_t>(Face::Count)] = vertexCount;
+		mesh->vertexCount = vertexCount;
+		mesh->generation  = (status.load(std::memory_order_relaxed) >> generationShift) + 1;
+		Vertex *vertices;
+		if (ChunkMesh::allocateStaging && ChunkMesh::allocateStaging(vertexCount * sizeof(Vertex), mesh->staging)) vertices = static_cast<Vertex *>(mesh->staging.data);
+		else {
+			mesh->vertices.resize(vertexCount);
+			vertices = mesh->vertices.data();
+			MemoryManager::Allocate(MemoryManager::Category::Meshes, mesh->vertices.capacity() * sizeof(Vertex));
+		}
+
+		for (size_t face = 0; face < static_cast<size_t>(Face::Count); face++) {
+			for (uint32_t i = faceOffsets[face]; i < faceOffsets[face + 1]; i++) {
+				const MeshFace &meshFace = faces[i];
+				for (const auto &vertex : *faceVertices[face]) {
+					Vertex &added = *vertices++;
+					added = vertex + glm::vec3(meshFace.x, meshFace.y, meshFace.z);
+					added.light = meshFace.light;
 				}
 			}
 		}
-		updated = false;
+
+		std::atomic_store_explicit(&publishedMesh, std::shared_ptr<const ChunkMesh>(mesh), std::memory_order_release);
+		status.store((mesh->generation << generationShift) | static_cast<uint64_t>(ChunkState::ReadyToUpload), std::memory_order_release);
 	}
 
-	void Render()
+	// 0 if the chunk was never meshed
+	uint64_t GetMeshGeneration() const
 	{
-		if (!updated) {
-			vertexBuffer->UpdateVertices(vertices.data(), vertices.size());
-			updated  = true;
+		return status.load(std::memory_order_acquire) >> generationShift;
+	}
+
+	// The newest mesh while it waits to be uploaded, the published mesh can be newer than the state that was read but never older
+	std::shared_ptr<const ChunkMesh> GetPublishedMesh() const
+	{
+		return std::atomic_load_explicit(&publishedMesh, std::memory_order_acquire);
+	}
+
+	// Called by the renderer once the mesh of this generation is in the vertex buffer, which holds the only copy that is needed from then on.
+	// Does nothing if the chunk was remeshed in the meantime, the newer mesh is uploaded next frame
+	void FinishUpload(uint64_t generation)
+	{
+		uint64_t expected = status.load(std::memory_order_acquire);
+		if ((expected & stateMask) != static_cast<uint64_t>(ChunkState::ReadyToUpload) || (expected >> generationShift) != generation) return;
+		const uint64_t resident = (expected & ~stateMask) | static_cast<uint64_t>(ChunkState::Resident);
+		if (!status.compare_exchange_strong(expected, resident, std::memory_order_acq_rel)) return;
+		auto mesh = GetPublishedMesh();
+		if (mesh && mesh->generation == generation) {
+			std::atomic_compare_exchange_strong(&publishedMesh, &mesh, std::shared_ptr<const ChunkMesh>());
 		}
-		vertexBuffer->Render();
 	}
 
 	void SetVoxel(int x, int y, int z, VoxelType voxel)
 	{
 		if (x < 0 || y < 0 || z < 0 || x >= Width || y >= Height || z >= Depth) return;
-		const uint64_t index = (y * Width * Depth) + (z * Width) + x;
-		voxels[index] = voxel;
+		const uint64_t index   = VoxelLayout::Index(x, y, z);
+		const uint64_t section = index / sectionSize;
+		if (sharedSections.load(std::memory_order_acquire) & (1u << section)) UnshareSection(section);
+		sections[section][index % sectionSize] = voxel;
 	}
 
-	bool TestPos(int x, int y, int z)
+	bool TestPos(int x, int y, int z) const
 	{
 		if (x < 0 || y < 0 || z < 0 || x >= Width || y >= Height || z >= Depth) return false;
-		const uint64_t index = (y * Width * Depth) + (z * Width) + x;
-		return (voxels[index] != NullVoxel);
+		const uint64_t index = VoxelLayout::Index(x, y, z);
+		return (sections[index / sectionSize][index % sectionSize] != NullVoxel);
+	}
+
+	// TestPos for the voxel across a face of the one at index, stepped to through the layout instead of indexed from its position
+	bool TestNeighbour(uint64_t index, int x, int y, int z, Face face) const
+	{
+		const glm::ivec3 position = glm::ivec3(x, y, z) + faceNormals[static_cast<size_t>(face)];
+		if (position.x < 0 || position.y < 0 || position.z < 0 || position.x >= Width || position.y >= Height || position.z >= Depth) return false;
+		const uint64_t neighbour = VoxelLayout::Neighbour(index, x, y, z, static_cast<int>(face));
+		return (sections[neighbour / sectionSize][neighbour % sectionSize] != NullVoxel);
+	}
+
+	VoxelType GetVoxel(int x, int y, int z) const
+	{
+		if (x < 0 || y < 0 || z < 0 || x >= Width || y >= Height || z >= Depth) return NullVoxel;
+		const uint64_t index = VoxelLayout::Index(x, y, z);
+		return sections[index / sectionSize][index % sectionSize];
+	}
+
+	// Copies nothing, so it is cheap enough to take while holding the voxel lock shared
+	Snapshot TakeSnapshot() const
+	{
+		Snapshot snapshot;
+		for (int section = 0; section < sectionCount; section++) snapshot.sections[section] = sections[section];
+		sharedSections.fetch_or((1u << sectionCount) - 1, std::memory_order_acq_rel);
+		return snapshot;
+	}
+
+	// Shares the snapshot's sections, requires the voxel lock
+	void RestoreSnapshot(const Snapshot &snapshot)
+	{
+		for (int section = 0; section < sectionCount; section++) sections[section] = std::const_pointer_cast<VoxelType[]>(snapshot.sections[section]);
+		sharedSections.store((1u << sectionCount) - 1, std::memory_order_release);
+	}
+
+	// Light levels go from 0 to 15, both are stored as nibbles
+	uint8_t GetSkyLight(int x, int y, int z) const
+	{
+		return GetNibble(skyLight, VoxelLayout::Index(x, y, z));
+	}
+
+	uint8_t GetBlockLight(int x, int y, int z) const
+	{
+		return GetNibble(blockLight, VoxelLayout::Index(x, y, z));
+	}
+
+	void SetSkyLight(int x, int y, int z, uint8_t level)
+	{
+		SetNibble(skyLight, VoxelLayout::Index(x, y, z), level);
+	}
+
+	void SetBlockLight(int x, int y, int z, uint8_t level)
+	{
+		SetNibble(blockLight, VoxelLayout::Index(x, y, z), level);
+	}
+
+	// Light of the neighbouring chunks along each side (-X, +X, -Z, +Z) packed like Vertex::light, indexed by y and then by z or x
+	uint8_t GetBorderLight(int side, int y, int i) const
+	{
+		return borderLight[side][(y * borderLength) + i];
+	}
+
+	void SetBorderLight(int side, int y, int i, uint8_t light)
+	{
+		borderLight[side][(y * borderLength) + i] = light;
 	}
 
-	std::mutex lock;
-	bool       modified = false; // Set to true to prevent chunks from being unloaded
+	// All of the chunk's light, sky, block and border, as lightBytes bytes. Baked chunks are restored with the light they were baked with
+	void CopyLight(uint8_t *data) const
+	{
+		memcpy(data, skyLight, sizeof(skyLight));
+		memcpy(data + sizeof(skyLight), blockLight, sizeof(blockLight));
+		memcpy(data + sizeof(skyLight) + sizeof(blockLight), borderLight, sizeof(borderLight));
+	}
+
+	void RestoreLight(const uint8_t *data)
+	{
+		memcpy(skyLight, data, sizeof(skyLight));
+		memcpy(blockLight, data + sizeof(skyLight), sizeof(blockLight));
+		memcpy(borderLight, data + sizeof(skyLight) + sizeof(blockLight), sizeof(borderLight));
+	}
+
+	// Packed light of a position inside the chunk or one voxel beyond it, above the chunk is open sky
+	uint8_t GetFaceLight(int x, int y, int z) const
+	{
+		if (y >= Height) return 0xF0;
+		if (y < 0)       return 0x00;
+		if (x < 0)       return GetBorderLight(0, y, z);
+		if (x >= Width)  return GetBorderLight(1, y, z);
+		if (z < 0)       return GetBorderLight(2, y, x);
+		if (z >= Depth)  return GetBorderLight(3, y, x);
+		const uint64_t index = VoxelLayout::Index(x, y, z);
+		return (GetNibble(skyLight, index) << 4) | GetNibble(blockLight, index);
+	}
+
+	// Writers hold the lock exclusively, readers that do not own the chunk's state (such as region queries) hold it shared
+	std::unique_lock<std::shared_mutex> LockVoxels()
+	{
+		return std::unique_lock<std::shared_mutex>(voxelLock);
+	}
+
+	std::shared_lock<std::shared_mutex> LockVoxelsShared() const
+	{
+		return std::shared_lock<std::shared_mutex>(voxelLock);
+	}
+
+	// Not owned if a writer holds the lock
+	std::shared_lock<std::shared_mutex> TryLockVoxelsShared() const
+	{
+		return std::shared_lock<std::shared_mutex>(voxelLock, std::try_to_lock);
+	}
+
+	// Visits every voxel in storage order, the function is called with (x, y, z, voxel)
+	template<typename Function>
+	void ForEachVoxel(Function &&function) const
+	{
+		VoxelLayout::ForEach([&](int x, int y, int z, uint64_t index) { function(x, y, z, sections[index / sectionSize][index % sectionSize]); });
+	}
+
+	uint64_t GetGpuBytes() const
+	{
+		return gpuBytes.load(std::memory_order_relaxed);
+	}
+
+	void SetGpuBytes(uint64_t bytes)
+	{
+		gpuBytes.store(bytes, std::memory_order_relaxed);
+	}
+
+	std::chrono::steady_clock::time_point GetCreatedTime() const
+	{
+		return createdTime;
+	}
+
+	// System memory held by a mesh that has not been uploaded yet
+	uint64_t GetMeshBytes() const
+	{
+		const auto mesh = std::atomic_load_explicit(&publishedMesh, std::memory_order_acquire);
+		return mesh ? mesh->vertices.capacity() * sizeof(Vertex) : 0;
+	}
+
+	static const int      borderLength = Width > Depth ? Width : Depth;
+	static const uint64_t lightBytes   = (2 * ((VoxelLayout::size + 1) / 2)) + (4 * Height * borderLength);
+	static const uint64_t voxelBytes   = (sizeof(VoxelType) * sectionSize * sectionCount) + lightBytes; // Voxels and their light
+
+	bool     modified    = false; // Set to true to prevent chunks from being unloaded
+	bool     meshing     = true;  // Set before the chunk is generated, chunks that are never drawn are not meshed
+	uint64_t lastVisible = 0;     // Last world update the chunk was in the render list, only used by the world thread
+
+	// Cleared by the world while the chunk is not in the render list. Those chunks skip building their mesh, which would hold staging or system
+	// memory until they come into view, and are marked so the world remeshes them once they do
+	std::atomic<bool> drawn{true};
+	std::atomic<bool> meshDeferred{false};
+
+	// Only used by the render thread, the renderer owns the buffer and the chunk only hands it back once it is destroyed
+	VertexBuffer *vertexBuffer        = nullptr;
+	uint64_t      uploadedGeneration  = 0;
+	FaceOffsets   uploadedFaceOffsets = {};
 private:
 	static_assert(Width  <= 255, "Width cannot exceed 255");
 	static_assert(Height <= 255, "Height cannot exceed 255");
 	static_assert(Depth  <= 255, "Depth cannot exceed 255");
 
-	std::vector<Vertex> vertices;
+	// The mesh generation is packed next to the state so a remesh can never be mistaken for the mesh that was uploaded
+	static const uint64_t stateMask       = 0xFF;
+	static const uint64_t generationShift = 8;
+
+	std::atomic<uint64_t>                 status{static_cast<uint64_t>(ChunkState::Queued)};
+	std::shared_ptr<const ChunkMesh>      publishedMesh;
+	std::atomic<uint64_t>                 gpuBytes{0};
+	std::chrono::steady_clock::time_point createdTime = std::chrono::steady_clock::now();
+
+	mutable std::shared_mutex voxelLock;
+	std::array<std::shared_ptr<VoxelType[]>, sectionCount> sections;
+	mutable std::atomic<uint32_t> sharedSections{0}; // Sections a snapshot may hold, only ever set under the voxel lock
+	uint8_t   skyLight[(VoxelLayout::size + 1) / 2]   = {};
+	uint8_t   blockLight[(VoxelLayout::size + 1) / 2] = {};
+	uint8_t   borderLight[4][Height * borderLength];
 
-	VertexBuffer *vertexBuffer = nullptr;
-	VoxelType voxels[Width * Height * Depth] = {NullVoxel};
+	static_assert(sectionCount <= 32, "Shared sections are tracked in a 32 bit mask");
+	static_assert(sizeof(skyLight) + sizeof(blockLight) + sizeof(borderLight) == lightBytes, "Light is copied as lightBytes bytes");
+
+	struct ExposedVoxel
+	{
+		uint8_t x, y, z;
+		uint8_t faces; // Bit per face direction
+	};
+
+	static inline thread_local std::vector<ExposedVoxel> exposedScratch;
+	static inline thread_local std::vector<MeshFace>     faceScratch;
+
+	// Sections account for their own memory, so one kept alive by a snapshot is still counted after the chunk lets go of it
+	struct Section
+	{
+		VoxelType voxels[sectionSize];
+
+		Section()  { MemoryManager::Allocate(MemoryManager::Category::Voxels, sizeof(voxels)); }
+		~Section() { MemoryManager::Free(MemoryManager::Category::Voxels, sizeof(voxels)); }
+	};
+
+	// The section and its reference count share one pooled block, so chunks that stream in and out reuse the same memory
+	static std::shared_ptr<VoxelType[]> AllocateSection()
+	{
+		const auto section = std::allocate_shared<Section>(Pool::Allocator<Section>());
+		std::fill(section->voxels, section->voxels + sectionSize, NullVoxel);
+		return std::shared_ptr<VoxelType[]>(section, section->voxels);
+	}
+
+	// Copies whenever a snapshot may hold the section, the reference count says nothing about a snapshot taken on another thread
+	void UnshareSection(uint64_t section)
+	{
+		sharedSections.fetch_and(~(1u << section), std::memory_order_acq_rel);
+		auto copy = AllocateSection();
+		memcpy(copy.get(), sections[section].get(), sectionSize * sizeof(VoxelType));
+		sections[section] = std::move(copy);
+		PROFILE_COUNTER(SectionsCopied, 1);
+	}
+
+	static uint8_t GetNibble(const uint8_t *nibbles, uint64_t index)
+	{
+		return (nibbles[index >> 1] >> ((index & 1) * 4)) & 0xF;
+	}
+
+	static void SetNibble(uint8_t *nibbles, uint64_t index, uint8_t value)
+	{
+		const int shift = (index & 1) * 4;
+		nibbles[index >> 1] = (nibbles[index >> 1] & ~(0xF << shift)) | (value << shift);
+	}
 
-	bool updated = false;
+	inline static std::mutex                  unusedBufferLock;
+	inline static std::vector<VertexBuffer *> unusedBuffers;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "ChunkRenderer.hpp"
+#include "VertexBuffer.hpp"
+#include "UploadManager.hpp"
+#include "FrameStats.hpp"
+#include "Profiler.hpp"
+#include <chrono>
+#include <vector>
+
+void ChunkRenderer::Initialize()
+{
+	ChunkMesh::allocateStaging = UploadManager::Allocate;
+	ChunkMesh::releaseStaging  = UploadManager::Release;
+}
+
+void ChunkRenderer::Cleanup()
+{
+	DeleteUnusedBuffers();
+	ChunkMesh::allocateStaging = nullptr;
+	ChunkMesh::releaseStaging  = nullptr;
+}
+
+void ChunkRenderer::Upload(WorldChunk &chunk)
+{
+	if (chunk.GetMeshGeneration() == 0) return; // Never meshed
+
+	if (!chunk.vertexBuffer) chunk.vertexBuffer = new VertexBuffer({VertexType::Uint8_3, VertexType::Int8_3, VertexType::Int8_3, VertexType::Uint8});
+	if (chunk.GetState() != ChunkState::ReadyToUpload) return;
+
+	const auto mesh = chunk.GetPublishedMesh();
+	if (mesh && mesh->generation != chunk.uploadedGeneration) {
+		const bool uploaded = mesh->staging.id != 0 ?
+			UploadManager::Upload(chunk.vertexBuffer, mesh->staging, mesh->vertexCount) :
+			UploadManager::Upload(chunk.vertexBuffer, mesh->vertices.data(), mesh->vertexCount);
+		if (uploaded) {
+			if (chunk.uploadedGeneration == 0) {
+				FrameStats::AddChunkLatency(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - chunk.GetCreatedTime()).count());
+			}
+			chunk.uploadedGeneration  = mesh->generation;
+			chunk.uploadedFaceOffsets = mesh->faceOffsets;
+			chunk.SetGpuBytes(chunk.vertexBuffer->GetSize());
+			PROFILE_COUNTER(ChunksUploaded, 1);
+		}
+	}
+	chunk.FinishUpload(chunk.uploadedGeneration);
+}
+
+bool ChunkRenderer::RecordDraw(const WorldChunk &chunk, const glm::vec3 &cameraPosition, CommandBuffer::Draw &draw)
+{
+	if (!chunk.vertexBuffer) return false;
+
+	// Faces lie on voxel boundaries, so a direction is only visible if the camera is beyond the innermost plane any of its faces can lie on
+	const bool visible[] = {
+		cameraPosition.z < WorldChunk::depth - 1,
+		cameraPosition.z > 1,
+		cameraPosition.x < WorldChunk::width - 1,
+		cameraPosition.x > 1,
+		cameraPosition.y < WorldChunk::height - 1,
+		cameraPosition.y > 1
+	};
+
+	static_assert(CommandBuffer::maxRanges >= static_cast<int>(Face::Count), "Every face direction can need a range");
+	int32_t *firsts     = draw.firsts;
+	int32_t *counts     = draw.counts;
+	int     &rangeCount = draw.rangeCount;
+	rangeCount = 0;
+	for (size_t face = 0; face < static_cast<size_t>(Face::Count); face++) {
+		const int32_t first = chunk.uploadedFaceOffsets[face];
+		const int32_t count = chunk.uploadedFaceOffsets[face + 1] - first;
+		if (!visible[face] || count == 0) continue;
+		if (rangeCount > 0 && firsts[rangeCount - 1] + counts[rangeCount - 1] == first) {
+			counts[rangeCount - 1] += count;
+		}
+		else {
+			firsts[rangeCount] = first;
+			counts[rangeCount] = count;
+			rangeCount++;
+		}
+	}
+	draw.buffer = chunk.vertexBuffer;
+	return rangeCount > 0;
+}
+
+void ChunkRenderer::DeleteUnusedBuffers()
+{
+	static std::vector<VertexBuffer *> buffers; // Keeps its capacity, only the render thread uses it
+	WorldChunk::TakeUnusedBuffers(buffers);
+	for (VertexBuffer *buffer : buffers) {
+		delete buffer;
+	}
+	buffers.clear();
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#include "World.hpp"
+#include "CommandBuffer.hpp"
+#include <glm/vec3.hpp>
+
+// The GPU side of chunks, which only the game links. Chunks hold their vertex buffer without knowing its type and build meshes into staging
+// memory through hooks set here, so worlds that are never drawn link no OpenGL code
+namespace ChunkRenderer
+{
+	void Initialize(); // Call after UploadManager::Initialize, chunks meshed from then on are built straight into staging memory
+	void Cleanup();    // Call before UploadManager::Cleanup once every chunk is gone
+
+	// Must be called on the render thread and never blocks, the last uploaded mesh is drawn until a newer one fits in the frame budget
+	void Upload(WorldChunk &chunk);
+
+	// Fills in the buffer and face ranges of a draw, false if there is nothing to draw. Reads only what Upload wrote, so any thread can
+	// record once the render thread has uploaded. The camera position is relative to the chunk
+	bool RecordDraw(const WorldChunk &chunk, const glm::vec3 &cameraPosition, CommandBuffer::Draw &draw);
+
+	void DeleteUnusedBuffers(); // Must be called on the render thread, deletes the buffers of the chunks destroyed since the last call
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "CommandBuffer.hpp"
+#include "Shader.hpp"
+#include "VertexBuffer.hpp"
+#include "Profiler.hpp"
+#include <glm/common.hpp>
+#include <array>
+
+const float CommandBuffer::maxDepth = 4096.0f;
+
+// Shaders and buffers only group draws in the key, so a few bits of their address are enough and a collision only costs a state change
+static uint64_t GetKey(CommandBuffer::Pass pass, const CommandBuffer::Draw &draw, float depth)
+{
+	const uint64_t shader   = (reinterpret_cast<uintptr_t>(draw.shader) >> 4) & 0xFFF;
+	const uint64_t buffer   = (reinterpret_cast<uintptr_t>(draw.buffer) >> 4) & 0xFFFFFF;
+	const uint64_t quantized = static_cast<uint64_t>(glm::clamp(depth / CommandBuffer::maxDepth, 0.0f, 1.0f) * 0xFFFFFF);
+	return (static_cast<uint64_t>(pass) << 60) | (shader << 48) | (quantized << 24) | buffer;
+}
+
+void CommandBuffer::Clear()
+{
+	draws.clear();
+	commands.clear();
+}
+
+void CommandBuffer::Add(Pass pass, float depth, const Draw &draw)
+{
+	commands.push_back({GetKey(pass, draw, depth), static_cast<uint32_t>(draws.size())});
+	draws.push_back(draw);
+}
+
+void CommandBuffer::Append(const CommandBuffer &other)
+{
+	const uint32_t first = static_cast<uint32_t>(draws.size());
+	draws.insert(draws.end(), other.draws.begin(), other.draws.end());
+	for (const auto &command : other.commands) commands.push_back({command.first, command.second + first});
+}
+
+// Least significant byte first, bytes that are the same in every key are skipped
+void CommandBuffer::Sort()
+{
+	sorted.resize(commands.size());
+	for (int shift = 0; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> counts = {};
+		for (const auto &command : commands) counts[(command.first >> shift) & 0xFF]++;
+		if (counts[(commands[0].first >> shift) & 0xFF] == commands.size()) continue;
+
+		uint32_t offset = 0;
+		for (uint32_t &count : counts) {
+			const uint32_t bucket = count;
+			count   = offset;
+			offset += bucket;
+		}
+		for (const auto &command : commands) sorted[counts[(command.first >> shift) & 0xFF]++] = command;
+		commands.swap(sorted);
+	}
+}
+
+void CommandBuffer::Submit()
+{
+	if (commands.empty()) return;
+	PROFILE_ZONE("Submit draws");
+	Sort();
+
+	Shader    *boundShader   = nullptr;
+	int        boundLocation = -1;
+	glm::ivec3 boundOffset;
+	for (const auto &command : commands) {
+		const Draw &draw = draws[command.second];
+		if (draw.shader != boundShader) {
+			draw.shader->Bind();
+			boundShader   = draw.shader;
+			boundLocation = -1;
+		}
+		if (draw.offsetLocation >= 0 && (draw.offsetLocation != boundLocation || draw.offset != boundOffset)) {
+			draw.shader->SetUniformIVec3(draw.offsetLocation, draw.offset);
+			boundLocation = draw.offsetLocation;
+			boundOffset   = draw.offset;
+		}
+		if (draw.rangeCount == 0) draw.buffer->Render();
+		else draw.buffer->RenderRanges(draw.firsts, draw.counts, draw.rangeCount);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Shader;
+class VertexBuffer;
+
+// Draws recorded with a 64 bit sort key of pass, shader, depth and buffer, then sorted and replayed with redundant state changes left out.
+// Recording touches no OpenGL state, so any thread can record into a buffer of its own and the buffers are appended on the GL thread
+class CommandBuffer
+{
+public:
+	// Replayed in this order
+	enum struct Pass : uint8_t
+	{
+		Opaque,  // Front to back, so hidden fragments fail the depth test early
+		Overlay
+	};
+
+	static const int maxRanges = 6;
+
+	struct Draw
+	{
+		Shader       *shader;
+		VertexBuffer *buffer;
+		int           offsetLocation = -1; // Uniform that receives offset, unused if -1
+		glm::ivec3    offset         = {0, 0, 0};
+		int           rangeCount     = 0;  // The whole buffer is drawn if 0
+		int32_t       firsts[maxRanges];
+		int32_t       counts[maxRanges];
+	};
+
+	static const float maxDepth; // Depths are clamped to it
+
+	void Clear();
+	void Add(Pass pass, float depth, const Draw &draw);
+	void Append(const CommandBuffer &other);
+	size_t GetCount() const { return draws.size(); }
+
+	// Must be called on the thread that owns the OpenGL context
+	void Submit();
+private:
+	std::vector<Draw>                          draws;
+	std::vector<std::pair<uint64_t, uint32_t>> commands; // Key and draw
+	std::vector<std::pair<uint64_t, uint32_t>> sorted;   // Scratch for the radix sort
+
+	void Sort();
+};
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "DistanceController.hpp"
+#include "JobSystem.hpp"
+#include "MemoryManager.hpp"
+#include "Log.hpp"
+#include <glm/common.hpp>
+#include <algorithm>
+
+// Usage over budget of the fullest category, 0 for categories without a budget
+static float GetMemoryUse()
+{
+	float use = 0.0f;
+	for (int i = 0; i < static_cast<int>(MemoryManager::Category::Count); i++) {
+		const auto category = static_cast<MemoryManager::Category>(i);
+		use = std::max(use, static_cast<float>(static_cast<double>(MemoryManager::GetUsage(category)) / MemoryManager::GetBudget(category)));
+	}
+	return use;
+}
+
+DistanceController::DistanceController(float renderDistance, const Settings &settings) : settings(settings), renderDistance(glm::clamp(renderDistance, settings.minRenderDistance, settings.maxRenderDistance)), averageFrameTime(settings.targetFrameTime)
+{
+}
+
+bool DistanceController::Update(float seconds, float frameTime)
+{
+	const float smoothing = 0.05f; // About the last 20 frames
+	averageFrameTime += (frameTime - averageFrameTime) * smoothing;
+
+	const float  memoryUse  = GetMemoryUse();
+	const size_t queuedJobs = JobSystem::GetQueuedCount();
+	const bool   shrink     = averageFrameTime > settings.targetFrameTime * settings.shrinkThreshold || memoryUse > settings.maxMemoryUse;
+	const bool   grow       = averageFrameTime < settings.targetFrameTime * settings.growThreshold && memoryUse < settings.growMemoryUse && queuedJobs < settings.growQueuedJobs;
+	shrinkTime = shrink ? shrinkTime + seconds : 0.0f;
+	growTime   = grow   ? growTime   + seconds : 0.0f;
+	if (cooldownTime > 0.0f) {
+		cooldownTime -= seconds;
+		return false;
+	}
+
+	float distance = renderDistance;
+	if (shrinkTime >= settings.shrinkDelay)  distance = std::max(renderDistance - settings.step, settings.minRenderDistance);
+	else if (growTime >= settings.growDelay) distance = std::min(renderDistance + settings.step, settings.maxRenderDistance);
+	if (distance == renderDistance) return false;
+
+	renderDistance = distance;
+	shrinkTime     = 0.0f;
+	growTime       = 0.0f;
+	cooldownTime   = settings.cooldown;
+	Log::Info("DistanceController: Changed distances", {{"renderDistance", renderDistance}, {"frameMilliseconds", averageFrameTime * 1000.0f}, {"queuedJobs", queuedJobs}, {"memoryUse", memoryUse}});
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+
+// Adjusts the render and load distances to hold a target frame time, shrinking them when frames run long or memory fills up and growing them
+// while there is headroom and streaming has caught up. A signal has to hold for a while before the distances change, and then they are left
+// alone for a cooldown, so a single slow frame or the work a change itself causes cannot make them oscillate
+class DistanceController
+{
+public:
+	struct Settings
+	{
+		float  targetFrameTime   = 1.0f / 60.0f; // Seconds
+		float  minRenderDistance = 128.0f;
+		float  maxRenderDistance = 1024.0f;
+		float  loadMargin        = 128.0f;       // The load distance is this far beyond the render distance
+		float  step              = 32.0f;        // Change per adjustment
+		float  shrinkThreshold   = 1.15f;        // Of the target frame time
+		float  growThreshold     = 0.7f;
+		float  shrinkDelay       = 0.5f;         // Seconds a signal has to hold
+		float  growDelay         = 3.0f;
+		float  cooldown          = 1.0f;         // Seconds after a change before the next
+		float  maxMemoryUse      = 0.95f;        // Of the fullest budget, shrinks above this
+		float  growMemoryUse     = 0.8f;         // Grows only below this
+		size_t growQueuedJobs    = 64;           // Grows only while fewer jobs are waiting
+	};
+
+	DistanceController(float renderDistance, const Settings &settings);
+
+	// Call once per frame with the wall time since the last call and the time the frame's own work took, which leaves out waiting for vsync.
+	// Reads the job queue and memory usage itself, and returns true if the distances changed
+	bool Update(float seconds, float frameTime);
+
+	float GetRenderDistance() const { return renderDistance; }
+	float GetLoadDistance() const { return renderDistance + settings.loadMargin; }
+private:
+	Settings settings;
+	float    renderDistance;
+	float    averageFrameTime = 0.0f; // Exponential moving average
+	float    shrinkTime       = 0.0f; // Seconds the shrink and grow conditions have held
+	float    growTime         = 0.0f;
+	float    cooldownTime     = 0.0f;
+};
\ No newline at end of file
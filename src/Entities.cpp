@@ -0,0 +1,225 @@
+#include "Entities.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include <glm/vec2.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <cmath>
+
+static const float  skin      = 1e-3f; // Gap left to a voxel that stopped an entity, so the entity is not inside it
+static const size_t batchSize = 1024;  // Entities per job
+
+static int ChunkCoordinate(int position, int size)
+{
+	return (position >= 0 ? position : position - size + 1) / size;
+}
+
+// Snapshots of a bucket's chunk and the eight around it, voxels outside of them are empty
+struct Neighbourhood
+{
+	glm::ivec2                  coordinate;
+	const WorldChunk::Snapshot *chunks[3][3];
+
+	// Max is exclusive, the box is split by chunk so each part reads a single snapshot
+	bool IsSolid(const glm::ivec3 &min, const glm::ivec3 &max) const
+	{
+		const int fromY = std::max(min.y, 0);
+		const int toY   = std::min(max.y, chunkHeight);
+		if (fromY >= toY) return false;
+		for (int chunkZ = ChunkCoordinate(min.z, chunkDepth); chunkZ <= ChunkCoordinate(max.z - 1, chunkDepth); chunkZ++) {
+			for (int chunkX = ChunkCoordinate(min.x, chunkWidth); chunkX <= ChunkCoordinate(max.x - 1, chunkWidth); chunkX++) {
+				const int column = chunkX - coordinate.x + 1;
+				const int row    = chunkZ - coordinate.y + 1;
+				if (column < 0 || column > 2 || row < 0 || row > 2 || !chunks[row][column]) continue;
+				const WorldChunk::Snapshot &chunk = *chunks[row][column];
+				const glm::ivec3 origin(chunkX * chunkWidth, 0, chunkZ * chunkDepth);
+				const glm::ivec3 from = glm::max(min, origin) - origin;
+				const glm::ivec3 to   = glm::min(max, origin + glm::ivec3(chunkWidth, 0, chunkDepth)) - origin;
+				for (int y = fromY; y < toY; y++) {
+					for (int z = from.z; z < to.z; z++) {
+						for (int x = from.x; x < to.x; x++) {
+							const uint8_t voxel = chunk.GetVoxel(x, y, z);
+							if (voxel != airVoxel && !IsWater(voxel)) return true;
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+};
+
+// Moves the box along one axis until the layer of voxels its leading face enters holds a solid one, returns how far it moved
+static float Sweep(const Neighbourhood &neighbourhood, const glm::vec3 &min, const glm::vec3 &max, int axis, float distance)
+{
+	glm::ivec3 from = glm::floor(min);
+	glm::ivec3 to   = glm::ceil(max);
+	if (distance > 0.0f) {
+		const int last = static_cast<int>(std::ceil(max[axis] + distance)) - 1;
+		for (int layer = static_cast<int>(std::ceil(max[axis])); layer <= last; layer++) {
+			from[axis] = layer;
+			to[axis]   = layer + 1;
+			if (neighbourhood.IsSolid(from, to)) return std::max(0.0f, layer - max[axis] - skin);
+		}
+	}
+	else if (distance < 0.0f) {
+		const int last = static_cast<int>(std::floor(min[axis] + distance));
+		for (int layer = static_cast<int>(std::floor(min[axis])) - 1; layer >= last; layer--) {
+			from[axis] = layer;
+			to[axis]   = layer + 1;
+			if (neighbourhood.IsSolid(from, to)) return std::min(0.0f, (layer + 1) - min[axis] + skin);
+		}
+	}
+	return distance;
+}
+
+Entities::Id Entities::Add(const glm::vec3 &position, const glm::vec3 &halfExtents)
+{
+	Id id;
+	if (freeIds.empty()) {
+		id = static_cast<Id>(indices.size());
+		indices.push_back(0);
+	}
+	else {
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	indices[id] = static_cast<uint32_t>(positions.size());
+	positions.push_back(position);
+	velocities.push_back({0.0f, 0.0f, 0.0f});
+	this->halfExtents.push_back(glm::min(halfExtents, glm::vec3(maxStep)));
+	ids.push_back(id);
+	return id;
+}
+
+void Entities::Remove(Id id)
+{
+	const uint32_t index = indices[id];
+	const uint32_t last  = static_cast<uint32_t>(positions.size() - 1);
+	positions[index]   = positions[last];
+	velocities[index]  = velocities[last];
+	halfExtents[index] = halfExtents[last];
+	ids[index]         = ids[last];
+	indices[ids[index]] = index;
+	positions.pop_back();
+	velocities.pop_back();
+	halfExtents.pop_back();
+	ids.pop_back();
+	freeIds.push_back(id);
+}
+
+uint64_t Entities::GetKey(int x, int z)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+}
+
+uint64_t Entities::GetChunkKey(const glm::vec3 &position)
+{
+	const glm::ivec3 voxel = glm::floor(position);
+	return GetKey(ChunkCoordinate(voxel.x, chunkWidth), ChunkCoordinate(voxel.z, chunkDepth));
+}
+
+const WorldChunk::Snapshot *Entities::FindSnapshot(const std::vector<std::pair<uint64_t, WorldChunk::Snapshot>> &snapshots, uint64_t key)
+{
+	const auto it = std::lower_bound(snapshots.begin(), snapshots.end(), key, [](const auto &entry, uint64_t key) { return entry.first < key; });
+	return it != snapshots.end() && it->first == key ? &it->second : nullptr;
+}
+
+void Entities::Update(World &world, float seconds)
+{
+	PROFILE_ZONE("Update entities");
+	// Few entities change chunk in one update, so last update's order only needs an insertion sort
+	size_t moved = 0;
+	if (order.size() == positions.size()) {
+		for (auto &entry : order) {
+			const uint64_t key = GetChunkKey(positions[entry.second]);
+			if (key != entry.first) moved++;
+			entry.first = key;
+		}
+	}
+	else {
+		order.clear();
+		for (uint32_t index = 0; index < positions.size(); index++) order.push_back({GetChunkKey(positions[index]), index});
+		moved = order.size();
+	}
+	if (moved > order.size() / 16) std::sort(order.begin(), order.end());
+	else {
+		for (size_t i = 1; i < order.size(); i++) {
+			const auto entry = order[i];
+			size_t j = i;
+			for (; j > 0 && entry < order[j - 1]; j--) order[j] = order[j - 1];
+			order[j] = entry;
+		}
+	}
+
+	// Snapshots only reference the chunks' sections. The world thread and edits hold chunk locks for a while, so a chunk whose lock is taken
+	// keeps the snapshot it had last update instead of the render thread waiting for it
+	snapshots.swap(previousSnapshots);
+	snapshots.clear();
+	for (size_t i = 0; i < order.size(); i++) {
+		if (i > 0 && order[i].first == order[i - 1].first) continue;
+		const int x = static_cast<int32_t>(order[i].first >> 32);
+		const int z = static_cast<int32_t>(order[i].first);
+		for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+			for (int offsetX = -1; offsetX <= 1; offsetX++) {
+				snapshots.push_back({GetKey(x + offsetX, z + offsetZ), WorldChunk::Snapshot()});
+			}
+		}
+	}
+	std::sort(snapshots.begin(), snapshots.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+	snapshots.erase(std::unique(snapshots.begin(), snapshots.end(), [](const auto &a, const auto &b) { return a.first == b.first; }), snapshots.end());
+	snapshots.erase(std::remove_if(snapshots.begin(), snapshots.end(), [this, &world](auto &entry) {
+		bool busy;
+		if (world.TryGetSnapshot(static_cast<int32_t>(entry.first >> 32), static_cast<int32_t>(entry.first), entry.second, busy)) return false;
+		const WorldChunk::Snapshot *previous = busy ? FindSnapshot(previousSnapshots, entry.first) : nullptr;
+		if (!previous) return true;
+		entry.second = *previous;
+		return false;
+	}), snapshots.end());
+	previousSnapshots.clear();
+
+	// Batches write only to their own entities
+	if (order.size() <= batchSize) Move(0, order.size(), seconds);
+	else {
+		std::vector<JobSystem::Job> jobs;
+		for (size_t begin = 0; begin < order.size(); begin += batchSize) {
+			jobs.push_back([this, begin, seconds]() { Move(begin, std::min(begin + batchSize, order.size()), seconds); });
+		}
+		JobSystem::RunBatch(jobs);
+	}
+}
+
+void Entities::Move(size_t begin, size_t end, float seconds)
+{
+	Neighbourhood neighbourhood;
+	for (size_t i = begin; i < end; i++) {
+		const auto [key, index] = order[i];
+		if (i == begin || key != order[i - 1].first) {
+			neighbourhood.coordinate = glm::ivec2(static_cast<int32_t>(key >> 32), static_cast<int32_t>(key));
+			for (int row = 0; row < 3; row++) {
+				for (int column = 0; column < 3; column++) {
+					neighbourhood.chunks[row][column] = FindSnapshot(snapshots, GetKey(neighbourhood.coordinate.x + column - 1, neighbourhood.coordinate.y + row - 1));
+				}
+			}
+		}
+
+		glm::vec3 &position = positions[index];
+		glm::vec3 &velocity = velocities[index];
+		const glm::vec3 step = glm::clamp(velocity * seconds, -maxStep, maxStep);
+		glm::vec3 min = position - halfExtents[index];
+		glm::vec3 max = position + halfExtents[index];
+		if (neighbourhood.IsSolid(glm::floor(min), glm::ceil(max))) {
+			position += step;
+			continue;
+		}
+
+		// Vertical first, so an entity on the ground slides along it instead of catching on the voxel edges
+		for (const int axis : {1, 0, 2}) {
+			const float moved = Sweep(neighbourhood, min, max, axis, step[axis]);
+			if (moved != step[axis]) velocity[axis] = 0.0f;
+			position[axis] += moved;
+			min[axis]      += moved;
+			max[axis]      += moved;
+		}
+	}
+}
\ No newline at end of file
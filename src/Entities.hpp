@@ -0,0 +1,48 @@
+#pragma once
+#include "World.hpp"
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Moving boxes that collide with the terrain. Components are stored as parallel arrays and entities are moved in batches
+// on the job system, bucketed by the chunk they are in so each batch only looks up the chunks around it
+class Entities
+{
+public:
+	using Id = uint32_t;
+
+	static constexpr float maxStep = chunkWidth / 2.0f; // Per axis and update, so an entity never sweeps past the chunks around its own
+
+	Id Add(const glm::vec3 &position, const glm::vec3 &halfExtents);
+	void Remove(Id id);
+
+	glm::vec3 GetPosition(Id id) const { return positions[indices[id]]; }
+	glm::vec3 GetVelocity(Id id) const { return velocities[indices[id]]; }
+	void SetPosition(Id id, const glm::vec3 &position) { positions[indices[id]] = position; }
+	void SetVelocity(Id id, const glm::vec3 &velocity) { velocities[indices[id]] = velocity; }
+	size_t GetCount() const { return positions.size(); }
+
+	// Sweeps every entity one axis at a time against snapshots of the chunks, velocity along an axis that hits a solid voxel is zeroed.
+	// Chunks that are not loaded and water are empty, and an entity that starts inside solid voxels moves freely until it is out.
+	// Never waits on the world, a chunk that is locked for writing is swept against its snapshot from the last update
+	void Update(World &world, float seconds);
+private:
+	// Index i of every component array belongs to the same entity, removal moves the last entity into the gap
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> velocities;
+	std::vector<glm::vec3> halfExtents;
+	std::vector<Id>        ids;     // Entity at each index
+	std::vector<uint32_t>  indices; // Index of each id
+	std::vector<Id>        freeIds;
+
+	// Kept between updates, the order is still almost sorted and the snapshots stand in for chunks that are locked in the next update
+	std::vector<std::pair<uint64_t, uint32_t>>             order;             // Chunk key and index of every entity, sorted so each bucket is contiguous
+	std::vector<std::pair<uint64_t, WorldChunk::Snapshot>> snapshots;         // Sorted by chunk key
+	std::vector<std::pair<uint64_t, WorldChunk::Snapshot>> previousSnapshots; // Only used while the snapshots are taken
+
+	static uint64_t GetKey(int x, int z);
+	static uint64_t GetChunkKey(const glm::vec3 &position);
+	static const WorldChunk::Snapshot *FindSnapshot(const std::vector<std::pair<uint64_t, WorldChunk::Snapshot>> &snapshots, uint64_t key);
+	void Move(size_t begin, size_t end, float seconds);
+};
\ No newline at end of file
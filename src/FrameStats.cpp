@@ -0,0 +1,109 @@
+#include "FrameStats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+
+namespace FrameStats
+{
+	static std::atomic<bool>     statsEnabled{false};
+	static std::mutex            statsLock;
+	static std::vector<uint64_t> frameTimes;
+	static std::vector<uint64_t> chunkLatencies;
+	static std::vector<uint64_t> submitTimes;
+	static std::vector<uint64_t> tickTimes;
+	static std::vector<uint64_t> readLatencies;
+	static uint64_t              peakActiveVoxels = 0;
+	static uint64_t              stallThreshold = 33333333;
+	static uint64_t              stallCount     = 0;
+
+	static uint64_t GetPercentile(const std::vector<uint64_t> &sorted, int percentile)
+	{
+		if (sorted.empty()) return 0;
+		const size_t index = (sorted.size() - 1) * percentile / 100;
+		return sorted[index];
+	}
+
+	static std::string FormatPercentiles(const char *name, std::vector<uint64_t> values)
+	{
+		std::sort(values.begin(), values.end());
+		char line[256];
+		snprintf(line, sizeof(line), "%s: p50 %.2fms, p95 %.2fms, p99 %.2fms, max %.2fms over %zu samples", name,
+			GetPercentile(values, 50) / 1e6, GetPercentile(values, 95) / 1e6, GetPercentile(values, 99) / 1e6,
+			values.empty() ? 0.0 : values.back() / 1e6, values.size());
+		return line;
+	}
+}
+
+void FrameStats::SetEnabled(bool enabled)
+{
+	statsEnabled = enabled;
+}
+
+void FrameStats::SetStallThreshold(uint64_t nanoseconds)
+{
+	std::lock_guard<std::mutex> guard(statsLock);
+	stallThreshold = nanoseconds;
+}
+
+void FrameStats::AddFrame(uint64_t nanoseconds)
+{
+	if (!statsEnabled.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> guard(statsLock);
+	frameTimes.push_back(nanoseconds);
+	if (nanoseconds > stallThreshold) stallCount++;
+}
+
+void FrameStats::AddChunkLatency(uint64_t nanoseconds)
+{
+	if (!statsEnabled.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> guard(statsLock);
+	chunkLatencies.push_back(nanoseconds);
+}
+
+void FrameStats::AddSubmitTime(uint64_t nanoseconds)
+{
+	if (!statsEnabled.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> guard(statsLock);
+	submitTimes.push_back(nanoseconds);
+}
+
+void FrameStats::AddReadLatency(uint64_t nanoseconds)
+{
+	if (!statsEnabled.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> guard(statsLock);
+	readLatencies.push_back(nanoseconds);
+}
+
+void FrameStats::AddBlockTick(uint64_t nanoseconds, uint64_t activeVoxels)
+{
+	if (!statsEnabled.load(std::memory_order_relaxed)) return;
+	std::lock_guard<std::mutex> guard(statsLock);
+	tickTimes.push_back(nanoseconds);
+	peakActiveVoxels = std::max(peakActiveVoxels, activeVoxels);
+}
+
+void FrameStats::Reset()
+{
+	std::lock_guard<std::mutex> guard(statsLock);
+	frameTimes.clear();
+	chunkLatencies.clear();
+	submitTimes.clear();
+	tickTimes.clear();
+	readLatencies.clear();
+	peakActiveVoxels = 0;
+	stallCount       = 0;
+}
+
+std::string FrameStats::GetReport()
+{
+	std::lock_guard<std::mutex> guard(statsLock);
+	char stalls[128];
+	snprintf(stalls, sizeof(stalls), "Stalls: %llu frames over %.2fms", static_cast<unsigned long long>(stallCount), stallThreshold / 1e6);
+	char active[128];
+	snprintf(active, sizeof(active), "Active voxels: peak %llu", static_cast<unsigned long long>(peakActiveVoxels));
+	return FormatPercentiles("Frame time", frameTimes) + "\n" + FormatPercentiles("Submit time", submitTimes) + "\n" +
+	       FormatPercentiles("Chunk ready latency", chunkLatencies) + "\n" + FormatPercentiles("Block tick", tickTimes) + "\n" +
+	       FormatPercentiles("Read latency", readLatencies) + "\n" + active + "\n" + stalls;
+}
\ No newline at end of file
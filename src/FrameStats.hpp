@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Collects frame times and chunk latencies for benchmark runs, all functions can be called from any thread
+namespace FrameStats
+{
+	void SetEnabled(bool enabled); // Samples are dropped until enabled
+	void SetStallThreshold(uint64_t nanoseconds); // Frames that take longer count as stalls
+	void AddFrame(uint64_t nanoseconds);
+	void AddChunkLatency(uint64_t nanoseconds); // Time from a chunk being queued to its first upload
+	void AddSubmitTime(uint64_t nanoseconds);   // CPU time spent issuing the frame's draw calls
+	void AddReadLatency(uint64_t nanoseconds);  // Time from a file read being requested to its completion being queued
+	void AddBlockTick(uint64_t nanoseconds, uint64_t activeVoxels);
+	void Reset();
+
+	// p50/p95/p99 of every series, the peak number of active voxels and the number of stalls
+	std::string GetReport();
+}
\ No newline at end of file
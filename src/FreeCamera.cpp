@@ -11,11 +11,12 @@ FreeCamera::FreeCamera()
 	UpdateVectors();
 }
 
-void FreeCamera::Move(const glm::vec3 vector)
+glm::vec3 FreeCamera::GetMovement(const glm::vec3 &vector) const
 {
-	position   += glm::normalize(glm::vec3(right.x, 0.0f, right.z)) * vector.x;
-	position.y += vector.y;
-	position   += glm::normalize(glm::vec3(front.x, 0.0f, front.z)) * vector.z;
+	glm::vec3 movement = glm::normalize(glm::vec3(right.x, 0.0f, right.z)) * vector.x;
+	movement.y += vector.y;
+	movement   += glm::normalize(glm::vec3(front.x, 0.0f, front.z)) * vector.z;
+	return movement;
 }
 
 void FreeCamera::ProcessMouseInput(float x, float y)
@@ -29,6 +30,13 @@ void FreeCamera::ProcessMouseInput(float x, float y)
 	UpdateVectors();
 }
 
+void FreeCamera::SetRotation(float yaw, float pitch)
+{
+	this->yaw   = yaw;
+	this->pitch = pitch;
+	UpdateVectors();
+}
+
 glm::mat4 FreeCamera::GetMatrix()
 {
 	return glm::lookAt(position, position + front, up);
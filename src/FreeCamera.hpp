@@ -7,8 +7,11 @@ class FreeCamera
 public:
 	FreeCamera();
 
-	void Move(const glm::vec3 vector);
+	glm::vec3 GetMovement(const glm::vec3 &vector) const; // Right, up and forward of the camera to world space, kept level with the ground
 	void ProcessMouseInput(float x, float y);
+	void SetRotation(float yaw, float pitch);
+	float GetYaw() const { return yaw; }
+	float GetPitch() const { return pitch; }
 	glm::mat4 GetMatrix();
 
 	glm::vec3 position;
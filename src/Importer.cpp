@@ -0,0 +1,226 @@
+#include "Importer.hpp"
+#include "AsyncIo.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
+#include <glm/common.hpp>
+#include <stb_image.h>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+static bool HasExtension(const std::string &fileName, const char *extension)
+{
+	const size_t length = std::strlen(extension);
+	return fileName.size() >= length && fileName.compare(fileName.size() - length, length, extension) == 0;
+}
+
+static uint32_t ReadUint32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static double GetPeakResidentMegabytes()
+{
+	#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+		#ifdef __APPLE__
+			return usage.ru_maxrss / (1024.0 * 1024.0); // Bytes
+		#else
+			return usage.ru_maxrss / 1024.0; // Kilobytes
+		#endif
+	#endif
+}
+
+Importer::Importer(const char *fileName, float heightScale) : heightScale(heightScale)
+{
+	const std::string name = fileName;
+	if (HasExtension(name, ".png")) {
+		int pngWidth, pngDepth, channels;
+		uint16_t *samples = stbi_load_16(fileName, &pngWidth, &pngDepth, &channels, 1);
+		if (!samples) {
+			Log::Error(std::string("Importer: Failed to load ") + fileName + " - " + stbi_failure_reason());
+			return;
+		}
+		decoded.assign(samples, samples + (static_cast<size_t>(pngWidth) * pngDepth));
+		stbi_image_free(samples);
+		width = pngWidth;
+		depth = pngDepth;
+	}
+	else if (HasExtension(name, ".r16")) {
+		file = std::make_shared<AsyncIo::File>(fileName);
+		if (!file->IsOpen()) return;
+		const uint64_t size = file->GetSize();
+		const int      side = static_cast<int>(std::sqrt(static_cast<double>(size / 2)));
+		if (static_cast<uint64_t>(side) * side * 2 != size) {
+			Log::Error(std::string("Importer: ") + fileName + " is not a square 16 bit heightmap");
+			return;
+		}
+		width = side;
+		depth = side;
+	}
+	else if (HasExtension(name, ".vol")) {
+		file = std::make_shared<AsyncIo::File>(fileName);
+		if (!file->IsOpen()) return;
+		const uint64_t size = file->GetSize();
+		uint8_t header[16];
+		if (size < sizeof(header) || !file->Read(0, header, sizeof(header)) || ReadUint32(header) != volumeMagic) {
+			Log::Error(std::string("Importer: ") + fileName + " is not a voxel volume");
+			return;
+		}
+		const uint32_t volumeWidth  = ReadUint32(header + 4);
+		const uint32_t volumeHeight = ReadUint32(header + 8);
+		const uint32_t volumeDepth  = ReadUint32(header + 12);
+		if (static_cast<uint64_t>(volumeWidth) * volumeHeight * volumeDepth != size - sizeof(header)) {
+			Log::Error(std::string("Importer: ") + fileName + " is truncated");
+			return;
+		}
+		if (volumeHeight > chunkHeight) Log::Warning(std::string("Importer: ") + fileName + " is taller than a chunk, the top is cut off");
+		format     = Format::Volume;
+		dataOffset = sizeof(header);
+		width      = static_cast<int>(volumeWidth);
+		height     = static_cast<int>(volumeHeight);
+		depth      = static_cast<int>(volumeDepth);
+	}
+	else {
+		Log::Error(std::string("Importer: Unknown format ") + fileName);
+		return;
+	}
+
+	origin = -glm::ivec2(width / 2, depth / 2);
+	Log::Info(std::string("Importer: Opened ") + fileName, {{"width", width}, {"height", height}, {"depth", depth}});
+}
+
+glm::ivec2 Importer::GetMinChunk() const
+{
+	return glm::ivec2(std::floor(origin.x / static_cast<float>(chunkWidth)), std::floor(origin.y / static_cast<float>(chunkDepth)));
+}
+
+glm::ivec2 Importer::GetMaxChunk() const
+{
+	return glm::ivec2(std::floor((origin.x + width - 1) / static_cast<float>(chunkWidth)), std::floor((origin.y + depth - 1) / static_cast<float>(chunkDepth)));
+}
+
+// Begin and end are the columns of the chunk the file covers, first is the sample or column of the file at begin
+bool Importer::GetBounds(int x, int z, glm::ivec2 &first, glm::ivec2 &begin, glm::ivec2 &end) const
+{
+	if (!IsOpen()) return false;
+	const glm::ivec2 chunkOrigin(x * chunkWidth, z * chunkDepth);
+	begin = glm::max(origin - chunkOrigin, glm::ivec2(0));
+	end   = glm::min(origin + glm::ivec2(width, depth) - chunkOrigin, glm::ivec2(chunkWidth, chunkDepth));
+	first = chunkOrigin + begin - origin;
+	return begin.x < end.x && begin.y < end.y;
+}
+
+// One row per line of samples, or per line of voxels of every slice, as wide as the chunk. PNGs are decoded already so they have none.
+// A volume's rows follow each other a row apart through every slice, so both formats are rows of one stride
+ChunkSource::Tile Importer::GetTile(int x, int z) const
+{
+	glm::ivec2 first, begin, end;
+	if (!file || !GetBounds(x, z, first, begin, end)) return {};
+	const glm::ivec2 size = end - begin;
+	Tile tile;
+	tile.file = file;
+	if (format == Format::Heightmap) {
+		const uint64_t rowBytes = static_cast<uint64_t>(width) * 2;
+		tile.offset   = dataOffset + (first.y * rowBytes) + (first.x * 2);
+		tile.rowSize  = static_cast<uint64_t>(size.x) * 2;
+		tile.stride   = rowBytes;
+		tile.rowCount = size.y;
+	}
+	else {
+		const uint64_t rowBytes   = static_cast<uint64_t>(width);
+		const uint64_t sliceBytes = rowBytes * height;
+		tile.offset   = dataOffset + (first.y * sliceBytes) + first.x;
+		tile.rowSize  = size.x;
+		tile.stride   = rowBytes;
+		tile.rowCount = static_cast<uint64_t>(size.y) * height;
+	}
+	return tile;
+}
+
+// Samples are relative to the first one of the tile, whose rows are rowLength samples apart
+uint16_t Importer::GetSample(const uint8_t *tile, const glm::ivec2 &first, int rowLength, int x, int z) const
+{
+	if (!decoded.empty()) return decoded[(static_cast<uint64_t>(first.y + z) * width) + first.x + x];
+	const uint8_t *sample = tile + (((static_cast<uint64_t>(z) * rowLength) + x) * 2);
+	return static_cast<uint16_t>(sample[0] | (sample[1] << 8));
+}
+
+// Each chunk is one tile, converted by the generation job that loads the chunk, so tiles are converted in parallel as they stream in
+void Importer::Fill(int x, int z, const uint8_t *tile, WorldChunk &chunk)
+{
+	glm::ivec2 first, begin, end;
+	if (!GetBounds(x, z, first, begin, end)) return;
+
+	PROFILE_ZONE("Import tile");
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// A tile the world did not read, such as one whose read failed, is read here instead
+	static thread_local std::vector<uint8_t> readTile;
+	if (file && !tile) {
+		const Tile rows = GetTile(x, z);
+		readTile.resize(rows.rowSize * rows.rowCount);
+		if (!file->ReadRows(rows.offset, rows.rowSize, rows.stride, rows.rowCount, readTile.data())) {
+			Log::Error("Importer: Failed to read a tile, its chunk is left empty", {{"x", x}, {"z", z}});
+			return;
+		}
+		tile = readTile.data();
+	}
+
+	if (format == Format::Heightmap) FillHeightmap(tile, first, begin, end, chunk);
+	else FillVolume(tile, begin, end, chunk);
+	tilesConverted.fetch_add(1, std::memory_order_relaxed);
+	convertNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count(), std::memory_order_relaxed);
+}
+
+void Importer::FillHeightmap(const uint8_t *tile, const glm::ivec2 &first, const glm::ivec2 &begin, const glm::ivec2 &end, WorldChunk &chunk)
+{
+	std::array<int16_t, chunkWidth * chunkDepth> tops;
+	tops.fill(-1);
+	for (int iZ = begin.y; iZ < end.y; iZ++) {
+		for (int iX = begin.x; iX < end.x; iX++) {
+			const float top = std::floor(GetSample(tile, first, end.x - begin.x, iX - begin.x, iZ - begin.y) * heightScale);
+			tops[iZ * chunkWidth + iX] = static_cast<int16_t>(glm::clamp(top, 0.0f, chunkHeight - 1.0f));
+		}
+	}
+	WorldChunk::VoxelLayout::ForEach([&](int iX, int iY, int iZ, uint64_t) {
+		if (iY <= tops[iZ * chunkWidth + iX]) chunk.SetVoxel(iX, iY, iZ, 1);
+	});
+	bytesConverted.fetch_add(static_cast<uint64_t>(end.x - begin.x) * (end.y - begin.y) * 2, std::memory_order_relaxed);
+}
+
+void Importer::FillVolume(const uint8_t *tile, const glm::ivec2 &begin, const glm::ivec2 &end, WorldChunk &chunk)
+{
+	const int top = glm::min(height, chunkHeight);
+
+	const uint64_t rowBytes   = static_cast<uint64_t>(end.x - begin.x); // Rows are packed
+	const uint64_t sliceBytes = rowBytes * height;
+	WorldChunk::VoxelLayout::ForEach([&](int iX, int iY, int iZ, uint64_t) {
+		if (iX < begin.x || iX >= end.x || iZ < begin.y || iZ >= end.y || iY >= top) return;
+		const uint8_t voxel = tile[((iZ - begin.y) * sliceBytes) + (iY * rowBytes) + (iX - begin.x)];
+		if (voxel != 0) chunk.SetVoxel(iX, iY, iZ, voxel);
+	});
+
+	bytesConverted.fetch_add(static_cast<uint64_t>(end.x - begin.x) * (end.y - begin.y) * height, std::memory_order_relaxed);
+}
+
+void Importer::LogReport() const
+{
+	const double seconds   = convertNanoseconds.load(std::memory_order_relaxed) / 1e9;
+	const double megabytes = bytesConverted.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+	Log::Info("Importer: Report", {{"tiles", tilesConverted.load(std::memory_order_relaxed)}, {"megabytes", megabytes}, {"megabytesPerSecond", seconds > 0.0 ? megabytes / seconds : 0.0}, {"peakResidentMegabytes", GetPeakResidentMegabytes()}});
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+#include "World.hpp"
+#include <glm/vec2.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Terrain read from a heightmap or a voxel volume instead of generated, centred on the origin. Raw files are split into chunk aligned
+// tiles that are read through the AsyncIo lane as the chunks stream in and converted by generation jobs, so only the tiles in flight are
+// in memory and no worker waits on the disk. A tile is read as the rows of the file that cross its chunk, each only as wide as the chunk,
+// and arrives with its rows packed. The format is picked by extension:
+//   .r16 - square heightmap of little endian 16 bit samples
+//   .png - 8 or 16 bit heightmap, decoded into memory as a whole since it cannot be mapped
+//   .vol - volumeMagic, then width, height and depth as 32 bit integers, then one voxel per byte with x fastest, then y, then z
+class Importer : public ChunkSource
+{
+public:
+	static const uint32_t volumeMagic = 0x4C565856; // VXVL
+
+	static constexpr float defaultHeightScale = (chunkHeight - 1) / 65535.0f; // The full sample range spans the chunk height
+
+	Importer(const char *fileName, float heightScale = defaultHeightScale);
+
+	bool IsOpen() const { return width > 0; }
+	glm::ivec2 GetMinChunk() const; // Chunks outside these are left empty
+	glm::ivec2 GetMaxChunk() const;
+
+	Tile GetTile(int x, int z) const override;
+	void Fill(int x, int z, const uint8_t *tile, WorldChunk &chunk) override;
+
+	// Source bytes converted per second of conversion time across all jobs so far, and the peak resident set size of the process
+	void LogReport() const;
+private:
+	enum struct Format
+	{
+		Heightmap,
+		Volume
+	};
+
+	Format                         format      = Format::Heightmap;
+	float                          heightScale = defaultHeightScale;
+	std::shared_ptr<AsyncIo::File> file;
+	std::vector<uint16_t>          decoded;           // Samples of a PNG
+	uint64_t                       dataOffset = 0;    // Of the first sample or voxel in the file
+	int                            width      = 0;    // In samples or voxels
+	int                            height     = 0;    // Volumes only
+	int                            depth      = 0;
+	glm::ivec2                     origin     = {0, 0}; // World position of the first sample
+
+	std::atomic<uint64_t> tilesConverted{0};
+	std::atomic<uint64_t> bytesConverted{0};
+	std::atomic<uint64_t> convertNanoseconds{0};
+
+	bool GetBounds(int x, int z, glm::ivec2 &first, glm::ivec2 &begin, glm::ivec2 &end) const; // False if the chunk is outside the file
+	uint16_t GetSample(const uint8_t *tile, const glm::ivec2 &first, int rowLength, int x, int z) const;
+	void FillHeightmap(const uint8_t *tile, const glm::ivec2 &first, const glm::ivec2 &begin, const glm::ivec2 &end, WorldChunk &chunk);
+	void FillVolume(const uint8_t *tile, const glm::ivec2 &begin, const glm::ivec2 &end, WorldChunk &chunk);
+};
\ No newline at end of file
@@ -1,34 +1,94 @@
 #include "JobSystem.hpp"
 #include "Log.hpp"
-#include <queue>
+#include "Profiler.hpp"
 #include <thread>
 #include <mutex>
-#include <chrono>
+#include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <algorithm>
 
 namespace JobSystem
 {
 
-	std::queue<Job> jobQueue;
+	struct QueuedJob
+	{
+		Job job;
+		#ifdef PROFILER
+			uint64_t queueTime;
+		#endif
+	};
+
+	// A ring that keeps its capacity, so a steady stream of jobs stops allocating once it has grown to the longest queue
+	class JobQueue
+	{
+	public:
+		bool empty() const { return count == 0; }
+		size_t size() const { return count; }
+
+		void push(QueuedJob &&job)
+		{
+			if (count == ring.size()) Grow();
+			ring[(first + count) % ring.size()] = std::move(job);
+			count++;
+		}
+
+		QueuedJob pop()
+		{
+			QueuedJob job = std::move(ring[first]);
+			first = (first + 1) % ring.size();
+			count--;
+			return job;
+		}
+
+		void clear()
+		{
+			while (count > 0) pop();
+		}
+	private:
+		std::vector<QueuedJob> ring;
+		size_t                 first = 0;
+		size_t                 count = 0;
+
+		void Grow()
+		{
+			std::vector<QueuedJob> grown(std::max<size_t>(64, ring.size() * 2));
+			for (size_t i = 0; i < count; i++) grown[i] = std::move(ring[(first + i) % ring.size()]);
+			ring.swap(grown);
+			first = 0;
+		}
+	};
+
+	JobQueue jobQueue;
 	std::mutex queueLock;
+	std::condition_variable jobAdded;
+	std::condition_variable jobsFinished;
+	int runningJobs = 0;
 	std::vector<std::thread> threads;
 	std::atomic<bool> stop;
 
 	void _ThreadLoop()
 	{
-		// while (!jobQueue.empty()) {
-		while (!stop) {
-			queueLock.lock();
-			if (!jobQueue.empty()) {
-				const auto job = jobQueue.front();
-				jobQueue.pop();
-				queueLock.unlock();
-				job();
-			}
-			else {
-				queueLock.unlock();
-				std::this_thread::sleep_for(std::chrono::seconds(2));
-			}
+		#ifdef PROFILER
+			static std::atomic<int> workerCount{0};
+			const std::string threadName = "Worker " + std::to_string(workerCount++);
+			PROFILE_THREAD_NAME(threadName.c_str());
+		#endif
+		std::unique_lock<std::mutex> guard(queueLock);
+		while (true) {
+			jobAdded.wait(guard, []() { return stop || !jobQueue.empty(); });
+			if (stop) break;
+
+			const QueuedJob queuedJob = jobQueue.pop();
+			runningJobs++;
+			guard.unlock();
+			#ifdef PROFILER
+				Profiler::AddZone("Queued", queuedJob.queueTime, Profiler::Now());
+			#endif
+			queuedJob.job();
+			guard.lock();
+			runningJobs--;
+			if (runningJobs == 0 && jobQueue.empty()) jobsFinished.notify_all();
 		}
 	}
 
@@ -44,20 +104,73 @@ namespace JobSystem
 
 	void StopThreads()
 	{
-		stop = true;
 		queueLock.lock();
-		while (!jobQueue.empty()) {
-			jobQueue.pop();
-		}
-
+		stop = true;
+		jobQueue.clear();
 		queueLock.unlock();
+		jobAdded.notify_all();
+		jobsFinished.notify_all();
 		for (std::thread &thread : threads) {
 			thread.join();
 		}
 	}
 
-	void AddJob(const Job &job)
+	void AddJob(Job job)
+	{
+		{
+			std::lock_guard<std::mutex> guard(queueLock);
+			#ifdef PROFILER
+				jobQueue.push({std::move(job), Profiler::Now()});
+			#else
+				jobQueue.push({std::move(job)});
+			#endif
+		}
+		jobAdded.notify_one();
+	}
+
+	size_t GetQueuedCount()
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		return jobQueue.size();
+	}
+
+	void WaitForIdle()
+	{
+		std::unique_lock<std::mutex> guard(queueLock);
+		jobsFinished.wait(guard, []() { return stop || (runningJobs == 0 && jobQueue.empty()); });
+	}
+
+	void RunBatch(const std::vector<Job> &jobs)
 	{
-		jobQueue.push(job);
+		if (jobs.empty()) return;
+		// Points at the caller's jobs, which outlive every job taken since the call waits for all of them
+		struct Batch
+		{
+			const Job              *jobs;
+			size_t                  count;
+			std::atomic<size_t>     next{0};
+			std::mutex              lock;
+			std::condition_variable finished;
+			size_t                  finishedCount = 0;
+		};
+
+		// Helpers that start after every job was taken return straight away, the batch lives until the last of them does
+		const auto batch = std::allocate_shared<Batch>(Pool::Allocator<Batch>());
+		batch->jobs  = jobs.data();
+		batch->count = jobs.size();
+		const auto run = [batch]() {
+			size_t index;
+			while ((index = batch->next.fetch_add(1)) < batch->count) {
+				batch->jobs[index]();
+				std::lock_guard<std::mutex> guard(batch->lock);
+				if (++batch->finishedCount == batch->count) batch->finished.notify_all();
+			}
+		};
+
+		const size_t helpers = std::min(jobs.size() - 1, threads.size());
+		for (size_t i = 0; i < helpers; i++) AddJob(run);
+		run();
+		std::unique_lock<std::mutex> guard(batch->lock);
+		batch->finished.wait(guard, [&batch]() { return batch->finishedCount == batch->count; });
 	}
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #pragma once
-#include <functional>
+#include "Pool.hpp"
+#include <cstddef>
+#include <vector>
 
 namespace JobSystem
 {
-	using Job = std::function<void(void)>;
+	using Job = Pool::Function<void(void)>; // Captures beyond a few pointers go in a pooled block, so queueing a job does not reach the heap
 
 	void StartThreads(int threadCount = 0);
 	void StopThreads();
-	void AddJob(const Job &Job);
+	void AddJob(Job job); // Moved into the queue, so a job built in the call is never copied
+
+	// Runs the jobs on the workers and blocks until all of them have finished, the calling thread runs jobs too so a busy queue cannot stall it
+	void RunBatch(const std::vector<Job> &jobs);
+
+	size_t GetQueuedCount(); // Jobs waiting for a worker, running ones are not counted
+
+	// Blocks until the queue is empty and no job is running, jobs added by running jobs are waited for as well
+	void WaitForIdle();
 }
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include "Lighting.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include <array>
+#include <functional>
+
+static const glm::ivec2 sideOffsets[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}}; // Same order as the chunk's border light
+
+static uint8_t GetLight(const WorldChunk &chunk, int channel, int x, int y, int z)
+{
+	return channel == 0 ? chunk.GetSkyLight(x, y, z) : chunk.GetBlockLight(x, y, z);
+}
+
+// The voxel on a side of the chunk, i runs along the side
+static glm::ivec3 GetBorderVoxel(int side, int y, int i)
+{
+	switch (side) {
+		case 0:  return glm::ivec3(0, y, i);
+		case 1:  return glm::ivec3(chunkWidth - 1, y, i);
+		case 2:  return glm::ivec3(i, y, 0);
+		default: return glm::ivec3(i, y, chunkDepth - 1);
+	}
+}
+
+static bool IsOnBorder(int x, int z)
+{
+	return x == 0 || x == chunkWidth - 1 || z == 0 || z == chunkDepth - 1;
+}
+
+void Lighting::AddChunk(const std::shared_ptr<WorldChunk> &chunk, int x, int z, bool lit)
+{
+	std::lock_guard<std::mutex> guard(inputLock);
+	inputs.push_back({chunk, glm::ivec2(x, z), {}, lit});
+	Schedule();
+}
+
+void Lighting::VoxelsChanged(int x, int z, std::vector<glm::ivec3> positions)
+{
+	std::lock_guard<std::mutex> guard(inputLock);
+	inputs.push_back({nullptr, glm::ivec2(x, z), std::move(positions), false});
+	Schedule();
+}
+
+void Lighting::TakeChangedChunks(std::vector<glm::ivec2> &coordinates)
+{
+	coordinates.clear();
+	std::lock_guard<std::mutex> guard(inputLock);
+	coordinates.swap(changedChunks);
+}
+
+uint8_t Lighting::GetEmission(uint8_t voxel)
+{
+	return voxel == lampVoxel ? 14 : 0;
+}
+
+uint64_t Lighting::GetKey(int x, int z)
+{
+	uint64_t key;
+	*(reinterpret_cast<int*>(&key) + 0) = x;
+	*(reinterpret_cast<int*>(&key) + 1) = z;
+	return key;
+}
+
+glm::ivec2 Lighting::GetCoordinate(uint64_t key)
+{
+	return glm::ivec2(*(reinterpret_cast<const int*>(&key) + 0), *(reinterpret_cast<const int*>(&key) + 1));
+}
+
+// Called with the input lock held
+void Lighting::Schedule()
+{
+	if (running) return;
+	running = true;
+	JobSystem::AddJob(std::bind(&Lighting::Run, shared_from_this()));
+}
+
+void Lighting::Run()
+{
+	while (true) {
+		{
+			std::lock_guard<std::mutex> guard(inputLock);
+			if (inputs.empty()) {
+				running = false;
+				return;
+			}
+			pending.swap(inputs);
+		}
+		Propagate();
+		pending.clear();
+	}
+}
+
+void Lighting::Propagate()
+{
+	PROFILE_ZONE("Propagate light");
+	for (Input &input : pending) {
+		const uint64_t key = GetKey(input.coordinate.x, input.coordinate.y);
+		if (input.chunk) {
+			chunks[key] = input.chunk;
+			Work &entry = GetWork(key);
+			entry.initialize = true;
+			entry.lit        = input.lit;
+			if (!input.lit) added.push_back(input.chunk);
+			// Their border light has to be copied into the new chunk
+			for (const glm::ivec2 &offset : sideOffsets) {
+				const uint64_t neighbourKey = GetKey(input.coordinate.x + offset.x, input.coordinate.y + offset.y);
+				if (chunks.count(neighbourKey) != 0) bordersChanged.insert(neighbourKey);
+			}
+		}
+		else {
+			std::vector<glm::ivec3> &changes = GetWork(key).changes;
+			changes.insert(changes.end(), input.positions.begin(), input.positions.end());
+		}
+	}
+
+	// New chunks and edits are turned into removal and add nodes
+	for (auto &it : work) {
+		Work &entry = it.second;
+		if (!entry.initialize && entry.changes.empty()) continue;
+		const auto chunk = chunks.count(it.first) != 0 ? chunks[it.first].lock() : nullptr;
+		if (!chunk) continue;
+		const auto guard = chunk->LockVoxels();
+		Context context = {*chunk, it.first, entry};
+		if (entry.initialize) Initialize(context);
+		for (const glm::ivec3 &position : entry.changes) ApplyChange(context, position);
+		entry.changes.clear();
+	}
+	DeliverBorderNodes();
+
+	// Every removal finishes before light is added back, otherwise light could flow in from voxels that are about to go dark
+	for (const int channel : {sky, block}) {
+		while (ProcessQueues(channel, true)) {}
+		while (ProcessQueues(channel, false)) {}
+	}
+	for (const auto &it : work) {
+		if (it.second.lightChanged)  changed.insert(it.first);
+		if (it.second.borderChanged) bordersChanged.insert(it.first);
+	}
+	UpdateBorders();
+
+	// New chunks are meshed here rather than by the world, which would mesh them before they are lit
+	for (const auto &chunk : added) {
+		JobSystem::AddJob(std::bind(&WorldChunk::UpdateVertices, chunk));
+	}
+	added.clear();
+	for (const auto &it : work) {
+		if (it.second.initialize && !it.second.lit) changed.erase(it.first);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		for (const uint64_t key : changed) changedChunks.push_back(GetCoordinate(key));
+	}
+	changed.clear();
+	bordersChanged.clear();
+	for (auto &it : work) {
+		if (spareWork.size() >= maxSpareWork) break;
+		Work &entry = it.second;
+		for (const int channel : {sky, block}) {
+			entry.add[channel].clear();
+			entry.remove[channel].clear();
+		}
+		entry.outgoing.clear();
+		entry.changes.clear();
+		entry.initialize    = false;
+		entry.lit           = false;
+		entry.lightChanged  = false;
+		entry.borderChanged = false;
+		spareWork.push_back(std::move(entry));
+	}
+	work.clear();
+	for (auto it = chunks.begin(); it != chunks.end();) {
+		if (it->second.expired()) it = chunks.erase(it);
+		else it++;
+	}
+}
+
+Lighting::Work &Lighting::GetWork(uint64_t key)
+{
+	const auto it = work.find(key);
+	if (it != work.end()) return it->second;
+	if (spareWork.empty()) return work[key];
+	Work &entry = work.emplace(key, std::move(spareWork.back())).first->second;
+	spareWork.pop_back();
+	return entry;
+}
+
+// Chunks of one colour are never neighbours, so their queues are processed in parallel and only write to their own work
+bool Lighting::ProcessQueues(int channel, bool removals)
+{
+	bool processed = false;
+	std::vector<JobSystem::Job> &jobs = colourJobs;
+	for (int colour = 0; colour < 4; colour++) {
+		jobs.clear();
+		for (auto &it : work) {
+			const glm::ivec2 coordinate = GetCoordinate(it.first);
+			if (((coordinate.x & 1) | ((coordinate.y & 1) << 1)) != colour) continue;
+			std::vector<Node> &queue = removals ? it.second.remove[channel] : it.second.add[channel];
+			if (queue.empty()) continue;
+			const auto found = chunks.find(it.first);
+			const auto chunk = found != chunks.end() ? found->second.lock() : nullptr;
+			if (!chunk) {
+				queue.clear();
+				continue;
+			}
+			jobs.push_back([this, chunk, key = it.first, &entry = it.second, channel, removals]() {
+				const auto guard = chunk->LockVoxels();
+				Context context = {*chunk, key, entry};
+				if (removals) ProcessRemovals(context, channel);
+				else ProcessAdds(context, channel);
+			});
+		}
+		if (jobs.empty()) continue;
+		JobSystem::RunBatch(jobs);
+		jobs.clear(); // Releases the chunks
+		DeliverBorderNodes();
+		processed = true;
+	}
+	return processed;
+}
+
+void Lighting::DeliverBorderNodes()
+{
+	for (auto &it : work) {
+		for (const BorderNode &border : it.second.outgoing) {
+			Work &target = GetWork(border.key);
+			(border.removal ? target.remove : target.add)[border.channel].push_back(border.node);
+		}
+		it.second.outgoing.clear();
+	}
+}
+
+// Light within the chunk as if it had no neighbours
+void Lighting::InitializeInterior(Context &context)
+{
+	WorldChunk &chunk = context.chunk;
+
+	// Sky light falls straight down to the first opaque voxel
+	for (int z = 0; z < chunkDepth; z++) {
+		for (int x = 0; x < chunkWidth; x++) {
+			for (int y = chunkHeight - 1; y >= 0 && !chunk.TestPos(x, y, z); y--) {
+				chunk.SetSkyLight(x, y, z, 15);
+			}
+		}
+	}
+
+	// Sky light spreads sideways under overhangs, block light spreads from emitters
+	chunk.ForEachVoxel([&](int x, int y, int z, uint8_t voxel) {
+		if (const uint8_t emission = GetEmission(voxel)) {
+			chunk.SetBlockLight(x, y, z, emission);
+			context.work.add[block].push_back({uint8_t(x), uint8_t(y), uint8_t(z), 0, SpreadFrom});
+		}
+		if (chunk.GetSkyLight(x, y, z) != 15) return;
+		for (const glm::ivec2 &offset : sideOffsets) {
+			const int nX = x + offset.x;
+			const int nZ = z + offset.y;
+			if (nX < 0 || nZ < 0 || nX >= chunkWidth || nZ >= chunkDepth) continue;
+			if (!chunk.TestPos(nX, y, nZ) && chunk.GetSkyLight(nX, y, nZ) < 14) {
+				context.work.add[sky].push_back({uint8_t(x), uint8_t(y), uint8_t(z), 0, SpreadFrom});
+				break;
+			}
+		}
+	});
+}
+
+// Chunks that kept their light skip lighting their interior
+void Lighting::Initialize(Context &context)
+{
+	if (!context.work.lit) InitializeInterior(context);
+
+	// Light is exchanged both ways with neighbours that are already lit
+	for (int side = 0; side < 4; side++) {
+		const glm::ivec2 neighbour    = GetCoordinate(context.key) + sideOffsets[side];
+		const uint64_t   neighbourKey = GetKey(neighbour.x, neighbour.y);
+		if (chunks.count(neighbourKey) == 0 || chunks[neighbourKey].expired()) continue;
+		Work &neighbourWork = GetWork(neighbourKey);
+		const int length = side < 2 ? chunkDepth : chunkWidth;
+		for (int y = 0; y < chunkHeight; y++) {
+			for (int i = 0; i < length; i++) {
+				const glm::ivec3 own   = GetBorderVoxel(side, y, i);
+				const glm::ivec3 other = GetBorderVoxel(side ^ 1, y, i);
+				for (const int channel : {sky, block}) {
+					context.work.add[channel].push_back({uint8_t(own.x), uint8_t(own.y), uint8_t(own.z), 0, SpreadFrom});
+					neighbourWork.add[channel].push_back({uint8_t(other.x), uint8_t(other.y), uint8_t(other.z), 0, SpreadFrom});
+				}
+			}
+		}
+	}
+	if (!context.work.lit) changed.insert(context.key);
+	bordersChanged.insert(context.key);
+}
+
+void Lighting::ApplyChange(Context &context, const glm::ivec3 &position)
+{
+	const uint8_t voxel = context.chunk.GetVoxel(position.x, position.y, position.z);
+	if (IsOnBorder(position.x, position.z)) bordersChanged.insert(context.key); // Opacity shows in the neighbours' border light
+
+	RemoveAt(context, block, position.x, position.y, position.z);
+	if (const uint8_t emission = GetEmission(voxel)) {
+		SetLight(context, block, position.x, position.y, position.z, emission);
+		Push(context, block, false, position.x, position.y, position.z, 0, SpreadFrom);
+	}
+	if (voxel != 0) {
+		RemoveAt(context, sky, position.x, position.y, position.z);
+		return;
+	}
+
+	// An emptied voxel takes light from its neighbours once the removals are done
+	for (const glm::ivec3 &normal : faceNormals) {
+		const glm::ivec3 neighbour = position + normal;
+		if (neighbour.y >= chunkHeight) {
+			Push(context, sky, false, position.x, position.y, position.z, 15, 0);
+			continue;
+		}
+		Push(context, sky, false, neighbour.x, neighbour.y, neighbour.z, 0, SpreadFrom);
+		Push(context, block, false, neighbour.x, neighbour.y, neighbour.z, 0, SpreadFrom);
+	}
+}
+
+void Lighting::ProcessRemovals(Context &context, int channel)
+{
+	std::vector<Node> &queue = context.work.remove[channel];
+	for (size_t i = 0; i < queue.size(); i++) {
+		const Node node  = queue[i]; // Copied, removing can grow the queue
+		const uint8_t level = GetLight(context.chunk, channel, node.x, node.y, node.z);
+		if (level == 0) continue;
+
+		// Light that could not have come from the removed voxel is a source for refilling what was removed
+		const bool emitter  = channel == block && GetEmission(context.chunk.GetVoxel(node.x, node.y, node.z)) > 0;
+		const bool skyShaft = channel == sky && (node.flags & FromAbove) && node.level == 15 && level == 15;
+		if (!emitter && (level < node.level || skyShaft)) {
+			RemoveAt(context, channel, node.x, node.y, node.z);
+		}
+		else {
+			context.work.add[channel].push_back({node.x, node.y, node.z, 0, SpreadFrom});
+		}
+	}
+	queue.clear();
+}
+
+void Lighting::ProcessAdds(Context &context, int channel)
+{
+	std::vector<Node> &queue = context.work.add[channel];
+	for (size_t i = 0; i < queue.size(); i++) {
+		const Node node = queue[i]; // Copied, spreading can grow the queue
+		uint8_t level = node.level;
+		if (node.flags & SpreadFrom) {
+			level = GetLight(context.chunk, channel, node.x, node.y, node.z);
+			if (level <= 1) continue;
+		}
+		else {
+			if (GetLight(context.chunk, channel, node.x, node.y, node.z) >= level || context.chunk.TestPos(node.x, node.y, node.z)) continue;
+			SetLight(context, channel, node.x, node.y, node.z, level);
+		}
+		Spread(context, channel, node.x, node.y, node.z, level);
+	}
+	queue.clear();
+}
+
+void Lighting::RemoveAt(Context &context, int channel, int x, int y, int z)
+{
+	const uint8_t level = GetLight(context.chunk, channel, x, y, z);
+	if (level == 0) return;
+	SetLight(context, channel, x, y, z, 0);
+	for (const glm::ivec3 &normal : faceNormals) {
+		Push(context, channel, true, x + normal.x, y + normal.y, z + normal.z, level, normal.y < 0 ? FromAbove : 0);
+	}
+}
+
+// Full sky light travels down without fading
+void Lighting::Spread(Context &context, int channel, int x, int y, int z, uint8_t level)
+{
+	for (const glm::ivec3 &normal : faceNormals) {
+		const uint8_t next = (channel == sky && level == 15 && normal.y < 0) ? 15 : level - 1;
+		if (next > 0) Push(context, channel, false, x + normal.x, y + normal.y, z + normal.z, next, 0);
+	}
+}
+
+// Positions outside the chunk go to the neighbour's queue once the colour is done, or nowhere if it is not lit yet since it pulls light in when it is
+void Lighting::Push(Context &context, int channel, bool removal, int x, int y, int z, uint8_t level, uint8_t flags)
+{
+	if (y < 0 || y >= chunkHeight) return;
+	if (x < 0 || z < 0 || x >= chunkWidth || z >= chunkDepth) {
+		const glm::ivec2 offset(x < 0 ? -1 : (x >= chunkWidth ? 1 : 0), z < 0 ? -1 : (z >= chunkDepth ? 1 : 0));
+		const glm::ivec2 neighbour = GetCoordinate(context.key) + offset;
+		const uint64_t   key       = GetKey(neighbour.x, neighbour.y);
+		const auto it = chunks.find(key);
+		if (it == chunks.end() || it->second.expired()) return;
+		const Node node = {uint8_t(x - (offset.x * chunkWidth)), uint8_t(y), uint8_t(z - (offset.y * chunkDepth)), level, flags};
+		context.work.outgoing.push_back({key, uint8_t(channel), removal, node});
+		return;
+	}
+	(removal ? context.work.remove : context.work.add)[channel].push_back({uint8_t(x), uint8_t(y), uint8_t(z), level, flags});
+}
+
+void Lighting::SetLight(Context &context, int channel, int x, int y, int z, uint8_t level)
+{
+	if (channel == sky) context.chunk.SetSkyLight(x, y, z, level);
+	else context.chunk.SetBlockLight(x, y, z, level);
+	context.work.lightChanged = true;
+	if (IsOnBorder(x, z)) context.work.borderChanged = true;
+}
+
+// Faces on a chunk's border show the light of the neighbouring chunk. Opaque voxels are copied as open sky, the faces
+// against them are hidden and would otherwise cause a remesh every time a chunk is added next to another
+void Lighting::UpdateBorders()
+{
+	std::array<uint8_t, chunkHeight * WorldChunk::borderLength> plane;
+	for (const uint64_t key : bordersChanged) {
+		const auto source = chunks.count(key) != 0 ? chunks[key].lock() : nullptr;
+		if (!source) continue;
+		const glm::ivec2 coordinate = GetCoordinate(key);
+		for (int side = 0; side < 4; side++) {
+			const glm::ivec2 neighbourCoordinate = coordinate + sideOffsets[side];
+			const uint64_t   neighbourKey        = GetKey(neighbourCoordinate.x, neighbourCoordinate.y);
+			const auto neighbour = chunks.count(neighbourKey) != 0 ? chunks[neighbourKey].lock() : nullptr;
+			if (!neighbour) continue;
+
+			const int length = side < 2 ? chunkDepth : chunkWidth;
+			{
+				const auto guard = source->LockVoxelsShared();
+				for (int y = 0; y < chunkHeight; y++) {
+					for (int i = 0; i < length; i++) {
+						const glm::ivec3 voxel = GetBorderVoxel(side, y, i);
+						plane[(y * length) + i] = source->TestPos(voxel.x, voxel.y, voxel.z) ? 0xF0 : source->GetFaceLight(voxel.x, voxel.y, voxel.z);
+					}
+				}
+			}
+
+			// The neighbour sees this chunk across its opposite side
+			const int opposite = side ^ 1;
+			bool      visible  = false;
+			{
+				const auto guard = neighbour->LockVoxels();
+				for (int y = 0; y < chunkHeight; y++) {
+					for (int i = 0; i < length; i++) {
+						const uint8_t light = plane[(y * length) + i];
+						if (neighbour->GetBorderLight(opposite, y, i) == light) continue;
+						neighbour->SetBorderLight(opposite, y, i, light);
+						const glm::ivec3 voxel = GetBorderVoxel(opposite, y, i);
+						visible |= neighbour->TestPos(voxel.x, voxel.y, voxel.z);
+					}
+				}
+			}
+			if (visible) changed.insert(neighbourKey);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include "World.hpp"
+#include "JobSystem.hpp"
+#include "Pool.hpp"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Sky and block light flood filled through the world on the job system, and updated incrementally where voxels change
+// One propagation job runs at a time. It spreads light through a checkerboard of four colours of chunks, one colour at a time in parallel,
+// so no two neighbours are lit at once. Light that crosses a border is handed to the neighbour's queue once its colour is done
+class Lighting : public std::enable_shared_from_this<Lighting>
+{
+public:
+	// Lights a chunk that was just generated and is still in the Meshing state, then meshes it. Chunks that were restored with their light
+	// and mesh are only lit where light crosses from their neighbours, and remeshed by the world if that changes them
+	void AddChunk(const std::shared_ptr<WorldChunk> &chunk, int x, int z, bool lit = false);
+
+	// Positions are local to the chunk, called once the voxels have changed
+	void VoxelsChanged(int x, int z, std::vector<glm::ivec3> positions);
+
+	// Chunk coordinates whose light changed since the last call, they need a remesh. Swapped into coordinates, so both keep their capacity
+	void TakeChangedChunks(std::vector<glm::ivec2> &coordinates);
+
+	static uint8_t GetEmission(uint8_t voxel);
+private:
+	static constexpr int sky   = 0;
+	static constexpr int block = 1;
+
+	enum NodeFlags : uint8_t
+	{
+		SpreadFrom = 1, // Spread the light the voxel already has instead of offering it a level
+		FromAbove  = 2  // Removal came from the voxel above, which takes full sky light with it
+	};
+
+	struct Node
+	{
+		uint8_t x, y, z;
+		uint8_t level;
+		uint8_t flags;
+	};
+
+	struct Input
+	{
+		std::shared_ptr<WorldChunk> chunk; // Set for new chunks
+		glm::ivec2                  coordinate;
+		std::vector<glm::ivec3>     positions;
+		bool                        lit;
+	};
+
+	// A node for a neighbouring chunk, queued there between colours
+	struct BorderNode
+	{
+		uint64_t key;
+		uint8_t  channel;
+		bool     removal;
+		Node     node;
+	};
+
+	// Written only by the job lighting the chunk, or by the propagation job between colours
+	struct Work
+	{
+		std::vector<Node>       add[2];
+		std::vector<Node>       remove[2];
+		std::vector<BorderNode> outgoing;
+		std::vector<glm::ivec3> changes;
+		bool                    initialize    = false;
+		bool                    lit           = false; // Initialized by only exchanging light with the neighbours
+		bool                    lightChanged  = false;
+		bool                    borderChanged = false; // Light on the border changed, so the neighbours' border light needs copying
+	};
+
+	// Everything a chunk's queues touch while it is locked
+	struct Context
+	{
+		WorldChunk &chunk;
+		uint64_t    key;
+		Work       &work;
+	};
+
+	std::mutex              inputLock;
+	std::vector<Input>      inputs;
+	std::vector<glm::ivec2> changedChunks;
+	bool                    running = false;
+
+	// Only used by the propagation job, the jobs it runs for each colour only read chunks. Pooled and kept between
+	// propagations, so lighting a steady stream of chunks stops allocating
+	Pool::Map<uint64_t, std::weak_ptr<WorldChunk>> chunks;
+	Pool::Map<uint64_t, Work>                      work;
+	std::vector<Work>                              spareWork; // Emptied work that keeps the capacity its queues grew to
+	Pool::Set<uint64_t>                            changed;
+	Pool::Set<uint64_t>                            bordersChanged;
+	std::vector<Input>                             pending;   // Swapped with inputs
+	std::vector<std::shared_ptr<WorldChunk>>       added;
+	std::vector<JobSystem::Job>                    colourJobs;
+
+	static constexpr size_t maxSpareWork = 64;
+
+	static uint64_t GetKey(int x, int z);
+	static glm::ivec2 GetCoordinate(uint64_t key);
+
+	void Schedule();
+	void Run();
+	void Propagate();
+	Work &GetWork(uint64_t key); // Reuses spare work for new entries
+	bool ProcessQueues(int channel, bool removals);
+	void DeliverBorderNodes();
+
+	void Initialize(Context &context);
+	void InitializeInterior(Context &context);
+	void ApplyChange(Context &context, const glm::ivec3 &position);
+	void ProcessRemovals(Context &context, int channel);
+	void ProcessAdds(Context &context, int channel);
+	void RemoveAt(Context &context, int channel, int x, int y, int z);
+	void Spread(Context &context, int channel, int x, int y, int z, uint8_t level);
+	void Push(Context &context, int channel, bool removal, int x, int y, int z, uint8_t level, uint8_t flags);
+	void SetLight(Context &context, int channel, int x, int y, int z, uint8_t level);
+	void UpdateBorders();
+};
\ No newline at end of file
@@ -1,11 +1,218 @@
 #include "Log.hpp"
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
-void Log::Error(const std::string &message)
+namespace Log
 {
-	std::cerr << message << '\n';
+	static const size_t maxFields     = 4;
+	static const size_t maxTextLength = 192;
+	static const size_t maxParts      = 32; // Longer messages are written directly instead of queued
+
+	struct Entry
+	{
+		std::atomic<uint64_t> sequence;
+		uint64_t              time;
+		uint32_t              threadID;
+		Severity              severity;
+		uint8_t               fieldCount;
+		bool                  continued; // The message goes on in the next entry
+		uint16_t              length;
+		Field                 fields[maxFields] = {{"", 0}, {"", 0}, {"", 0}, {"", 0}};
+		char                  text[maxTextLength];
+	};
+
+	// Bounded multi-producer queue, each slot's sequence tells producers and the drain thread whose turn it is
+	static const uint64_t capacity = 4096;
+	static Entry                 entries[capacity];
+	static std::atomic<uint64_t> enqueuePosition{0};
+	static uint64_t              dequeuePosition = 0; // Only used by the drain thread
+	static std::atomic<uint64_t> droppedCount{0};
+
+	static std::atomic<bool>     running{false};
+	static std::atomic<bool>     stop{false};
+	static std::thread           drainThread;
+	static std::atomic<Severity> minimumSeverity{
+		#ifdef DEBUG
+			Severity::Debug
+		#else
+			Severity::Info
+		#endif
+	};
+
+	static std::mutex outputLock;
+	static const auto startTime = std::chrono::steady_clock::now();
+
+	// Repeats of a message beyond the limit are counted and summarised once the window ends
+	static const uint64_t repeatWindow = 1000000000;
+	static const uint32_t repeatLimit  = 5;
+
+	struct RepeatState
+	{
+		uint64_t windowStart;
+		uint32_t count;
+		Severity severity;
+	};
+	static std::unordered_map<std::string, RepeatState> repeats;
+
+	static const char *severityNames[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+	static uint64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	static uint32_t GetThreadID()
+	{
+		static std::atomic<uint32_t> nextThreadID{0};
+		thread_local const uint32_t threadID = nextThreadID++;
+		return threadID;
+	}
+
+	static void Output(Severity severity, uint64_t time, uint32_t threadID, std::string_view text, const Field *fields, size_t fieldCount)
+	{
+		char prefix[64];
+		snprintf(prefix, sizeof(prefix), "[%10.6f] [T%u] %-7s ", time / 1e9, threadID, severityNames[static_cast<int>(severity)]);
+		char fieldText[256];
+		int length = 0;
+		fieldText[0] = '\0';
+		for (size_t i = 0; i < fieldCount && length >= 0 && length < (int)sizeof(fieldText); i++) {
+			if (fields[i].isFloat) length += snprintf(fieldText + length, sizeof(fieldText) - length, " %s=%g", fields[i].name, fields[i].floatValue);
+			else length += snprintf(fieldText + length, sizeof(fieldText) - length, " %s=%lld", fields[i].name, static_cast<long long>(fields[i].integerValue));
+		}
+
+		std::lock_guard<std::mutex> guard(outputLock);
+		FILE *stream = severity == Severity::Error ? stderr : stdout;
+		fputs(prefix, stream);
+		fwrite(text.data(), 1, text.size(), stream);
+		fputs(fieldText, stream);
+		fputc('\n', stream);
+	}
+
+	static void FlushRepeats(uint64_t time, bool all)
+	{
+		for (auto it = repeats.begin(); it != repeats.end();) {
+			if (!all && time - it->second.windowStart < repeatWindow) {
+				it++;
+				continue;
+			}
+			if (it->second.count > repeatLimit) {
+				const std::string summary = "Suppressed " + std::to_string(it->second.count - repeatLimit) + " repeats of: " + it->first;
+				Output(it->second.severity, time, GetThreadID(), summary, nullptr, 0);
+			}
+			it = repeats.erase(it);
+		}
+	}
+
+	static std::string pendingText; // Collects the parts of a long message until its last one, only used by the drain thread
+
+	static void OutputEntry(const Entry &entry)
+	{
+		pendingText.append(entry.text, entry.length);
+		if (entry.continued) return;
+		RepeatState &state = repeats.try_emplace(pendingText, RepeatState{entry.time, 0, entry.severity}).first->second;
+		if (++state.count <= repeatLimit) Output(entry.severity, entry.time, entry.threadID, pendingText, entry.fields, entry.fieldCount);
+		pendingText.clear();
+	}
+
+	static bool Drain()
+	{
+		bool drained = false;
+		while (true) {
+			Entry &entry = entries[dequeuePosition % capacity];
+			if (entry.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) break;
+			OutputEntry(entry);
+			entry.sequence.store(dequeuePosition + capacity, std::memory_order_release);
+			dequeuePosition++;
+			drained = true;
+		}
+
+		const uint64_t dropped = droppedCount.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0) Output(Severity::Warning, Now(), GetThreadID(), "Log: Queue full, dropped " + std::to_string(dropped) + " messages", nullptr, 0);
+		return drained;
+	}
+
+	static void DrainLoop()
+	{
+		while (!stop.load(std::memory_order_acquire)) {
+			if (!Drain()) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			FlushRepeats(Now(), false);
+		}
+		Drain();
+		FlushRepeats(Now(), true);
+		fflush(stdout);
+	}
+}
+
+void Log::Initialize()
+{
+	if (running) return;
+	for (uint64_t i = 0; i < capacity; i++) entries[i].sequence.store(i, std::memory_order_relaxed);
+	enqueuePosition = 0;
+	dequeuePosition = 0;
+	stop            = false;
+	drainThread     = std::thread(DrainLoop);
+	running         = true;
+}
+
+void Log::Cleanup()
+{
+	if (!running) return;
+	running = false;
+	stop    = true;
+	drainThread.join();
 }
-void Log::Info(const std::string &message)
+
+void Log::SetMinimumSeverity(Severity severity)
 {
-	std::cout << message << '\n';
+	minimumSeverity = severity;
+}
+
+void Log::Write(Severity severity, std::string_view message, std::initializer_list<Field> fields)
+{
+	if (severity < minimumSeverity.load(std::memory_order_relaxed)) return;
+	const uint64_t time = Now();
+	const size_t parts = std::max<size_t>(1, (message.size() + maxTextLength - 1) / maxTextLength);
+	if (!running.load(std::memory_order_acquire) || parts > maxParts) {
+		Output(severity, time, GetThreadID(), message, fields.begin(), std::min(fields.size(), maxFields));
+		return;
+	}
+
+	// Claims the next slots unless the drain thread has not released them yet, a full queue drops the message instead of blocking.
+	// Slots are released in order, so the last of them being free means all of them are
+	uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+	while (true) {
+		const uint64_t last     = position + parts - 1;
+		const uint64_t sequence = entries[last % capacity].sequence.load(std::memory_order_acquire);
+		if (sequence == last) {
+			if (enqueuePosition.compare_exchange_weak(position, position + parts, std::memory_order_relaxed)) break;
+		}
+		else if (sequence < last) {
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else position = enqueuePosition.load(std::memory_order_relaxed);
+	}
+
+	// A long message is split over consecutive slots, its fields go with the last part
+	const uint32_t threadID = GetThreadID();
+	for (size_t part = 0; part < parts; part++) {
+		Entry &entry = entries[(position + part) % capacity];
+		const size_t offset = part * maxTextLength;
+		const bool   isLast = part + 1 == parts;
+		entry.time       = time;
+		entry.threadID   = threadID;
+		entry.severity   = severity;
+		entry.continued  = !isLast;
+		entry.length     = static_cast<uint16_t>(std::min(message.size() - offset, maxTextLength));
+		entry.fieldCount = isLast ? static_cast<uint8_t>(std::min(fields.size(), maxFields)) : 0;
+		memcpy(entry.text, message.data() + offset, entry.length);
+		std::copy(fields.begin(), fields.begin() + entry.fieldCount, entry.fields);
+		entry.sequence.store(position + part + 1, std::memory_order_release);
+	}
 }
\ No newline at end of file
@@ -1,8 +1,49 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <initializer_list>
 
+// Messages are queued without locking or allocating and written by a background thread, before Initialize and after Cleanup they are written directly
+// Messages take a queue slot per 192 characters and keep 4 fields, repeats of a message beyond 5 a second are summarised instead of written
 namespace Log
 {
-	void Error(const std::string &message);
-	void Info(const std::string &message);
+	enum struct Severity : uint8_t
+	{
+		Debug,
+		Info,
+		Warning,
+		Error
+	};
+
+	// Field names must outlive the message, use string literals
+	struct Field
+	{
+		template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+		Field(const char *name, T value) : name(name), isFloat(std::is_floating_point_v<T>)
+		{
+			if constexpr (std::is_floating_point_v<T>) floatValue = value;
+			else integerValue = static_cast<int64_t>(value);
+		}
+
+		const char *name;
+		bool        isFloat;
+		union
+		{
+			int64_t integerValue;
+			double  floatValue;
+		};
+	};
+
+	void Initialize();
+	void Cleanup(); // Writes every queued message before returning
+
+	void SetMinimumSeverity(Severity severity);
+
+	void Write(Severity severity, std::string_view message, std::initializer_list<Field> fields = {});
+	inline void Debug(std::string_view message, std::initializer_list<Field> fields = {})   { Write(Severity::Debug, message, fields); }
+	inline void Info(std::string_view message, std::initializer_list<Field> fields = {})    { Write(Severity::Info, message, fields); }
+	inline void Warning(std::string_view message, std::initializer_list<Field> fields = {}) { Write(Severity::Warning, message, fields); }
+	inline void Error(std::string_view message, std::initializer_list<Field> fields = {})   { Write(Severity::Error, message, fields); }
 }
\ No newline at end of file
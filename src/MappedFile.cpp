@@ -0,0 +1,62 @@
+#include "MappedFile.hpp"
+#include "Log.hpp"
+#include <string>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char *fileName)
+{
+	#ifdef _WIN32
+		file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			file = nullptr;
+			Log::Error(std::string("MappedFile: Failed to open ") + fileName);
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		size = static_cast<uint64_t>(fileSize.QuadPart);
+		if (size == 0) return;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	#else
+		const int file = open(fileName, O_RDONLY);
+		if (file == -1) {
+			Log::Error(std::string("MappedFile: Failed to open ") + fileName);
+			return;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+			size = static_cast<uint64_t>(fileStat.st_size);
+			void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapping != MAP_FAILED) data = static_cast<const uint8_t*>(mapping);
+		}
+		close(file);
+	#endif
+
+	if (!data) {
+		size = 0;
+		Log::Error(std::string("MappedFile: Failed to map ") + fileName);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	#ifdef _WIN32
+		if (data)    UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file)    CloseHandle(file);
+	#else
+		if (data) munmap(const_cast<uint8_t*>(data), size);
+	#endif
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile(const char *fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool IsOpen() const { return data != nullptr; }
+
+	const uint8_t *data = nullptr;
+	uint64_t       size = 0;
+private:
+	#ifdef _WIN32
+		void *file    = nullptr;
+		void *mapping = nullptr;
+	#endif
+};
\ No newline at end of file
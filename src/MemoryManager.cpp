@@ -0,0 +1,62 @@
+#include "MemoryManager.hpp"
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+namespace MemoryManager
+{
+	static const uint64_t unlimited = UINT64_MAX;
+
+	static std::array<std::atomic<uint64_t>, static_cast<size_t>(Category::Count)> usage;
+	static std::array<std::atomic<uint64_t>, static_cast<size_t>(Category::Count)> budgets = {unlimited, unlimited, unlimited};
+
+	static const char *names[] = {
+		"Voxels",
+		"Meshes",
+		"GPU buffers"
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Category::Count), "Every category needs a name");
+}
+
+void MemoryManager::SetBudget(Category category, uint64_t bytes)
+{
+	budgets[static_cast<size_t>(category)].store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemoryManager::GetBudget(Category category)
+{
+	return budgets[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
+
+void MemoryManager::Allocate(Category category, uint64_t bytes)
+{
+	usage[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryManager::Free(Category category, uint64_t bytes)
+{
+	usage[static_cast<size_t>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemoryManager::GetUsage(Category category)
+{
+	return usage[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryManager::GetExcess(Category category)
+{
+	const uint64_t used   = GetUsage(category);
+	const uint64_t budget = GetBudget(category);
+	return used > budget ? used - budget : 0;
+}
+
+bool MemoryManager::CanAllocate(Category category, uint64_t bytes)
+{
+	const uint64_t budget = GetBudget(category);
+	return budget == unlimited || GetUsage(category) + bytes <= budget;
+}
+
+const char *MemoryManager::GetName(Category category)
+{
+	return names[static_cast<size_t>(category)];
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// Tracks bytes in use per category against configurable budgets, all functions can be called from any thread
+namespace MemoryManager
+{
+	enum struct Category
+	{
+		Voxels,
+		Meshes,
+		GpuBuffers,
+		Count
+	};
+
+	void SetBudget(Category category, uint64_t bytes);
+	uint64_t GetBudget(Category category);
+
+	void Allocate(Category category, uint64_t bytes);
+	void Free(Category category, uint64_t bytes);
+	uint64_t GetUsage(Category category);
+
+	// Bytes that must be freed to get back under budget, 0 if within budget
+	uint64_t GetExcess(Category category);
+	bool CanAllocate(Category category, uint64_t bytes);
+
+	const char *GetName(Category category);
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "PngWriter.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace PngWriter
+{
+	static uint32_t crcTable[256];
+
+	static void InitializeCrcTable()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++) value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+			crcTable[i] = value;
+		}
+	}
+
+	static uint32_t UpdateCrc(uint32_t crc, const uint8_t *data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++) crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc;
+	}
+
+	static void AppendUint32(std::vector<uint8_t> &data, uint32_t value)
+	{
+		data.push_back(value >> 24);
+		data.push_back(value >> 16);
+		data.push_back(value >> 8);
+		data.push_back(value);
+	}
+
+	static void WriteChunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data)
+	{
+		std::vector<uint8_t> chunk;
+		AppendUint32(chunk, data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		const uint32_t crc = UpdateCrc(0xFFFFFFFF, chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFF;
+		AppendUint32(chunk, crc);
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+}
+
+// The zlib stream uses stored deflate blocks, which keeps the writer tiny at the cost of file size
+bool PngWriter::Write(const char *fileName, uint32_t width, uint32_t height, int channels, const uint8_t *pixels, bool flipRows)
+{
+	static const uint8_t colorTypes[] = {0, 0, 4, 2, 6}; // Grey, grey + alpha, RGB, RGBA
+	if (channels < 1 || channels > 4) {
+		Log::Error("PngWriter::Write: Unsupported number of channels");
+		return false;
+	}
+	static const bool crcTableReady = (InitializeCrcTable(), true);
+	(void)crcTableReady;
+
+	// Every row starts with filter type 0
+	const size_t rowSize = (size_t)width * channels;
+	std::vector<uint8_t> raw;
+	raw.reserve((rowSize + 1) * height);
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + rowSize * (flipRows ? height - 1 - y : y);
+		raw.push_back(0);
+		raw.insert(raw.end(), row, row + rowSize);
+	}
+
+	std::vector<uint8_t> compressed = {0x78, 0x01};
+	const size_t maxBlockSize = 65535;
+	for (size_t offset = 0; offset < raw.size(); offset += maxBlockSize) {
+		const size_t   blockSize = std::min(maxBlockSize, raw.size() - offset);
+		const uint16_t length    = static_cast<uint16_t>(blockSize);
+		compressed.push_back(offset + blockSize >= raw.size() ? 1 : 0);
+		compressed.push_back(length & 0xFF);
+		compressed.push_back(length >> 8);
+		compressed.push_back(~length & 0xFF);
+		compressed.push_back((~length >> 8) & 0xFF);
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+	}
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	for (uint8_t value : raw) {
+		adlerA = (adlerA + value) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	}
+	AppendUint32(compressed, (adlerB << 16) | adlerA);
+
+	std::vector<uint8_t> header;
+	AppendUint32(header, width);
+	AppendUint32(header, height);
+	header.push_back(8); // Bit depth
+	header.push_back(colorTypes[channels]);
+	header.push_back(0); // Compression
+	header.push_back(0); // Filter
+	header.push_back(0); // Interlace
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	WriteChunk(file, "IHDR", header);
+	WriteChunk(file, "IDAT", compressed);
+	WriteChunk(file, "IEND", {});
+	if (!file) {
+		Log::Error(std::string("PngWriter::Write: Failed to write ") + fileName);
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+namespace PngWriter
+{
+	// Rows are written top to bottom, set flipRows for images read back from OpenGL. Pixels are stored uncompressed
+	bool Write(const char *fileName, uint32_t width, uint32_t height, int channels, const uint8_t *pixels, bool flipRows = false);
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <new>
+#include <set>
+#include <type_traits>
+#include <utility>
+
+// Fixed size blocks recycled through a free list shared by every thread, so objects that are created and destroyed at a
+// steady rate stop reaching the general heap once the pool has warmed up
+namespace Pool
+{
+	const size_t maxPooledBytes = 32 * 1024 * 1024; // Per block size, blocks freed beyond this go back to the heap
+
+	template<size_t Size>
+	class Blocks
+	{
+	public:
+		static void *Allocate()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (freeList) {
+					FreeBlock *block = freeList;
+					freeList = block->next;
+					freeCount--;
+					return block;
+				}
+			}
+			return ::operator new(Size);
+		}
+
+		static void Free(void *block)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (freeCount < maxFree) {
+					freeList = new (block) FreeBlock{freeList};
+					freeCount++;
+					return;
+				}
+			}
+			::operator delete(block);
+		}
+	private:
+		// Free blocks hold the list themselves, so returning one never allocates
+		struct FreeBlock
+		{
+			FreeBlock *next;
+		};
+
+		static_assert(Size >= sizeof(FreeBlock), "Blocks must be able to hold the free list");
+		static constexpr size_t maxFree = maxPooledBytes / Size > 0 ? maxPooledBytes / Size : 1;
+
+		static inline std::mutex lock;
+		static inline FreeBlock *freeList  = nullptr;
+		static inline size_t     freeCount = 0;
+	};
+
+	// For std::allocate_shared, which allocates the object and its control block as one block of a fixed size
+	template<typename T>
+	struct Allocator
+	{
+		using value_type = T;
+
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Blocks only have the alignment of the general heap");
+
+		Allocator() = default;
+		template<typename U>
+		Allocator(const Allocator<U> &) {}
+
+		T *allocate(size_t count)
+		{
+			if (count == 1) return static_cast<T *>(Blocks<sizeof(T)>::Allocate());
+			return static_cast<T *>(::operator new(count * sizeof(T)));
+		}
+
+		void deallocate(T *pointer, size_t count)
+		{
+			if (count == 1) Blocks<sizeof(T)>::Free(pointer);
+			else ::operator delete(pointer);
+		}
+
+		template<typename U>
+		bool operator==(const Allocator<U> &) const { return true; }
+		template<typename U>
+		bool operator!=(const Allocator<U> &) const { return false; }
+	};
+
+	// Node based containers whose nodes are blocks, so bookkeeping that gains and loses an entry per chunk stops allocating once warm
+	template<typename Key, typename Value>
+	using Map = std::map<Key, Value, std::less<Key>, Allocator<std::pair<const Key, Value>>>;
+	template<typename Key>
+	using Set = std::set<Key, std::less<Key>, Allocator<Key>>;
+
+	template<typename Signature>
+	class Function;
+
+	// Like std::function, but callables that do not fit inline are kept in a block of their size instead of on the general heap
+	template<typename Result, typename... Arguments>
+	class Function<Result(Arguments...)>
+	{
+	public:
+		static constexpr size_t inlineSize = 64; // A few shared_ptrs and coordinates
+
+		Function() = default;
+		Function(std::nullptr_t) {}
+
+		template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, Function>::value>>
+		Function(Callable &&callable) : table(&Operations<std::decay_t<Callable>>::table)
+		{
+			using Stored = std::decay_t<Callable>;
+			static_assert(alignof(Stored) <= alignof(std::max_align_t), "Blocks only have the alignment of the general heap");
+			if constexpr (IsInline<Stored>()) new (storage) Stored(std::forward<Callable>(callable));
+			else block = new (Blocks<sizeof(Stored)>::Allocate()) Stored(std::forward<Callable>(callable));
+		}
+
+		Function(const Function &other) : table(other.table)
+		{
+			if (table) table->copy(other, *this);
+		}
+
+		Function(Function &&other) noexcept : table(other.table)
+		{
+			if (table) table->move(other, *this);
+			other.table = nullptr;
+		}
+
+		~Function() { Reset(); }
+
+		Function &operator=(const Function &other)
+		{
+			if (this != &other) *this = Function(other);
+			return *this;
+		}
+
+		Function &operator=(Function &&other) noexcept
+		{
+			if (this == &other) return *this;
+			Reset();
+			table = other.table;
+			if (table) table->move(other, *this);
+			other.table = nullptr;
+			return *this;
+		}
+
+		Function &operator=(std::nullptr_t)
+		{
+			Reset();
+			return *this;
+		}
+
+		explicit operator bool() const { return table != nullptr; }
+
+		Result operator()(Arguments... arguments) const
+		{
+			return table->invoke(*this, std::forward<Arguments>(arguments)...);
+		}
+	private:
+		struct Table
+		{
+			Result (*invoke)(const Function &function, Arguments... arguments);
+			void   (*copy)(const Function &source, Function &destination);
+			void   (*move)(Function &source, Function &destination);
+			void   (*destroy)(Function &function);
+		};
+
+		template<typename Stored>
+		static constexpr bool IsInline()
+		{
+			return sizeof(Stored) <= inlineSize && std::is_nothrow_move_constructible<Stored>::value;
+		}
+
+		template<typename Stored>
+		struct Operations
+		{
+			static Stored &Get(const Function &function)
+			{
+				if constexpr (IsInline<Stored>()) return *std::launder(reinterpret_cast<Stored *>(const_cast<unsigned char *>(function.storage)));
+				else return *static_cast<Stored *>(function.block);
+			}
+
+			static Result Invoke(const Function &function, Arguments... arguments)
+			{
+				return Get(function)(std::forward<Arguments>(arguments)...);
+			}
+
+			static void Copy(const Function &source, Function &destination)
+			{
+				if constexpr (IsInline<Stored>()) new (destination.storage) Stored(Get(source));
+				else destination.block = new (Blocks<sizeof(Stored)>::Allocate()) Stored(Get(source));
+			}
+
+			// Blocks change hands, so only inline callables are moved
+			static void Move(Function &source, Function &destination)
+			{
+				if constexpr (IsInline<Stored>()) {
+					new (destination.storage) Stored(std::move(Get(source)));
+					Get(source).~Stored();
+				}
+				else destination.block = source.block;
+			}
+
+			static void Destroy(Function &function)
+			{
+				Get(function).~Stored();
+				if constexpr (!IsInline<Stored>()) Blocks<sizeof(Stored)>::Free(function.block);
+			}
+
+			static constexpr Table table = {Invoke, Copy, Move, Destroy};
+		};
+
+		void Reset()
+		{
+			if (!table) return;
+			table->destroy(*this);
+			table = nullptr;
+		}
+
+		union
+		{
+			alignas(std::max_align_t) unsigned char storage[inlineSize];
+			void *block;
+		};
+		const Table *table = nullptr;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include <glad/glad.h>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+
+namespace Profiler
+{
+	struct Event
+	{
+		const char *name;
+		uint64_t    start;
+		uint64_t    end;
+	};
+
+	// Single producer ring buffer, only the owning thread writes to it
+	struct ThreadBuffer
+	{
+		static const uint64_t capacity = 1 << 16;
+
+		std::array<Event, capacity> events;
+		std::atomic<uint64_t>       head{0};
+		uint32_t                    threadID = 0;
+		std::string                 name;
+	};
+
+	struct FrameCounters
+	{
+		uint64_t time;
+		std::array<uint64_t, static_cast<size_t>(Counter::Count)> values;
+	};
+
+	struct GpuZone
+	{
+		const char *name;
+		uint32_t    queries[2];
+	};
+
+	static const char *counterNames[] = {
+		"Chunks generated",
+		"Chunks meshed",
+		"Chunks uploaded",
+		"Chunks edited",
+		"Vertices drawn",
+		"Bytes uploaded",
+		"Voxel memory",
+		"Mesh memory",
+		"GPU memory",
+		"Active voxels",
+		"Sections copied"
+	};
+	static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == static_cast<size_t>(Counter::Count), "Every counter needs a name");
+
+	static std::mutex                                 bufferLock;
+	static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	static thread_local ThreadBuffer                 *threadBuffer = nullptr;
+
+	static std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters;
+	static std::vector<FrameCounters> frameCounters;
+	static const size_t maxFrameCounters = 1 << 14;
+	static uint64_t frameStart = 0;
+
+	// GPU zones are resolved a few frames late so reading them back never stalls the pipeline
+	static std::vector<uint32_t> freeQueries;
+	static std::vector<GpuZone>  openGpuZones;
+	static std::vector<GpuZone>  pendingGpuZones;
+	static std::vector<Event>    gpuEvents;
+	static int64_t               gpuTimeOffset = 0;
+	static bool                  gpuAvailable  = false;
+
+	static ThreadBuffer *GetThreadBuffer()
+	{
+		if (!threadBuffer) {
+			auto buffer = std::make_shared<ThreadBuffer>();
+			std::lock_guard<std::mutex> guard(bufferLock);
+			buffer->threadID = static_cast<uint32_t>(buffers.size()) + 1;
+			buffer->name     = "Thread " + std::to_string(buffer->threadID);
+			buffers.emplace_back(buffer);
+			threadBuffer = buffer.get();
+		}
+		return threadBuffer;
+	}
+
+	static uint32_t AllocateQuery()
+	{
+		if (freeQueries.empty()) {
+			uint32_t queries[64];
+			glGenQueries(64, queries);
+			freeQueries.insert(freeQueries.end(), queries, queries + 64);
+		}
+		const uint32_t query = freeQueries.back();
+		freeQueries.pop_back();
+		return query;
+	}
+
+	static void ResolveGpuZones()
+	{
+		size_t resolved = 0;
+		for (const GpuZone &zone : pendingGpuZones) {
+			GLint available = 0;
+			glGetQueryObjectiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break;
+
+			GLuint64 start = 0;
+			GLuint64 end   = 0;
+			glGetQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT, &end);
+			if (gpuEvents.size() < ThreadBuffer::capacity) {
+				gpuEvents.push_back({zone.name, static_cast<uint64_t>(start + gpuTimeOffset), static_cast<uint64_t>(end + gpuTimeOffset)});
+			}
+			freeQueries.push_back(zone.queries[0]);
+			freeQueries.push_back(zone.queries[1]);
+			resolved++;
+		}
+		pendingGpuZones.erase(pendingGpuZones.begin(), pendingGpuZones.begin() + resolved);
+	}
+
+	static void WriteEvent(std::ofstream &file, bool &first, const char *name, uint64_t start, uint64_t end, uint32_t threadID)
+	{
+		if (!first) file << ",\n";
+		first = false;
+		file << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadID
+		     << ",\"ts\":" << start / 1000 << '.' << (start % 1000) / 100
+		     << ",\"dur\":" << (end - start) / 1000 << '.' << ((end - start) % 1000) / 100 << '}';
+	}
+
+	static void WriteThreadName(std::ofstream &file, bool &first, const std::string &name, uint32_t threadID)
+	{
+		if (!first) file << ",\n";
+		first = false;
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadID << ",\"args\":{\"name\":\"" << name << "\"}}";
+	}
+}
+
+uint64_t Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::SetThreadName(const char *name)
+{
+	ThreadBuffer *buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> guard(bufferLock);
+	buffer->name = name;
+}
+
+void Profiler::AddZone(const char *name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer *buffer = GetThreadBuffer();
+	const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+	buffer->events[head % ThreadBuffer::capacity] = {name, start, end};
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::AddCounter(Counter counter, uint64_t value)
+{
+	counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void Profiler::SetCounter(Counter counter, uint64_t value)
+{
+	counters[static_cast<size_t>(counter)].store(value, std::memory_order_relaxed);
+}
+
+void Profiler::Initialize()
+{
+	SetThreadName("Main");
+
+	// Timer queries were promoted to core in OpenGL 3.3 so no extension check is needed
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	gpuTimeOffset = static_cast<int64_t>(Now()) - gpuTime;
+	gpuAvailable  = gpuTime != 0;
+	if (!gpuAvailable) Log::Info("Profiler: GPU timestamps unavailable, GPU zones disabled");
+}
+
+void Profiler::Cleanup()
+{
+	if (!freeQueries.empty()) glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+	for (const GpuZone &zone : pendingGpuZones) glDeleteQueries(2, zone.queries);
+	freeQueries.clear();
+	pendingGpuZones.clear();
+}
+
+void Profiler::BeginFrame()
+{
+	frameStart = Now();
+}
+
+void Profiler::EndFrame()
+{
+	const uint64_t frameEnd = Now();
+	AddZone("Frame", frameStart, frameEnd);
+
+	FrameCounters frame;
+	frame.time = frameEnd;
+	for (size_t i = 0; i < counters.size(); i++) {
+		frame.values[i] = counters[i].exchange(0, std::memory_order_relaxed);
+	}
+	if (frameCounters.size() >= maxFrameCounters) {
+		frameCounters.erase(frameCounters.begin(), frameCounters.begin() + maxFrameCounters / 2);
+	}
+	frameCounters.push_back(frame);
+
+	if (gpuAvailable) ResolveGpuZones();
+}
+
+void Profiler::BeginGpuZone(const char *name)
+{
+	if (!gpuAvailable) return;
+	GpuZone zone = {name, {AllocateQuery(), AllocateQuery()}};
+	glQueryCounter(zone.queries[0], GL_TIMESTAMP);
+	openGpuZones.push_back(zone);
+}
+
+void Profiler::EndGpuZone()
+{
+	if (!gpuAvailable || openGpuZones.empty()) return;
+	GpuZone zone = openGpuZones.back();
+	openGpuZones.pop_back();
+	glQueryCounter(zone.queries[1], GL_TIMESTAMP);
+	pendingGpuZones.push_back(zone);
+}
+
+// Events that are being overwritten while the trace is written may be torn, the last quarter of each buffer is skipped to keep clear of the writers
+bool Profiler::WriteTrace(const char *fileName)
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file) {
+		Log::Error(std::string("Profiler::WriteTrace: Failed to open ") + fileName);
+		return false;
+	}
+
+	std::vector<std::shared_ptr<ThreadBuffer>> threadBuffers;
+	{
+		std::lock_guard<std::mutex> guard(bufferLock);
+		threadBuffers = buffers;
+	}
+
+	bool first = true;
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	uint64_t eventCount = 0;
+	for (const auto &buffer : threadBuffers) {
+		WriteThreadName(file, first, buffer->name, buffer->threadID);
+		const uint64_t head  = buffer->head.load(std::memory_order_acquire);
+		const uint64_t count = head < (ThreadBuffer::capacity * 3) / 4 ? head : (ThreadBuffer::capacity * 3) / 4;
+		for (uint64_t i = head - count; i < head; i++) {
+			const Event &event = buffer->events[i % ThreadBuffer::capacity];
+			WriteEvent(file, first, event.name, event.start, event.end, buffer->threadID);
+		}
+		eventCount += count;
+	}
+
+	const uint32_t gpuThreadID = 0;
+	WriteThreadName(file, first, "GPU", gpuThreadID);
+	for (const Event &event : gpuEvents) {
+		WriteEvent(file, first, event.name, event.start, event.end, gpuThreadID);
+	}
+	eventCount += gpuEvents.size();
+
+	for (const FrameCounters &frame : frameCounters) {
+		for (size_t i = 0; i < frame.values.size(); i++) {
+			file << ",\n{\"name\":\"" << counterNames[i] << "\",\"ph\":\"C\",\"pid\":0,\"ts\":" << frame.time / 1000
+			     << ",\"args\":{\"value\":" << frame.values[i] << "}}";
+		}
+	}
+
+	file << "\n]}\n";
+	Log::Info(std::string("Profiler: Wrote ") + std::to_string(eventCount) + " events and " + std::to_string(frameCounters.size()) + " frames to " + fileName);
+	return true;
+}
\ No newline at end of file
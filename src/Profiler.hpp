@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+
+// Zones and counters are compiled out unless PROFILER is defined, use the PROFILE_* macros rather than calling Profiler directly
+namespace Profiler
+{
+	enum struct Counter
+	{
+		ChunksGenerated,
+		ChunksMeshed,
+		ChunksUploaded,
+		ChunksEdited,
+		VerticesDrawn,
+		BytesUploaded,
+		VoxelMemory,
+		MeshMemory,
+		GpuMemory,
+		ActiveVoxels,
+		SectionsCopied,
+		Count
+	};
+
+	uint64_t Now(); // Nanoseconds
+
+	void SetThreadName(const char *name);
+	void AddZone(const char *name, uint64_t start, uint64_t end);
+	void AddCounter(Counter counter, uint64_t value);
+	void SetCounter(Counter counter, uint64_t value); // For gauges, the last value set before EndFrame is recorded
+
+	// Must be called on the thread that owns the OpenGL context
+	void Initialize();
+	void Cleanup();
+	void BeginFrame();
+	void EndFrame();
+	void BeginGpuZone(const char *name);
+	void EndGpuZone();
+
+	bool WriteTrace(const char *fileName);
+
+	class ScopedZone
+	{
+	public:
+		ScopedZone(const char *name) : name(name), start(Now()) {}
+		~ScopedZone() { AddZone(name, start, Now()); }
+	private:
+		const char *name;
+		uint64_t    start;
+	};
+}
+
+#ifdef PROFILER
+	#define PROFILE_CONCAT_(a, b) a##b
+	#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+	#define PROFILE_ZONE(name)              Profiler::ScopedZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+	#define PROFILE_COUNTER(counter, value) Profiler::AddCounter(Profiler::Counter::counter, value)
+	#define PROFILE_GAUGE(counter, value)   Profiler::SetCounter(Profiler::Counter::counter, value)
+	#define PROFILE_THREAD_NAME(name)       Profiler::SetThreadName(name)
+	#define PROFILE_GPU_BEGIN(name)         Profiler::BeginGpuZone(name)
+	#define PROFILE_GPU_END()               Profiler::EndGpuZone()
+#else
+	// Still statements, so a macro can be the body of an if
+	#define PROFILE_ZONE(name)              ((void)0)
+	#define PROFILE_COUNTER(counter, value) ((void)0)
+	#define PROFILE_GAUGE(counter, value)   ((void)0)
+	#define PROFILE_THREAD_NAME(name)       ((void)0)
+	#define PROFILE_GPU_BEGIN(name)         ((void)0)
+	#define PROFILE_GPU_END()               ((void)0)
+#endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "Recording.hpp"
+#include "MappedFile.hpp"
+#include "Log.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		float    timestep;
+		uint32_t stepCount;
+	};
+
+	const uint32_t magic   = 0x43455256; // VREC
+	const uint32_t version = 1;
+}
+
+bool Recording::Load(const char *fileName)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen()) return false;
+
+	const Header *header = reinterpret_cast<const Header*>(file.data);
+	if (file.size < sizeof(Header) || header->magic != magic || header->version != version) {
+		Log::Error(std::string("Recording::Load: ") + fileName + " is not a recording");
+		return false;
+	}
+	if (file.size < sizeof(Header) + (uint64_t)header->stepCount * sizeof(Step)) {
+		Log::Error(std::string("Recording::Load: ") + fileName + " is truncated");
+		return false;
+	}
+
+	timestep = header->timestep;
+	const Step *firstStep = reinterpret_cast<const Step*>(file.data + sizeof(Header));
+	steps.assign(firstStep, firstStep + header->stepCount);
+	return true;
+}
+
+bool Recording::Save(const char *fileName) const
+{
+	Header header;
+	header.magic     = magic;
+	header.version   = version;
+	header.timestep  = timestep;
+	header.stepCount = steps.size();
+
+	const std::string temporaryName = std::string(fileName) + ".tmp";
+	{
+		std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(steps.data()), steps.size() * sizeof(Step));
+		if (!file) {
+			Log::Error("Recording::Save: Failed to write " + temporaryName);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryName, fileName, error);
+	if (error) {
+		Log::Error(std::string("Recording::Save: Failed to write ") + fileName + " - " + error.message());
+		return false;
+	}
+
+	Log::Info("Recording: Saved " + std::to_string(steps.size()) + " steps to " + fileName);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <vector>
+
+// Camera poses, input and edits captured once per fixed timestep, replaying them drives the world the same way on every run
+class Recording
+{
+public:
+	enum Flags : uint32_t
+	{
+		RemoveVoxel = 1,
+		Explode     = 2,
+		PlaceWater  = 4,
+		PlaceSand   = 8
+	};
+
+	struct Step
+	{
+		glm::vec3 position;
+		float     yaw;
+		float     pitch;
+		glm::vec3 movement; // Input axes before speed is applied
+		uint32_t  flags;
+	};
+
+	Recording(float timestep = 1.0f / 60.0f) : timestep(timestep) {}
+
+	bool Load(const char *fileName);
+	bool Save(const char *fileName) const;
+
+	float             timestep;
+	std::vector<Step> steps;
+};
\ No newline at end of file
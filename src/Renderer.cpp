@@ -1,16 +1,75 @@
 #include "Renderer.hpp"
 #include "Log.hpp"
+#include "PngWriter.hpp"
 #include <SDL_video.h>
 #include <glad/glad.h>
+#ifdef HEADLESS
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#endif
+#include <vector>
 
 namespace Renderer
 {
 	static SDL_Window   *window    = nullptr;
 	static SDL_GLContext glContext = nullptr;
+	static int           width     = 0;
+	static int           height    = 0;
+
+	#ifdef HEADLESS
+		static EGLDisplay eglDisplay  = EGL_NO_DISPLAY;
+		static EGLSurface eglSurface  = EGL_NO_SURFACE;
+		static EGLContext eglContext  = EGL_NO_CONTEXT;
+		static uint32_t   framebuffer = 0;
+		static uint32_t   colorBuffer = 0;
+		static uint32_t   depthBuffer = 0;
+	#endif
 
 	void debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
 	{
-		Log::Error(message);
+		const Log::Severity logSeverity = severity == GL_DEBUG_SEVERITY_NOTIFICATION ? Log::Severity::Debug :
+		                                  severity == GL_DEBUG_SEVERITY_LOW          ? Log::Severity::Warning : Log::Severity::Error;
+		Log::Write(logSeverity, std::string_view(message, length), {{"id", id}, {"type", type}});
+	}
+
+	// Shared by both backends once a context is current and glad is loaded
+	static bool InitializeState()
+	{
+		Log::Info(std::string("OpenGL version: ") + reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+
+		#ifdef ARB_DIRECT_STATE_ACCESS
+			const int requiredMajor = 4;
+			const int requiredMinor = 5;
+		#else
+			const int requiredMajor = 3;
+			const int requiredMinor = 3;
+		#endif
+
+		int major = 0;
+		int minor = 0;
+
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		if (major < requiredMajor || (major == requiredMajor && minor < requiredMinor)) {
+			Log::Error(std::string("OpenGL ") + std::to_string(requiredMajor) + "." + std::to_string(requiredMinor) + " is required. Version " + std::to_string(major) + "." + std::to_string(minor) + " available");
+			return false;
+		}
+
+		#ifdef DEBUG
+			if (GLAD_GL_KHR_debug) {
+				glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+				glDebugMessageCallback(debugMessageCallback, nullptr);
+			}
+		#endif
+
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_MULTISAMPLE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		return true;
 	}
 }
 
@@ -42,46 +101,127 @@ bool Renderer::Initialize(SDL_Window *window)
 		return false;
 	}
 
-	Log::Info(std::string("OpenGL version: ") + reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+	SDL_GL_GetDrawableSize(window, &width, &height);
+	return InitializeState();
+}
 
-	#ifdef ARB_DIRECT_STATE_ACCESS
-		const int requiredMajor = 4;
-		const int requiredMinor = 5;
-	#else
-		const int requiredMajor = 3;
-		const int requiredMinor = 3;
-	#endif
+#ifdef HEADLESS
+// Prefers Mesa's surfaceless platform and falls back to a pbuffer on the default display
+bool Renderer::InitializeHeadless(int width, int height)
+{
+	::Renderer::width  = width;
+	::Renderer::height = height;
+
+	const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay) eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	const bool surfaceless = eglDisplay != EGL_NO_DISPLAY && eglInitialize(eglDisplay, nullptr, nullptr);
+	if (!surfaceless) {
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) {
+			Log::Error("Renderer::InitializeHeadless: Failed to initialize EGL");
+			return false;
+		}
+	}
 
-	int major = 0;
-	int minor = 0;
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint    configCount = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		Log::Error("Renderer::InitializeHeadless: No OpenGL capable EGL config");
+		return false;
+	}
 
-	glGetIntegerv(GL_MAJOR_VERSION, &major);
-	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	const EGLint contextAttributes[] = {
+		#ifdef ARB_DIRECT_STATE_ACCESS
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 5,
+		#else
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+		#endif
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		#ifdef DEBUG
+			EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+		#endif
+		EGL_NONE
+	};
+	eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT) {
+		Log::Error("Renderer::InitializeHeadless: Failed to create OpenGL context - EGL error " + std::to_string(eglGetError()));
+		return false;
+	}
 
-	if (major < requiredMajor || (major == requiredMajor && minor < requiredMinor)) {
-		Log::Error(std::string("OpenGL ") + std::to_string(requiredMajor) + "." + std::to_string(requiredMinor) + " is required. Version " + std::to_string(major) + "." + std::to_string(minor) + " available");
+	if (!surfaceless) {
+		const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+		eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+	}
+	if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+		Log::Error("Renderer::InitializeHeadless: Failed to make the OpenGL context current");
+		return false;
+	}
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		Log::Error("Renderer::InitializeHeadless: Failed to initialize OpenGL");
 		return false;
 	}
 
-	#ifdef DEBUG
-		if (GLAD_GL_KHR_debug) {
-			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-			glDebugMessageCallback(debugMessageCallback, nullptr);
-		}
+	#ifdef ARB_DIRECT_STATE_ACCESS
+		glCreateRenderbuffers(1, &colorBuffer);
+		glCreateRenderbuffers(1, &depthBuffer);
+		glNamedRenderbufferStorage(colorBuffer, GL_RGBA8, width, height);
+		glNamedRenderbufferStorage(depthBuffer, GL_DEPTH24_STENCIL8, width, height);
+
+		glCreateFramebuffers(1, &framebuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		const GLenum status = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	#else
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 	#endif
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		Log::Error("Renderer::InitializeHeadless: Framebuffer is incomplete");
+		return false;
+	}
+	glViewport(0, 0, width, height);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_MULTISAMPLE);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	return true;
+	Log::Info(std::string("Renderer: Headless ") + (surfaceless ? "surfaceless" : "pbuffer") + " context");
+	return InitializeState();
 }
+#endif
 
 void Renderer::Cleanup()
 {
 	if (glContext) SDL_GL_DeleteContext(glContext);
+	#ifdef HEADLESS
+		if (eglContext != EGL_NO_CONTEXT) {
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(1, &colorBuffer);
+			glDeleteRenderbuffers(1, &depthBuffer);
+			eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(eglDisplay, eglContext);
+			if (eglSurface != EGL_NO_SURFACE) eglDestroySurface(eglDisplay, eglSurface);
+			eglTerminate(eglDisplay);
+			eglContext = EGL_NO_CONTEXT;
+			eglSurface = EGL_NO_SURFACE;
+			eglDisplay = EGL_NO_DISPLAY;
+		}
+	#endif
 }
 
 void Renderer::SetClearColor(float r, float g, float b, float a)
@@ -94,7 +234,17 @@ void Renderer::ClearBuffer()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+// Without a window nothing is presented, the frame is only submitted
 void Renderer::FlushBuffer()
 {
-	SDL_GL_SwapWindow(window);
+	if (window) SDL_GL_SwapWindow(window);
+	else glFlush();
+}
+
+bool Renderer::SaveScreenshot(const char *fileName)
+{
+	std::vector<uint8_t> pixels((size_t)width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	return PngWriter::Write(fileName, width, height, 4, pixels.data(), true);
 }
\ No newline at end of file
@@ -4,10 +4,15 @@
 namespace Renderer
 {
 	bool Initialize(SDL_Window *window);
+	#ifdef HEADLESS
+		// Renders into a framebuffer object using an EGL context that needs no display
+		bool InitializeHeadless(int width, int height);
+	#endif
 	void Cleanup();
 
 	void SetClearColor(float r, float g, float b, float a);
 
 	void ClearBuffer();
 	void FlushBuffer();
+	bool SaveScreenshot(const char *fileName); // Call before FlushBuffer
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "SaveFile.hpp"
+#include "MappedFile.hpp"
+#include "AsyncIo.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t chunkCount;
+	};
+
+	// Version 1 has one in front of each chunk's runs instead of a directory
+	struct ChunkHeader
+	{
+		int32_t  x;
+		int32_t  z;
+		uint32_t runCount;
+	};
+
+	struct DirectoryEntry
+	{
+		int32_t  x;
+		int32_t  z;
+		uint32_t runCount;
+		uint32_t padding;
+		uint64_t offset;
+	};
+
+	const uint32_t magic            = 0x56535856; // VXSV
+	const uint32_t version          = 2;
+	const uint32_t directoryVersion = 2; // The first with a directory
+}
+
+// Logs why the header is unusable
+static bool CheckHeader(const char *fileName, const Header &header, uint64_t fileSize)
+{
+	if (fileSize < sizeof(Header) || header.magic != magic || header.version > version) {
+		Log::Error(std::string("SaveFile: ") + fileName + " is not a save");
+		return false;
+	}
+	if (header.width != chunkWidth || header.height != chunkHeight || header.depth != chunkDepth) {
+		Log::Error(std::string("SaveFile: ") + fileName + " was saved with a different chunk size");
+		return false;
+	}
+	if (header.version >= directoryVersion && fileSize < sizeof(Header) + ((uint64_t)header.chunkCount * sizeof(DirectoryEntry))) {
+		Log::Error(std::string("SaveFile: ") + fileName + " is truncated");
+		return false;
+	}
+	return true;
+}
+
+void SaveFile::EncodeRuns(const WorldChunk::Snapshot &snapshot, std::vector<Run> &runs)
+{
+	runs.clear();
+	for (int y = 0; y < chunkHeight; y++) {
+		for (int z = 0; z < chunkDepth; z++) {
+			for (int x = 0; x < chunkWidth; x++) {
+				const uint8_t voxel = snapshot.GetVoxel(x, y, z);
+				if (!runs.empty() && runs.back().voxel == voxel && runs.back().length < UINT16_MAX) runs.back().length++;
+				else runs.push_back({1, voxel, 0});
+			}
+		}
+	}
+}
+
+bool SaveFile::DecodeRuns(const Run *runs, uint32_t runCount, std::vector<uint8_t> &voxels)
+{
+	voxels.resize(chunkWidth * chunkHeight * chunkDepth);
+	size_t position = 0;
+	for (uint32_t run = 0; run < runCount; run++) {
+		if (position + runs[run].length > voxels.size()) return false;
+		std::fill(voxels.begin() + position, voxels.begin() + position + runs[run].length, runs[run].voxel);
+		position += runs[run].length;
+	}
+	return position == voxels.size();
+}
+
+// Runs are decoded into a flat chunk first since snapshots are filled in storage order
+bool SaveFile::DecodeSnapshot(const uint8_t *data, uint32_t runCount, WorldChunk::Snapshot &snapshot)
+{
+	static thread_local std::vector<uint8_t> voxels;
+	if (!DecodeRuns(reinterpret_cast<const Run*>(data), runCount, voxels)) return false;
+	snapshot = WorldChunk::Snapshot::Create([](int x, int y, int z) {
+		return voxels[(((y * chunkDepth) + z) * chunkWidth) + x];
+	});
+	return true;
+}
+
+bool SaveFile::LoadDirectory(const char *fileName, const AsyncIo::File &file, std::vector<std::pair<glm::ivec2, Location>> &locations)
+{
+	// The header is checked against the size of the file before the directory it describes is allocated
+	const uint64_t fileSize = file.GetSize();
+	Header header;
+	if (!file.Read(0, &header, sizeof(header)) || header.magic != magic || header.version < directoryVersion) return false;
+	if (!CheckHeader(fileName, header, fileSize)) return false;
+
+	std::vector<DirectoryEntry> directory(header.chunkCount);
+	if (!file.Read(sizeof(Header), directory.data(), directory.size() * sizeof(DirectoryEntry))) {
+		Log::Error(std::string("SaveFile::LoadDirectory: ") + fileName + " is truncated");
+		return false;
+	}
+
+	// A damaged directory is left to Load, which keeps the chunks before the first bad one
+	for (const DirectoryEntry &entry : directory) {
+		if (entry.offset > fileSize || fileSize - entry.offset < (uint64_t)entry.runCount * sizeof(Run)) {
+			Log::Error(std::string("SaveFile::LoadDirectory: ") + fileName + " has chunks beyond its end");
+			locations.clear();
+			return false;
+		}
+		locations.push_back({glm::ivec2(entry.x, entry.z), {entry.offset, entry.runCount}});
+	}
+	return true;
+}
+
+bool SaveFile::Load(const char *fileName, std::vector<Entry> &chunks)
+{
+	MappedFile file(fileName);
+	if (!file.IsOpen()) return false;
+	const Header *header = reinterpret_cast<const Header*>(file.data);
+	if (!CheckHeader(fileName, *header, file.size)) return false;
+
+	WorldChunk::Snapshot snapshot;
+	if (header->version >= directoryVersion) {
+		const DirectoryEntry *directory = reinterpret_cast<const DirectoryEntry*>(file.data + sizeof(Header));
+		for (uint32_t i = 0; i < header->chunkCount; i++) {
+			const DirectoryEntry &entry = directory[i];
+			if (entry.offset > file.size || file.size - entry.offset < (uint64_t)entry.runCount * sizeof(Run)) break;
+			if (!DecodeSnapshot(file.data + entry.offset, entry.runCount, snapshot)) break;
+			chunks.push_back({glm::ivec2(entry.x, entry.z), std::move(snapshot)});
+		}
+	}
+	else {
+		uint64_t offset = sizeof(Header);
+		for (uint32_t i = 0; i < header->chunkCount; i++) {
+			if (file.size < offset + sizeof(ChunkHeader)) break;
+			const ChunkHeader *chunk = reinterpret_cast<const ChunkHeader*>(file.data + offset);
+			offset += sizeof(ChunkHeader);
+			if (file.size < offset + (uint64_t)chunk->runCount * sizeof(Run)) break;
+			if (!DecodeSnapshot(file.data + offset, chunk->runCount, snapshot)) break;
+			offset += (uint64_t)chunk->runCount * sizeof(Run);
+			chunks.push_back({glm::ivec2(chunk->x, chunk->z), std::move(snapshot)});
+		}
+	}
+	if (chunks.size() != header->chunkCount) {
+		Log::Error(std::string("SaveFile::Load: ") + fileName + " is truncated");
+		return false;
+	}
+	return true;
+}
+
+// Flushes the file to the disk, so a crash after it is renamed over the previous save cannot leave neither of them intact
+static bool SyncFile(const std::string &fileName)
+{
+	#ifdef _WIN32
+		const HANDLE file = CreateFileA(fileName.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		const bool synced = FlushFileBuffers(file) != 0;
+		CloseHandle(file);
+	#else
+		const int file = open(fileName.c_str(), O_WRONLY | O_CLOEXEC);
+		if (file == -1) return false;
+		const bool synced = fsync(file) == 0;
+		close(file);
+	#endif
+	return synced;
+}
+
+bool SaveFile::Save(const char *fileName, const std::vector<Entry> &chunks)
+{
+	Header header;
+	header.magic      = magic;
+	header.version    = version;
+	header.width      = chunkWidth;
+	header.height     = chunkHeight;
+	header.depth      = chunkDepth;
+	header.chunkCount = chunks.size();
+
+	const std::string temporaryName = std::string(fileName) + ".tmp";
+	{
+		// The directory is written last, once the offsets of the runs are known
+		std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+		std::vector<DirectoryEntry> directory(chunks.size());
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DirectoryEntry));
+
+		std::vector<Run> runs;
+		uint64_t offset = sizeof(Header) + (directory.size() * sizeof(DirectoryEntry));
+		for (size_t i = 0; i < chunks.size(); i++) {
+			const Entry &entry = chunks[i];
+			if (entry.file) {
+				runs.resize(entry.location.runCount);
+				if (!entry.file->Read(entry.location.offset, runs.data(), runs.size() * sizeof(Run))) {
+					Log::Error("SaveFile::Save: Failed to copy a chunk from the previous save");
+					return false;
+				}
+			}
+			else EncodeRuns(entry.snapshot, runs);
+			directory[i] = {entry.coordinate.x, entry.coordinate.y, static_cast<uint32_t>(runs.size()), 0, offset};
+			file.write(reinterpret_cast<const char*>(runs.data()), runs.size() * sizeof(Run));
+			offset += runs.size() * sizeof(Run);
+		}
+		file.seekp(sizeof(Header));
+		file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DirectoryEntry));
+		file.close();
+		if (!file) {
+			Log::Error("SaveFile::Save: Failed to write " + temporaryName);
+			return false;
+		}
+	}
+	if (!SyncFile(temporaryName)) {
+		Log::Error("SaveFile::Save: Failed to flush " + temporaryName);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryName, fileName, error);
+	if (error) {
+		Log::Error(std::string("SaveFile::Save: Failed to write ") + fileName + " - " + error.message());
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
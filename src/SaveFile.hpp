@@ -0,0 +1,50 @@
+#pragma once
+#include "World.hpp"
+#include <glm/vec2.hpp>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace AsyncIo
+{
+	class File;
+}
+
+// Modified chunks stored as runs of voxels in y, z, x order, written from snapshots so saving never holds a chunk's lock.
+// A directory of where each chunk's runs are follows the header, so chunks can be read one at a time as they are needed
+namespace SaveFile
+{
+	// Voxels in y, z, x order as runs of up to 65535, also used by the server to send chunks
+	struct Run
+	{
+		uint16_t length;
+		uint8_t  voxel;
+		uint8_t  padding;
+	};
+
+	// Of a chunk's runs in a save
+	struct Location
+	{
+		uint64_t offset   = 0;
+		uint32_t runCount = 0;
+	};
+
+	struct Entry
+	{
+		glm::ivec2                           coordinate;
+		WorldChunk::Snapshot                 snapshot;
+		std::shared_ptr<const AsyncIo::File> file; // Set for chunks never read from the save they came from, their runs are copied from it
+		Location                             location;
+	};
+
+	void EncodeRuns(const WorldChunk::Snapshot &snapshot, std::vector<Run> &runs);
+	bool DecodeRuns(const Run *runs, uint32_t runCount, std::vector<uint8_t> &voxels); // False if the runs do not cover the chunk exactly
+	bool DecodeSnapshot(const uint8_t *data, uint32_t runCount, WorldChunk::Snapshot &snapshot); // The runs of one chunk, read from its location
+
+	// Reads only the header and the directory, false for saves from before the directory, which Load reads whole
+	bool LoadDirectory(const char *fileName, const AsyncIo::File &file, std::vector<std::pair<glm::ivec2, Location>> &locations);
+
+	bool Load(const char *fileName, std::vector<Entry> &chunks);
+	bool Save(const char *fileName, const std::vector<Entry> &chunks);
+}
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include "Server.hpp"
+#include "SaveFile.hpp"
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using ServerProtocol::MessageType;
+using ServerProtocol::MessageHeader;
+
+// Messages are small, anything bigger is a broken client
+static const uint32_t maxMessageLength = 1 << 16;
+
+// Positions beyond this are clamped, so chunk coordinates derived from them always fit in an int
+static const float maxCoordinate = static_cast<float>(1 << 24);
+
+// Edits are walked voxel by voxel on the world thread, so a client cannot set more than this at once
+static const int64_t maxEditVolume = 1 << 20;
+
+Server::Server(World &world, uint16_t port, float maxRadius) : world(world), maxRadius(maxRadius)
+{
+	listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+	if (listenSocket == -1) {
+		Log::Error(std::string("Server: Failed to create a socket - ") + strerror(errno));
+		return;
+	}
+
+	const int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address = {};
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 16) != 0) {
+		Log::Error("Server: Failed to listen on port " + std::to_string(port) + " - " + strerror(errno));
+		close(listenSocket);
+		listenSocket = -1;
+		return;
+	}
+	fcntl(listenSocket, F_SETFL, O_NONBLOCK);
+
+	// Deltas are built on the server's thread, the listener only records which voxels changed
+	world.SetChangeListener([this](int x, int z, const std::vector<glm::ivec3> &positions) {
+		std::lock_guard<std::mutex> guard(changesLock);
+		std::vector<glm::ivec3> &chunkChanges = changes[GetKey(x, z)];
+		chunkChanges.insert(chunkChanges.end(), positions.begin(), positions.end());
+	});
+	Log::Info("Server: Listening on port " + std::to_string(port));
+}
+
+Server::~Server()
+{
+	for (const auto &client : clients) close(client->socket);
+	if (listenSocket != -1) close(listenSocket);
+}
+
+uint64_t Server::GetKey(int x, int z)
+{
+	uint64_t key;
+	*(reinterpret_cast<int*>(&key) + 0) = x;
+	*(reinterpret_cast<int*>(&key) + 1) = z;
+	return key;
+}
+
+void Server::Update()
+{
+	PROFILE_ZONE("Server update");
+	if (!IsListening()) return;
+
+	Accept();
+	for (auto it = clients.begin(); it != clients.end();) {
+		if (Receive(**it)) {
+			it++;
+			continue;
+		}
+		Log::Info("Server: Client disconnected", {{"bytes", (*it)->bytesSent}, {"chunks", (*it)->chunksSent}, {"deltas", (*it)->deltasSent}});
+		close((*it)->socket);
+		it = clients.erase(it);
+	}
+
+	// Sent every update like the game sends its camera, so the world keeps running block updates while the clients stand still
+	std::vector<glm::vec3> viewers;
+	for (const auto &client : clients) {
+		if (client->hasPosition) viewers.push_back(client->position);
+	}
+	world.SetViewers(viewers);
+
+	SendDeltas();
+	std::map<uint64_t, std::vector<uint8_t>> encoded; // Shared by clients that need the same chunk this update
+	for (const auto &client : clients) SendChunks(*client, encoded);
+
+	for (auto it = clients.begin(); it != clients.end();) {
+		if (Flush(**it)) {
+			it++;
+			continue;
+		}
+		Log::Info("Server: Client disconnected", {{"bytes", (*it)->bytesSent}, {"chunks", (*it)->chunksSent}, {"deltas", (*it)->deltasSent}});
+		close((*it)->socket);
+		it = clients.erase(it);
+	}
+}
+
+void Server::Accept()
+{
+	while (true) {
+		const int clientSocket = accept(listenSocket, nullptr, nullptr);
+		if (clientSocket == -1) return;
+		fcntl(clientSocket, F_SETFL, O_NONBLOCK);
+		const int noDelay = 1;
+		setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+		clients.push_back(std::make_unique<Client>());
+		clients.back()->socket = clientSocket;
+		Log::Info("Server: Client connected", {{"clients", clients.size()}});
+	}
+}
+
+bool Server::Receive(Client &client)
+{
+	uint8_t buffer[16384];
+	while (true) {
+		const ssize_t received = recv(client.socket, buffer, sizeof(buffer), 0);
+		if (received == 0) return false;
+		if (received < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return false;
+		}
+		client.input.insert(client.input.end(), buffer, buffer + received);
+	}
+
+	size_t offset = 0;
+	while (client.input.size() - offset >= sizeof(MessageHeader)) {
+		MessageHeader header;
+		memcpy(&header, client.input.data() + offset, sizeof(header));
+		if (header.length > maxMessageLength) return false;
+		if (client.input.size() - offset - sizeof(header) < header.length) break;
+		HandleMessage(client, static_cast<MessageType>(header.type), client.input.data() + offset + sizeof(header), header.length);
+		offset += sizeof(header) + header.length;
+	}
+	client.input.erase(client.input.begin(), client.input.begin() + offset);
+	return true;
+}
+
+void Server::HandleMessage(Client &client, MessageType type, const uint8_t *payload, uint32_t length)
+{
+	switch (type) {
+		case MessageType::Position: {
+			ServerProtocol::PositionMessage message;
+			if (length != sizeof(message)) break;
+			memcpy(&message, payload, sizeof(message));
+			if (!std::isfinite(message.x) || !std::isfinite(message.y) || !std::isfinite(message.z) || !std::isfinite(message.radius)) {
+				Log::Warning("Server: Ignored a position that is not finite");
+				break;
+			}
+			client.position    = glm::clamp(glm::vec3(message.x, message.y, message.z), -maxCoordinate, maxCoordinate);
+			client.radius      = glm::clamp(message.radius, 0.0f, maxRadius);
+			client.hasPosition = true;
+			break;
+		}
+		case MessageType::Edit: {
+			ServerProtocol::EditMessage message;
+			if (length != sizeof(message)) break;
+			memcpy(&message, payload, sizeof(message));
+			glm::ivec3 min(message.minX, message.minY, message.minZ);
+			glm::ivec3 max(message.maxX, message.maxY, message.maxZ);
+			if (!client.hasPosition || glm::any(glm::greaterThan(min, max))) {
+				Log::Warning("Server: Ignored an edit that is inverted or came before a position");
+				break;
+			}
+
+			// Clients can only edit the chunks they were sent
+			const glm::ivec3 loadedMin(glm::floor(client.position.x - client.radius), 0, glm::floor(client.position.z - client.radius));
+			const glm::ivec3 loadedMax(glm::ceil(client.position.x + client.radius), chunkHeight, glm::ceil(client.position.z + client.radius));
+			min = glm::clamp(min, loadedMin, loadedMax);
+			max = glm::clamp(max, loadedMin, loadedMax);
+			const glm::i64vec3 size = glm::i64vec3(max) - glm::i64vec3(min);
+			if (size.x * size.y * size.z > maxEditVolume) {
+				Log::Warning("Server: Ignored an edit that is too large", {{"volume", size.x * size.y * size.z}});
+				break;
+			}
+			if (size.x > 0 && size.y > 0 && size.z > 0) world.Edit(VoxelShape::Box(min, max), message.voxel);
+			break;
+		}
+		case MessageType::Ping:
+			if (length == sizeof(ServerProtocol::PingMessage)) Append(client, MessageType::Pong, payload, length);
+			break;
+		default:
+			Log::Warning("Server: Ignored a message a client should not send", {{"type", static_cast<int>(type)}});
+			break;
+	}
+}
+
+// Deltas carry the voxels as they are now rather than as they were changed, so a chunk sent in between is never rolled back
+void Server::SendDeltas()
+{
+	std::map<uint64_t, std::vector<glm::ivec3>> pending;
+	{
+		std::lock_guard<std::mutex> guard(changesLock);
+		pending.swap(changes);
+	}
+
+	std::vector<ServerProtocol::VoxelChange> deltas;
+	for (auto &it : pending) {
+		const int x = *(reinterpret_cast<const int*>(&it.first) + 0);
+		const int z = *(reinterpret_cast<const int*>(&it.first) + 1);
+		WorldChunk::Snapshot snapshot;
+		if (!world.GetSnapshot(x, z, snapshot)) continue; // Unloaded, clients get it whole again when they come back
+
+		std::vector<glm::ivec3> &positions = it.second;
+		std::sort(positions.begin(), positions.end(), [](const glm::ivec3 &a, const glm::ivec3 &b) {
+			return a.y != b.y ? a.y < b.y : (a.z != b.z ? a.z < b.z : a.x < b.x);
+		});
+		positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+		deltas.clear();
+		for (const glm::ivec3 &position : positions) {
+			deltas.push_back({static_cast<uint8_t>(position.x), static_cast<uint8_t>(position.y), static_cast<uint8_t>(position.z), snapshot.GetVoxel(position.x, position.y, position.z)});
+		}
+
+		const ServerProtocol::DeltaMessage message = {x, z, static_cast<uint32_t>(deltas.size())};
+		for (const auto &client : clients) {
+			if (client->subscribed.count(it.first) == 0) continue;
+			Append(*client, MessageType::Delta, &message, sizeof(message), deltas.data(), deltas.size() * sizeof(ServerProtocol::VoxelChange));
+			client->deltasSent++;
+		}
+	}
+}
+
+// Nearest chunks first, chunks that are not generated yet are tried again next update
+void Server::SendChunks(Client &client, std::map<uint64_t, std::vector<uint8_t>> &encoded)
+{
+	if (!client.hasPosition) return;
+	const auto distance = [&client](int x, int z) {
+		return glm::length(glm::vec2(x * chunkWidth, z * chunkDepth) - glm::vec2(client.position.x, client.position.z));
+	};
+
+	// Chunks are kept until they are a chunk beyond the radius, so moving along the edge does not send the same chunk over and over
+	for (auto it = client.subscribed.begin(); it != client.subscribed.end();) {
+		const ServerProtocol::UnloadMessage message = {*(reinterpret_cast<const int*>(&*it) + 0), *(reinterpret_cast<const int*>(&*it) + 1)};
+		if (distance(message.x, message.z) <= client.radius + chunkWidth) {
+			it++;
+			continue;
+		}
+		Append(client, MessageType::Unload, &message, sizeof(message));
+		it = client.subscribed.erase(it);
+	}
+
+	struct Candidate
+	{
+		float distance;
+		int   x;
+		int   z;
+	};
+
+	std::vector<Candidate> candidates;
+	const int z1 = static_cast<int>(std::floor((client.position.z - client.radius) / chunkDepth));
+	const int z2 = static_cast<int>(std::ceil((client.position.z + client.radius) / chunkDepth));
+	const int x1 = static_cast<int>(std::floor((client.position.x - client.radius) / chunkWidth));
+	const int x2 = static_cast<int>(std::ceil((client.position.x + client.radius) / chunkWidth));
+	for (int iZ = z1; iZ <= z2; iZ++) {
+		for (int iX = x1; iX <= x2; iX++) {
+			if (distance(iX, iZ) <= client.radius && client.subscribed.count(GetKey(iX, iZ)) == 0) candidates.push_back({distance(iX, iZ), iX, iZ});
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.distance < b.distance; });
+
+	std::vector<SaveFile::Run> runs;
+	for (const Candidate &candidate : candidates) {
+		if (client.output.size() - client.outputOffset >= maxPendingOutput) break;
+		const uint64_t key = GetKey(candidate.x, candidate.z);
+		auto cached = encoded.find(key);
+		if (cached == encoded.end()) {
+			WorldChunk::Snapshot snapshot;
+			if (!world.GetSnapshot(candidate.x, candidate.z, snapshot)) continue;
+			SaveFile::EncodeRuns(snapshot, runs);
+			const ServerProtocol::ChunkMessage message = {candidate.x, candidate.z, static_cast<uint32_t>(runs.size())};
+			std::vector<uint8_t> data(sizeof(message) + (runs.size() * sizeof(SaveFile::Run)));
+			memcpy(data.data(), &message, sizeof(message));
+			memcpy(data.data() + sizeof(message), runs.data(), runs.size() * sizeof(SaveFile::Run));
+			cached = encoded.emplace(key, std::move(data)).first;
+		}
+		Append(client, MessageType::Chunk, cached->second.data(), cached->second.size());
+		client.subscribed.insert(key);
+		client.chunksSent++;
+	}
+}
+
+bool Server::Flush(Client &client)
+{
+	while (client.outputOffset < client.output.size()) {
+		const ssize_t sent = send(client.socket, client.output.data() + client.outputOffset, client.output.size() - client.outputOffset, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return false;
+		}
+		client.outputOffset += sent;
+		client.bytesSent    += sent;
+		bytesSent           += sent;
+	}
+
+	// Sent bytes are only dropped once there are enough of them to be worth moving the rest
+	if (client.outputOffset == client.output.size()) {
+		client.output.clear();
+		client.outputOffset = 0;
+	}
+	else if (client.outputOffset >= maxPendingOutput) {
+		client.output.erase(client.output.begin(), client.output.begin() + client.outputOffset);
+		client.outputOffset = 0;
+	}
+	return true;
+}
+
+void Server::Append(Client &client, MessageType type, const void *data, size_t size, const void *extra, size_t extraSize)
+{
+	const MessageHeader header = {static_cast<uint8_t>(type), static_cast<uint32_t>(size + extraSize)};
+	const uint8_t *headerBytes = reinterpret_cast<const uint8_t*>(&header);
+	client.output.insert(client.output.end(), headerBytes, headerBytes + sizeof(header));
+	client.output.insert(client.output.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	if (extraSize > 0) client.output.insert(client.output.end(), static_cast<const uint8_t*>(extra), static_cast<const uint8_t*>(extra) + extraSize);
+}
\ No newline at end of file
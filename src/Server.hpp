@@ -0,0 +1,69 @@
+#pragma once
+#include "World.hpp"
+#include "ServerProtocol.hpp"
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Streams the world to clients on localhost, each gets the chunks around its position run length encoded and then a delta per changed chunk
+// Everything but the change listener runs on the thread calling Update, sockets never block it
+// Construct before World::Start, the world calls the server from its jobs until it is stopped and the job system is idle
+class Server
+{
+public:
+	Server(World &world, uint16_t port, float maxRadius);
+	~Server();
+
+	Server(const Server &) = delete;
+	Server &operator=(const Server &) = delete;
+
+	bool IsListening() const { return listenSocket != -1; }
+
+	// Accepts clients, reads their messages and sends chunks and deltas, called at a fixed rate
+	void Update();
+
+	size_t   GetClientCount() const { return clients.size(); }
+	uint64_t GetBytesSent() const   { return bytesSent; }
+private:
+	// A client whose output backs up past this gets no new chunks until it catches up, deltas are always queued
+	static const size_t maxPendingOutput = 1 << 20;
+
+	struct Client
+	{
+		int                  socket;
+		bool                 hasPosition = false;
+		glm::vec3            position    = {0.0f, 0.0f, 0.0f};
+		float                radius      = 0.0f;
+		std::set<uint64_t>   subscribed; // Chunks that were sent and are kept current
+		std::vector<uint8_t> input;
+		std::vector<uint8_t> output;
+		size_t               outputOffset = 0;
+		uint64_t             bytesSent    = 0;
+		uint64_t             chunksSent   = 0;
+		uint64_t             deltasSent   = 0;
+	};
+
+	World    &world;
+	float     maxRadius;
+	int       listenSocket = -1;
+	uint64_t  bytesSent    = 0;
+
+	std::vector<std::unique_ptr<Client>> clients;
+
+	std::mutex                                  changesLock;
+	std::map<uint64_t, std::vector<glm::ivec3>> changes; // Filled by the world's change listener
+
+	static uint64_t GetKey(int x, int z);
+
+	void Accept();
+	bool Receive(Client &client); // False once the client is gone
+	void HandleMessage(Client &client, ServerProtocol::MessageType type, const uint8_t *payload, uint32_t length);
+	void SendDeltas();
+	void SendChunks(Client &client, std::map<uint64_t, std::vector<uint8_t>> &encoded);
+	bool Flush(Client &client);
+	static void Append(Client &client, ServerProtocol::MessageType type, const void *data, size_t size, const void *extra = nullptr, size_t extraSize = 0);
+};
\ No newline at end of file
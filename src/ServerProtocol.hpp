@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+
+// Messages between the world server and its clients, each is a MessageHeader followed by length bytes of payload
+// Payloads are plain structs in the byte order of the machine, the server only listens on localhost
+namespace ServerProtocol
+{
+	const uint16_t defaultPort = 28960;
+
+	enum struct MessageType : uint8_t
+	{
+		Position, // Client, PositionMessage. Chunks within the radius are sent, and unloaded again once they are out of it
+		Edit,     // Client, EditMessage
+		Ping,     // Client, PingMessage, answered with a Pong as soon as it is read
+		Chunk,    // Server, ChunkMessage followed by runCount SaveFile::Run
+		Unload,   // Server, UnloadMessage, no more deltas are sent for the chunk
+		Delta,    // Server, DeltaMessage followed by count VoxelChange
+		Pong      // Server, PingMessage with the time of the ping
+	};
+
+	#pragma pack(push, 1)
+	struct MessageHeader
+	{
+		uint8_t  type;
+		uint32_t length;
+	};
+	#pragma pack(pop)
+
+	struct PositionMessage
+	{
+		float x, y, z;
+		float radius;
+	};
+
+	// Sets every voxel in a box, the maximum is exclusive
+	struct EditMessage
+	{
+		int32_t minX, minY, minZ;
+		int32_t maxX, maxY, maxZ;
+		uint8_t voxel;
+		uint8_t padding[3];
+	};
+
+	struct PingMessage
+	{
+		uint64_t time;
+	};
+
+	struct ChunkMessage
+	{
+		int32_t  x, z;
+		uint32_t runCount;
+	};
+
+	struct UnloadMessage
+	{
+		int32_t x, z;
+	};
+
+	struct DeltaMessage
+	{
+		int32_t  x, z;
+		uint32_t count;
+	};
+
+	// Position local to the chunk and the voxel it holds now
+	struct VoxelChange
+	{
+		uint8_t x, y, z;
+		uint8_t voxel;
+	};
+}
\ No newline at end of file
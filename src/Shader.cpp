@@ -1,16 +1,52 @@
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
 #include "Log.hpp"
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
 
-Shader::Shader(const char *vertexCode, const char *fragmentCode, const char *name)
+static unsigned int boundProgram = 0;
+
+// Defines are inserted after the #version directive, which must stay the first line
+static void SetShaderSource(unsigned int shaderID, const char *code, const char *defines)
+{
+	if (!defines) {
+		glShaderSource(shaderID, 1, &code, nullptr);
+		return;
+	}
+	const char *body = code;
+	while (*body && *body != '\n') body++;
+	if (*body) body++;
+
+	const char *sources[] = {code, "\n", defines, "\n", body};
+	const int   lengths[] = {static_cast<int>(body - code), -1, -1, -1, -1};
+	glShaderSource(shaderID, 5, sources, lengths);
+}
+
+Shader::Shader(const char *vertexCode, const char *fragmentCode, const char *name, const char *defines)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	programID = glCreateProgram();
+	if (GLAD_GL_KHR_debug && name) glObjectLabel(GL_PROGRAM, programID, -1, name);
+
+	const uint64_t cacheKey = ShaderCache::GetKey(vertexCode, fragmentCode, defines);
+	const bool     cached   = ShaderCache::Load(cacheKey, programID);
+	if (!cached) Compile(vertexCode, fragmentCode, name, defines, cacheKey);
+	Reflect();
+
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	Log::Info(std::string("Shader: ") + (name ? name : "Unnamed shader") + (cached ? " loaded from cache in " : " compiled in ") + std::to_string(milliseconds) + "ms");
+}
+
+void Shader::Compile(const char *vertexCode, const char *fragmentCode, const char *name, const char *defines, uint64_t cacheKey)
 {
 	char infoLog[4096];
 	int  success;
 
 	vertexID = glCreateShader(GL_VERTEX_SHADER);
 	if (GLAD_GL_KHR_debug && name) glObjectLabel(GL_SHADER, vertexID, -1, (std::string(name) + " (VS)").c_str());
-	glShaderSource(vertexID, 1, &vertexCode, nullptr);
+	SetShaderSource(vertexID, vertexCode, defines);
 	glCompileShader(vertexID);
 	glGetShaderiv(vertexID, GL_COMPILE_STATUS, &success);
 	if (!success) {
@@ -20,7 +56,7 @@ Shader::Shader(const char *vertexCode, const char *fragmentCode, const char *nam
 
 	fragmentID = glCreateShader(GL_FRAGMENT_SHADER);
 	if (GLAD_GL_KHR_debug && name) glObjectLabel(GL_SHADER, fragmentID, -1, (std::string(name) + " (FS)").c_str());
-	glShaderSource(fragmentID, 1, &fragmentCode, nullptr);
+	SetShaderSource(fragmentID, fragmentCode, defines);
 	glCompileShader(fragmentID);
 	glGetShaderiv(fragmentID, GL_COMPILE_STATUS, &success);
 	if (!success) {
@@ -28,8 +64,7 @@ Shader::Shader(const char *vertexCode, const char *fragmentCode, const char *nam
 		Log::Error(std::string("Shader: Failed to compile fragment shader - ") + infoLog);
 	}
 
-	programID = glCreateProgram();
-	if (GLAD_GL_KHR_debug && name) glObjectLabel(GL_PROGRAM, programID, -1, name);
+	if (ShaderCache::IsEnabled()) glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(programID, vertexID);
 	glAttachShader(programID, fragmentID);
 	glLinkProgram(programID);
@@ -37,11 +72,14 @@ Shader::Shader(const char *vertexCode, const char *fragmentCode, const char *nam
 	if (!success) {
 		glGetProgramInfoLog(programID, 4096, nullptr, infoLog);
 		Log::Error(std::string("Shader: Failed to link shader program - ") + infoLog);
+		return;
 	}
+	ShaderCache::Store(cacheKey, programID);
 }
 
 Shader::~Shader()
 {
+	if (boundProgram == programID) boundProgram = 0;
 	glDeleteProgram(programID);
 	glDeleteShader(vertexID);
 	glDeleteShader(fragmentID);
@@ -50,49 +88,114 @@ Shader::~Shader()
 void Shader::Bind()
 {
 	glUseProgram(programID);
+	boundProgram = programID;
+}
+
+int Shader::GetUniformLocation(const char *name) const
+{
+	const auto it = uniformLocations.find(name);
+	return it != uniformLocations.end() ? it->second : -1;
+}
+
+void Shader::BindUniformBlock(const char *name, unsigned int binding)
+{
+	const auto it = uniformBlocks.find(name);
+	if (it == uniformBlocks.end()) {
+		Log::Error(std::string("Shader::BindUniformBlock: Uniform block ") + name + " is not active");
+		return;
+	}
+	glUniformBlockBinding(programID, it->second, binding);
 }
 
 void Shader::SetUniformInt(const char *name, const int value)
 {
-	#ifndef ARB_DIRECT_STATE_ACCESS
-		GLint currentProgram = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-		glUseProgram(programID);
-		glUniform1i(glGetUniformLocation(programID, name), value);
-	#else
-		glProgramUniform1i(programID, glGetUniformLocation(programID, name), value);
-	#endif
-	#ifndef ARB_DIRECT_STATE_ACCESS
-		glUseProgram(currentProgram);
-	#endif
+	SetUniformInt(GetUniformLocation(name), value);
+}
+
+void Shader::SetUniformIVec3(const char *name, const glm::ivec3 &value)
+{
+	SetUniformIVec3(GetUniformLocation(name), value);
 }
 
 void Shader::SetUniformVec3(const char *name, const glm::vec3 &value)
+{
+	SetUniformVec3(GetUniformLocation(name), value);
+}
+
+void Shader::SetUniformMat4(const char *name, const glm::mat4 &value)
+{
+	SetUniformMat4(GetUniformLocation(name), value);
+}
+
+// Without DSA the program has to be bound to set a uniform, the bound program is tracked so the common case of setting uniforms on the bound shader needs no state changes
+void Shader::SetUniformInt(int location, const int value)
 {
 	#ifndef ARB_DIRECT_STATE_ACCESS
-		GLint currentProgram = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-		glUseProgram(programID);
-		glUniform3fv(glGetUniformLocation(programID, name), 1, glm::value_ptr(value));
+		if (boundProgram != programID) glUseProgram(programID);
+		glUniform1i(location, value);
+		if (boundProgram != programID) glUseProgram(boundProgram);
 	#else
-		glProgramUniform3fv(programID, glGetUniformLocation(programID, name), 1, glm::value_ptr(value));
+		glProgramUniform1i(programID, location, value);
 	#endif
+}
+
+void Shader::SetUniformIVec3(int location, const glm::ivec3 &value)
+{
 	#ifndef ARB_DIRECT_STATE_ACCESS
-		glUseProgram(currentProgram);
+		if (boundProgram != programID) glUseProgram(programID);
+		glUniform3i(location, value.x, value.y, value.z);
+		if (boundProgram != programID) glUseProgram(boundProgram);
+	#else
+		glProgramUniform3i(programID, location, value.x, value.y, value.z);
 	#endif
 }
 
-void Shader::SetUniformMat4(const char *name, const glm::mat4 &value)
+void Shader::SetUniformVec3(int location, const glm::vec3 &value)
 {
 	#ifndef ARB_DIRECT_STATE_ACCESS
-		GLint currentProgram = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
-		glUseProgram(programID);
-		glUniformMatrix4fv(glGetUniformLocation(programID, name), 1, GL_FALSE, glm::value_ptr(value));
+		if (boundProgram != programID) glUseProgram(programID);
+		glUniform3fv(location, 1, glm::value_ptr(value));
+		if (boundProgram != programID) glUseProgram(boundProgram);
 	#else
-		glProgramUniformMatrix4fv(programID, glGetUniformLocation(programID, name), 1, GL_FALSE, glm::value_ptr(value));
+		glProgramUniform3fv(programID, location, 1, glm::value_ptr(value));
 	#endif
+}
+
+void Shader::SetUniformMat4(int location, const glm::mat4 &value)
+{
 	#ifndef ARB_DIRECT_STATE_ACCESS
-		glUseProgram(currentProgram);
+		if (boundProgram != programID) glUseProgram(programID);
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+		if (boundProgram != programID) glUseProgram(boundProgram);
+	#else
+		glProgramUniformMatrix4fv(programID, location, 1, GL_FALSE, glm::value_ptr(value));
 	#endif
+}
+
+void Shader::Reflect()
+{
+	char name[256];
+
+	int uniformCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (int i = 0; i < uniformCount; i++) {
+		GLint  size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, i, sizeof(name), nullptr, &size, &type, name);
+		const int location = glGetUniformLocation(programID, name);
+		if (location == -1) continue; // Member of a uniform block
+
+		// Arrays are reported as name[0], allow them to be looked up by their plain name too
+		std::string uniformName = name;
+		const auto bracket = uniformName.find('[');
+		if (bracket != std::string::npos) uniformLocations[uniformName.substr(0, bracket)] = location;
+		uniformLocations[uniformName] = location;
+	}
+
+	int blockCount = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	for (int i = 0; i < blockCount; i++) {
+		glGetActiveUniformBlockName(programID, i, sizeof(name), nullptr, name);
+		uniformBlocks[name] = i;
+	}
 }
\ No newline at end of file
@@ -1,18 +1,39 @@
 #pragma once
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
 
 class Shader
 {
 public:
-	Shader(const char *vertexCode, const char *fragmentCode, const char *name = nullptr);
+	Shader(const char *vertexCode, const char *fragmentCode, const char *name = nullptr, const char *defines = nullptr);
 	~Shader();
 
 	void Bind();
+
+	// Locations are reflected when the program is linked, -1 if the uniform is not active
+	int  GetUniformLocation(const char *name) const;
+	void BindUniformBlock(const char *name, unsigned int binding);
+
 	void SetUniformInt(const char *name, const int value);
+	void SetUniformIVec3(const char *name, const glm::ivec3 &value);
 	void SetUniformVec3(const char *name, const glm::vec3 &value);
 	void SetUniformMat4(const char *name, const glm::mat4 &value);
+
+	void SetUniformInt(int location, const int value);
+	void SetUniformIVec3(int location, const glm::ivec3 &value);
+	void SetUniformVec3(int location, const glm::vec3 &value);
+	void SetUniformMat4(int location, const glm::mat4 &value);
 private:
 	unsigned int programID  = 0;
 	unsigned int vertexID   = 0;
 	unsigned int fragmentID = 0;
+
+	std::unordered_map<std::string, int>          uniformLocations;
+	std::unordered_map<std::string, unsigned int> uniformBlocks;
+
+	void Compile(const char *vertexCode, const char *fragmentCode, const char *name, const char *defines, uint64_t cacheKey);
+	void Reflect();
 };
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "ShaderCache.hpp"
+#include "Log.hpp"
+#include <glad/glad.h>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+namespace ShaderCache
+{
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t format;
+		uint64_t key;
+		uint64_t size;
+	};
+
+	static const uint32_t magic = 0x48534756; // VGSH
+
+	static std::string directory;
+	static std::string driver;
+	static bool        enabled = false;
+
+	static uint64_t Hash(uint64_t hash, const char *data)
+	{
+		// FNV-1a
+		if (!data) return hash;
+		for (; *data; data++) {
+			hash ^= static_cast<uint8_t>(*data);
+			hash *= 0x100000001B3;
+		}
+		// Separator so that ("ab", "c") and ("a", "bc") hash differently
+		hash ^= 0xFF;
+		hash *= 0x100000001B3;
+		return hash;
+	}
+
+	static std::string GetPath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+		return directory + "/" + name;
+	}
+}
+
+void ShaderCache::Initialize(const char *directory)
+{
+	::ShaderCache::directory = directory;
+
+	int formatCount = 0;
+	if (GLAD_GL_VERSION_4_1) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0) {
+		Log::Info("ShaderCache: Driver does not support program binaries, shaders will always be compiled");
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		Log::Error(std::string("ShaderCache::Initialize: Failed to create ") + directory + " - " + error.message());
+		return;
+	}
+
+	driver  = reinterpret_cast<const char *>(glGetString(GL_VENDOR));
+	driver += '\n';
+	driver += reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+	driver += '\n';
+	driver += reinterpret_cast<const char *>(glGetString(GL_VERSION));
+	enabled = true;
+}
+
+bool ShaderCache::IsEnabled()
+{
+	return enabled;
+}
+
+uint64_t ShaderCache::GetKey(const char *vertexCode, const char *fragmentCode, const char *defines)
+{
+	uint64_t hash = 0xCBF29CE484222325;
+	hash = Hash(hash, driver.c_str());
+	hash = Hash(hash, defines);
+	hash = Hash(hash, vertexCode);
+	hash = Hash(hash, fragmentCode);
+	return hash;
+}
+
+bool ShaderCache::Load(uint64_t key, unsigned int programID)
+{
+	if (!enabled) return false;
+
+	const std::string path = GetPath(key);
+	std::error_code   error;
+	const uint64_t    fileSize = std::filesystem::file_size(path, error);
+	if (error || fileSize < sizeof(Header)) return false;
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	// A damaged entry is a miss, its size is checked against the file before anything is allocated for it
+	Header header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != magic || header.key != key) return false;
+	if (header.size != fileSize - sizeof(header)) return false;
+
+	std::vector<char> binary(header.size);
+	if (!file.read(binary.data(), binary.size())) return false;
+
+	// Drivers reject binaries after an update, compiling from source is the fallback so this is not an error
+	glProgramBinary(programID, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+	int success = 0;
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success) {
+		Log::Info("ShaderCache: Cached program " + path + " was rejected by the driver");
+		return false;
+	}
+	return true;
+}
+
+void ShaderCache::Store(uint64_t key, unsigned int programID)
+{
+	if (!enabled) return;
+
+	int length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(programID, length, &length, &format, binary.data());
+
+	// Written under a temporary name so a crash mid-write never leaves a truncated entry behind
+	const std::string path          = GetPath(key);
+	const std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		const Header header = {magic, format, key, static_cast<uint64_t>(length)};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), length);
+		if (!file) {
+			Log::Error("ShaderCache::Store: Failed to write " + temporaryPath);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) Log::Error("ShaderCache::Store: Failed to write " + path + " - " + error.message());
+}
\ No newline at end of file
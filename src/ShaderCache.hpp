@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+// Linked programs are stored on disk with glGetProgramBinary, keyed by their source, defines and the driver that produced them
+namespace ShaderCache
+{
+	// Must be called on the thread that owns the OpenGL context
+	void Initialize(const char *directory);
+	bool IsEnabled();
+
+	uint64_t GetKey(const char *vertexCode, const char *fragmentCode, const char *defines);
+	bool Load(uint64_t key, unsigned int programID);
+	void Store(uint64_t key, unsigned int programID);
+}
\ No newline at end of file
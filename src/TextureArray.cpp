@@ -1,46 +1,115 @@
 #include "TextureArray.hpp"
+#include "MappedFile.hpp"
 #include "Utility.hpp"
+#include "Log.hpp"
 #include <stb_image.h>
 #include <glad/glad.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
 
 using namespace Utility;
 
-TextureArray::TextureArray(const char *fileName, int depth) : depth(depth)
+namespace
 {
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layers;
+		uint32_t channels;
+		uint32_t levels;
+		uint32_t reserved;
+	};
+
+	const uint32_t magic   = 0x41585456; // VTXA
+	const uint32_t version = 1;
+
+	uint64_t GetLevelSize(const Header &header, uint32_t level)
+	{
+		const uint64_t width  = std::max(header.width  >> level, 1u);
+		const uint64_t height = std::max(header.height >> level, 1u);
+		return width * height * header.channels * header.layers;
+	}
+
+	// Converts if the asset is missing or older than its source image
+	bool IsOutOfDate(const std::string &source, const std::string &asset)
+	{
+		std::error_code error;
+		if (!std::filesystem::exists(asset, error)) return true;
+		if (!std::filesystem::exists(source, error)) return false;
+		return std::filesystem::last_write_time(source, error) > std::filesystem::last_write_time(asset, error);
+	}
+}
+
+TextureArray::TextureArray(const char *fileName, int depth)
+{
+	const std::string assetName = std::string(fileName) + ".vta";
+	if (IsOutOfDate(fileName, assetName)) Convert(fileName, assetName.c_str(), depth);
+
+	MappedFile file(assetName.c_str());
+	if (!file.IsOpen() || file.size < sizeof(Header)) return;
+
+	const Header &header = *reinterpret_cast<const Header*>(file.data);
+	if (header.magic != magic || header.version != version) {
+		Log::Error("TextureArray: " + assetName + " is not a texture array asset");
+		return;
+	}
+
+	uint64_t dataSize = sizeof(Header);
+	for (uint32_t level = 0; level < header.levels; level++) dataSize += GetLevelSize(header, level);
+	if (file.size < dataSize) {
+		Log::Error("TextureArray: " + assetName + " is truncated");
+		return;
+	}
+
+	width  = header.width;
+	height = header.height;
+	this->depth = header.layers;
+
+	const GLenum format         = GetFormat(header.channels);
+	const GLenum internalFormat = GetInternalFormat(header.channels);
+
+	// Small mip levels have rows that are not 4 byte aligned
+	GLint unpackAlignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const uint8_t *levelData = file.data + sizeof(Header);
 	#ifdef ARB_DIRECT_STATE_ACCESS
 		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureID);
 
-		// glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		// glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-		int channels = 0;
-		auto imageData = stbi_load(fileName, &width, &height, &channels, 0);
-		height /= depth;
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
 
-		glTextureStorage3D(textureID, 1, GetInternalFormat(channels), width, height, depth);
-		for (int i = 0; i < depth; i++) {
-			glTextureSubImage3D(textureID, 0, 0, 0, i, width, height, 1, GetFormat(channels), GL_UNSIGNED_BYTE, imageData + (width * height * channels * i));
+		glTextureStorage3D(textureID, header.levels, internalFormat, width, height, this->depth);
+		for (uint32_t level = 0; level < header.levels; level++) {
+			const int levelWidth  = std::max(width  >> level, 1);
+			const int levelHeight = std::max(height >> level, 1);
+			glTextureSubImage3D(textureID, level, 0, 0, 0, levelWidth, levelHeight, this->depth, format, GL_UNSIGNED_BYTE, levelData);
+			levelData += GetLevelSize(header, level);
 		}
-		stbi_image_free(imageData);
 	#else
 		glGenTextures(1, &textureID);
 		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
 
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-		int channels = 0;
-		auto imageData = stbi_load(fileName, &width, &height, &channels, 0);
-		height /= depth;
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
 
-		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GetFormat(channels), width, height, depth, 0, GetFormat(channels), GL_UNSIGNED_BYTE, nullptr);
-		for (int i = 0; i < depth; i++) {
-			glTexSubImage3D(textureID, 0, 0, 0, i, width, height, 1, GetFormat(channels), GL_UNSIGNED_BYTE, imageData + (width * height * channels * i));
+		for (uint32_t level = 0; level < header.levels; level++) {
+			const int levelWidth  = std::max(width  >> level, 1);
+			const int levelHeight = std::max(height >> level, 1);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, this->depth, 0, format, GL_UNSIGNED_BYTE, levelData);
+			levelData += GetLevelSize(header, level);
 		}
-		stbi_image_free(imageData);
 	#endif
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
 }
 
 TextureArray::~TextureArray()
@@ -56,4 +125,86 @@ void TextureArray::Bind(int slot)
 		glActiveTexture(GL_TEXTURE0 + slot);
 		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
 	#endif
+}
+
+// Layers are stacked vertically in the source image, every mip level is generated with a box filter
+bool TextureArray::Convert(const char *source, const char *destination, int depth)
+{
+	int width    = 0;
+	int height   = 0;
+	int channels = 0;
+	uint8_t *imageData = stbi_load(source, &width, &height, &channels, 0);
+	if (!imageData) {
+		Log::Error(std::string("TextureArray::Convert: Failed to load ") + source + " - " + stbi_failure_reason());
+		return false;
+	}
+
+	Header header;
+	header.magic    = magic;
+	header.version  = version;
+	header.width    = width;
+	header.height   = height / depth;
+	header.layers   = depth;
+	header.channels = channels;
+	header.levels   = 1;
+	header.reserved = 0;
+	while ((header.width >> header.levels) > 0 || (header.height >> header.levels) > 0) header.levels++;
+
+	std::vector<std::vector<uint8_t>> levels(header.levels);
+	levels[0].assign(imageData, imageData + GetLevelSize(header, 0));
+	stbi_image_free(imageData);
+
+	for (uint32_t level = 1; level < header.levels; level++) {
+		const uint32_t sourceWidth  = std::max(header.width  >> (level - 1), 1u);
+		const uint32_t sourceHeight = std::max(header.height >> (level - 1), 1u);
+		const uint32_t levelWidth   = std::max(header.width  >> level, 1u);
+		const uint32_t levelHeight  = std::max(header.height >> level, 1u);
+
+		const std::vector<uint8_t> &previous = levels[level - 1];
+		std::vector<uint8_t> &current = levels[level];
+		current.resize(GetLevelSize(header, level));
+
+		for (uint32_t layer = 0; layer < header.layers; layer++) {
+			const uint8_t *sourceLayer = previous.data() + (uint64_t)sourceWidth * sourceHeight * channels * layer;
+			uint8_t       *layerData   = current.data()  + (uint64_t)levelWidth  * levelHeight  * channels * layer;
+			for (uint32_t y = 0; y < levelHeight; y++) {
+				for (uint32_t x = 0; x < levelWidth; x++) {
+					const uint32_t x0 = std::min(x * 2, sourceWidth  - 1);
+					const uint32_t x1 = std::min(x * 2 + 1, sourceWidth  - 1);
+					const uint32_t y0 = std::min(y * 2, sourceHeight - 1);
+					const uint32_t y1 = std::min(y * 2 + 1, sourceHeight - 1);
+					for (int c = 0; c < channels; c++) {
+						const uint32_t sum = sourceLayer[(y0 * sourceWidth + x0) * channels + c] +
+						                     sourceLayer[(y0 * sourceWidth + x1) * channels + c] +
+						                     sourceLayer[(y1 * sourceWidth + x0) * channels + c] +
+						                     sourceLayer[(y1 * sourceWidth + x1) * channels + c];
+						layerData[(y * levelWidth + x) * channels + c] = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+
+	const std::string temporaryName = std::string(destination) + ".tmp";
+	{
+		std::ofstream file(temporaryName, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto &level : levels) {
+			file.write(reinterpret_cast<const char*>(level.data()), level.size());
+		}
+		if (!file) {
+			Log::Error("TextureArray::Convert: Failed to write " + temporaryName);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryName, destination, error);
+	if (error) {
+		Log::Error(std::string("TextureArray::Convert: Failed to write ") + destination + " - " + error.message());
+		return false;
+	}
+
+	Log::Info(std::string("TextureArray: Converted ") + source + " to " + destination + " with " + std::to_string(header.levels) + " mip levels");
+	return true;
 }
\ No newline at end of file
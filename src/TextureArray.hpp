@@ -3,11 +3,14 @@
 class TextureArray
 {
 public:
+	// Loads fileName.vta, converting fileName into it first if it is missing or out of date
 	TextureArray(const char *fileName, int depth);
 	~TextureArray();
 
 	void Bind(int slot);
 
+	static bool Convert(const char *source, const char *destination, int depth);
+
 	int width  = 0;
 	int height = 0;
 	int depth  = 0;
@@ -0,0 +1,47 @@
+#include "UniformBuffer.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
+#include "MemoryManager.hpp"
+#include <glad/glad.h>
+
+UniformBuffer::UniformBuffer(uint64_t size, const char *name) : name(name), size(size)
+{
+	#ifdef ARB_DIRECT_STATE_ACCESS
+		glCreateBuffers(1, &ubo);
+		glNamedBufferData(ubo, size, nullptr, GL_DYNAMIC_DRAW);
+	#else
+		glGenBuffers(1, &ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	#endif
+	if (GLAD_GL_KHR_debug && !this->name.empty()) glObjectLabel(GL_BUFFER, ubo, -1, (this->name + " (UBO)").c_str());
+	MemoryManager::Allocate(MemoryManager::Category::GpuBuffers, size);
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &ubo);
+	MemoryManager::Free(MemoryManager::Category::GpuBuffers, size);
+}
+
+void UniformBuffer::Update(const void *data, uint64_t size, uint64_t offset)
+{
+	if (offset + size > this->size) {
+		Log::Error("UniformBuffer::Update: Write exceeds buffer size");
+		return;
+	}
+	PROFILE_COUNTER(BytesUploaded, size);
+	#ifdef ARB_DIRECT_STATE_ACCESS
+		glNamedBufferSubData(ubo, offset, size, data);
+	#else
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	#endif
+}
+
+void UniformBuffer::Bind(uint32_t binding)
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class UniformBuffer
+{
+public:
+	UniformBuffer(uint64_t size, const char *name = "");
+	~UniformBuffer();
+
+	void Update(const void *data, uint64_t size, uint64_t offset = 0);
+	void Bind(uint32_t binding);
+private:
+	std::string name;
+
+	uint32_t ubo  = 0;
+	uint64_t size = 0;
+};
\ No newline at end of file
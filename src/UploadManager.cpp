@@ -0,0 +1,248 @@
+#include "UploadManager.hpp"
+#include "VertexBuffer.hpp"
+#include "MemoryManager.hpp"
+#include "Log.hpp"
+#include <glad/glad.h>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <string>
+
+namespace UploadManager
+{
+	enum struct RecordState
+	{
+		Allocated, // Owned by the caller of Allocate
+		Copied,    // Copy has been issued and is waiting on the fence of its frame
+		Free
+	};
+
+	// Records are kept in offset order and retire wherever they are, so an allocation that is held for long only keeps its own space
+	struct Record
+	{
+		uint64_t    id;
+		uint64_t    offset;
+		uint64_t    end; // Aligned
+		uint64_t    frame;
+		RecordState state;
+	};
+
+	struct FrameFence
+	{
+		GLsync   fence;
+		uint64_t frame;
+	};
+
+	static const uint64_t alignment = 16;
+
+	static std::mutex             ringLock;
+	static std::vector<Record>    records;
+	static std::deque<FrameFence> fences;
+	static uint32_t               stagingBuffer   = 0;
+	static uint8_t               *stagingData     = nullptr;
+	static uint64_t               stagingCapacity = 0;
+	static uint64_t               head            = 0; // Allocations continue from the last one, so space is reused in ring order
+	static uint64_t               nextID          = 1;
+	static uint64_t               currentFrame    = 1;
+	static uint64_t               completedFrame  = 0;
+
+	static std::atomic<uint64_t>  budget{0};
+	static uint64_t               uploadedThisFrame = 0;
+	static bool                   uploadedAny       = false;
+
+	static Record *FindRecord(uint64_t id)
+	{
+		for (Record &record : records) {
+			if (record.id == id) return &record;
+		}
+		return nullptr;
+	}
+
+	static void RetireRecords()
+	{
+		records.erase(std::remove_if(records.begin(), records.end(), [](const Record &record) {
+			return record.state == RecordState::Free || (record.state == RecordState::Copied && record.frame <= completedFrame);
+		}), records.end());
+	}
+
+	// First gap between records that fits, looking from the head onwards and then from the start of the ring
+	static bool FindGap(uint64_t size, uint64_t &offset, size_t &index)
+	{
+		for (const uint64_t from : {head, uint64_t(0)}) {
+			uint64_t start = 0;
+			for (size_t i = 0; i <= records.size(); i++) {
+				const uint64_t end = i < records.size() ? records[i].offset : stagingCapacity;
+				const uint64_t gap = std::max(start, from);
+				if (end >= gap + size) {
+					offset = gap;
+					index  = i;
+					return true;
+				}
+				if (i < records.size()) start = records[i].end;
+			}
+		}
+		return false;
+	}
+
+	// The first upload of a frame is always allowed so a mesh larger than the budget cannot stall forever
+	static bool ConsumeBudget(uint64_t size)
+	{
+		if (uploadedAny && uploadedThisFrame + size > budget.load(std::memory_order_relaxed)) return false;
+		uploadedThisFrame += size;
+		uploadedAny        = true;
+		return true;
+	}
+}
+
+void UploadManager::Initialize(uint64_t stagingSize, uint64_t frameBudget)
+{
+	budget = frameBudget;
+
+	if (!GLAD_GL_VERSION_4_4) {
+		Log::Info("UploadManager: glBufferStorage unavailable, uploading directly from system memory");
+		return;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	#ifdef ARB_DIRECT_STATE_ACCESS
+		glCreateBuffers(1, &stagingBuffer);
+		glNamedBufferStorage(stagingBuffer, stagingSize, nullptr, flags);
+		stagingData = static_cast<uint8_t*>(glMapNamedBufferRange(stagingBuffer, 0, stagingSize, flags));
+	#else
+		glGenBuffers(1, &stagingBuffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+		glBufferStorage(GL_COPY_READ_BUFFER, stagingSize, nullptr, flags);
+		stagingData = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, stagingSize, flags));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	#endif
+	if (GLAD_GL_KHR_debug) glObjectLabel(GL_BUFFER, stagingBuffer, -1, "Upload Staging Ring");
+
+	if (!stagingData) {
+		Log::Error("UploadManager::Initialize: Failed to map staging buffer");
+		glDeleteBuffers(1, &stagingBuffer);
+		stagingBuffer = 0;
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(ringLock);
+	stagingCapacity = stagingSize;
+	MemoryManager::Allocate(MemoryManager::Category::GpuBuffers, stagingCapacity);
+}
+
+void UploadManager::Cleanup()
+{
+	std::lock_guard<std::mutex> guard(ringLock);
+	for (const FrameFence &frameFence : fences) glDeleteSync(frameFence.fence);
+	fences.clear();
+	records.clear();
+
+	if (stagingBuffer) {
+		#ifdef ARB_DIRECT_STATE_ACCESS
+			glUnmapNamedBuffer(stagingBuffer);
+		#else
+			glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		#endif
+		glDeleteBuffers(1, &stagingBuffer);
+		MemoryManager::Free(MemoryManager::Category::GpuBuffers, stagingCapacity);
+	}
+	stagingBuffer   = 0;
+	stagingData     = nullptr;
+	stagingCapacity = 0;
+	head            = 0;
+}
+
+void UploadManager::BeginFrame()
+{
+	uploadedThisFrame = 0;
+	uploadedAny       = false;
+
+	std::lock_guard<std::mutex> guard(ringLock);
+	while (!fences.empty()) {
+		const GLenum result = glClientWaitSync(fences.front().fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+		glDeleteSync(fences.front().fence);
+		completedFrame = fences.front().frame;
+		fences.pop_front();
+	}
+	RetireRecords();
+}
+
+void UploadManager::EndFrame()
+{
+	std::lock_guard<std::mutex> guard(ringLock);
+	if (stagingBuffer) fences.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), currentFrame});
+	currentFrame++;
+}
+
+// An allocation can only be copied once, after that its space is reclaimed and Release does nothing
+bool UploadManager::Upload(VertexBuffer *vertexBuffer, const Allocation &allocation, uint64_t vertexCount)
+{
+	if (allocation.id == 0) return false;
+
+	{
+		std::lock_guard<std::mutex> guard(ringLock);
+		Record *record = FindRecord(allocation.id);
+		if (!record || record->state != RecordState::Allocated) return false;
+		if (!ConsumeBudget(allocation.size)) return false;
+		record->state = RecordState::Copied;
+		record->frame = currentFrame;
+	}
+
+	vertexBuffer->CopyVertices(stagingBuffer, allocation.offset, vertexCount);
+	return true;
+}
+
+bool UploadManager::Upload(VertexBuffer *vertexBuffer, const void *vertices, uint64_t vertexCount)
+{
+	if (!ConsumeBudget(vertexCount * vertexBuffer->GetStride())) return false;
+	vertexBuffer->UpdateVertices(vertices, vertexCount);
+	return true;
+}
+
+void UploadManager::SetFrameBudget(uint64_t frameBudget)
+{
+	budget = frameBudget;
+}
+
+bool UploadManager::Allocate(uint64_t size, Allocation &allocation)
+{
+	if (size == 0) return false;
+	const uint64_t alignedSize = (size + alignment - 1) & ~(alignment - 1);
+
+	std::lock_guard<std::mutex> guard(ringLock);
+	if (!stagingData || alignedSize > stagingCapacity) return false;
+
+	uint64_t offset;
+	size_t   index;
+	if (!FindGap(alignedSize, offset, index)) return false;
+
+	Record record;
+	record.id     = nextID++;
+	record.offset = offset;
+	record.end    = offset + alignedSize;
+	record.frame  = 0;
+	record.state  = RecordState::Allocated;
+	records.insert(records.begin() + index, record);
+	head = record.end;
+
+	allocation.data   = stagingData + offset;
+	allocation.offset = offset;
+	allocation.size   = size;
+	allocation.id     = record.id;
+	return true;
+}
+
+void UploadManager::Release(Allocation &allocation)
+{
+	if (allocation.id == 0) return;
+	{
+		std::lock_guard<std::mutex> guard(ringLock);
+		Record *record = FindRecord(allocation.id);
+		if (record && record->state == RecordState::Allocated) record->state = RecordState::Free;
+	}
+	allocation = Allocation();
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+
+class VertexBuffer;
+
+// Vertex data is staged in a persistently mapped ring buffer that any thread can write to, the render thread then copies it into vertex buffers without exceeding the per-frame budget
+namespace UploadManager
+{
+	struct Allocation
+	{
+		void    *data   = nullptr;
+		uint64_t offset = 0;
+		uint64_t size   = 0;
+		uint64_t id     = 0; // 0 if nothing is allocated
+	};
+
+	// Must be called on the thread that owns the OpenGL context
+	void Initialize(uint64_t stagingSize, uint64_t frameBudget);
+	void Cleanup();
+	void BeginFrame();
+	void EndFrame();
+	bool Upload(VertexBuffer *vertexBuffer, const Allocation &allocation, uint64_t vertexCount);
+	bool Upload(VertexBuffer *vertexBuffer, const void *vertices, uint64_t vertexCount);
+
+	// Can be called from any thread, Allocate returns false if the staging buffer is unavailable or full
+	void SetFrameBudget(uint64_t frameBudget);
+	bool Allocate(uint64_t size, Allocation &allocation);
+	void Release(Allocation &allocation);
+}
\ No newline at end of file
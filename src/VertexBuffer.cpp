@@ -1,5 +1,7 @@
 #include "VertexBuffer.hpp"
 #include "Log.hpp"
+#include "Profiler.hpp"
+#include "MemoryManager.hpp"
 #include <glad/glad.h>
 #include <string>
 
@@ -38,6 +40,16 @@ GLint GetAttributeComponentCount(const uint32_t type)
 	return type & 007;
 }
 
+// Buffers are reallocated when they grow and when less than half of them would be used, so a mesh that shrinks gives its memory back
+bool NeedsReallocation(uint64_t size, uint64_t &bufferSize)
+{
+	if (size <= bufferSize && size >= bufferSize / 2) return false;
+	MemoryManager::Free(MemoryManager::Category::GpuBuffers, bufferSize);
+	MemoryManager::Allocate(MemoryManager::Category::GpuBuffers, size);
+	bufferSize = size;
+	return true;
+}
+
 VertexBuffer::VertexBuffer(std::initializer_list<VertexType> attributes, const char *name) : name(name)
 {
 	// Calculate stride
@@ -93,15 +105,16 @@ VertexBuffer::~VertexBuffer()
 	glDeleteVertexArrays(1, &vao);
 	glDeleteBuffers(1, &vbo);
 	glDeleteBuffers(1, &ebo);
+	MemoryManager::Free(MemoryManager::Category::GpuBuffers, vboSize + eboSize);
 }
 
 void VertexBuffer::UpdateVertices(const void *vertices, uint64_t vertexCount)
 {
-	if (vertexCount == 0) return;
 	this->vertexCount = vertexCount;
+	if (vertexCount == 0) return;
+	PROFILE_COUNTER(BytesUploaded, vertexCount * stride);
 	#ifdef ARB_DIRECT_STATE_ACCESS
-		if (vertexCount * stride > vboSize) {
-			vboSize = vertexCount * stride;
+		if (NeedsReallocation(vertexCount * stride, vboSize)) {
 			glNamedBufferData(vbo, vboSize, vertices, GL_DYNAMIC_DRAW);
 		}
 		else {
@@ -109,8 +122,7 @@ void VertexBuffer::UpdateVertices(const void *vertices, uint64_t vertexCount)
 		}
 	#else
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		if (vertexCount * stride > vboSize) {
-			vboSize = vertexCount * stride;
+		if (NeedsReallocation(vertexCount * stride, vboSize)) {
 			glBufferData(GL_ARRAY_BUFFER, vboSize, vertices, GL_DYNAMIC_DRAW);
 		}
 		else {
@@ -119,10 +131,33 @@ void VertexBuffer::UpdateVertices(const void *vertices, uint64_t vertexCount)
 	#endif
 }
 
+void VertexBuffer::CopyVertices(uint32_t sourceBuffer, uint64_t sourceOffset, uint64_t vertexCount)
+{
+	this->vertexCount = vertexCount;
+	if (vertexCount == 0) return;
+	PROFILE_COUNTER(BytesUploaded, vertexCount * stride);
+	#ifdef ARB_DIRECT_STATE_ACCESS
+		if (NeedsReallocation(vertexCount * stride, vboSize)) {
+			glNamedBufferData(vbo, vboSize, nullptr, GL_DYNAMIC_DRAW);
+		}
+		glCopyNamedBufferSubData(sourceBuffer, vbo, sourceOffset, 0, vertexCount * stride);
+	#else
+		glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+		if (NeedsReallocation(vertexCount * stride, vboSize)) {
+			glBufferData(GL_COPY_WRITE_BUFFER, vboSize, nullptr, GL_DYNAMIC_DRAW);
+		}
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, 0, vertexCount * stride);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	#endif
+}
+
 void VertexBuffer::UpdateIndices(const uint32_t *indices, uint64_t indexCount)
 {
 	if (indexCount == 0) return;
 	this->indexCount = indexCount;
+	PROFILE_COUNTER(BytesUploaded, indexCount * 4);
 	if (ebo == 0) {
 		// Create element buffer object
 		#ifdef ARB_DIRECT_STATE_ACCESS
@@ -138,8 +173,7 @@ void VertexBuffer::UpdateIndices(const uint32_t *indices, uint64_t indexCount)
 		#endif
 	}
 	#ifdef ARB_DIRECT_STATE_ACCESS
-		if (indexCount * 4 > eboSize) {
-			eboSize = indexCount * 4;
+		if (NeedsReallocation(indexCount * 4, eboSize)) {
 			glNamedBufferData(ebo, eboSize, indices, GL_DYNAMIC_DRAW);
 		}
 		else {
@@ -147,8 +181,7 @@ void VertexBuffer::UpdateIndices(const uint32_t *indices, uint64_t indexCount)
 		}
 	#else
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		if (indexCount * 4 > eboSize) {
-			eboSize = indexCount * 4;
+		if (NeedsReallocation(indexCount * 4, eboSize)) {
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * 4, indices, GL_DYNAMIC_DRAW);
 		}
 		else {
@@ -160,6 +193,7 @@ void VertexBuffer::UpdateIndices(const uint32_t *indices, uint64_t indexCount)
 void VertexBuffer::Render(uint64_t vertexCount)
 {
 	vertexCount = vertexCount == 0 ? this->vertexCount : vertexCount;
+	PROFILE_COUNTER(VerticesDrawn, vertexCount);
 	glBindVertexArray(vao);
 	if (ebo == 0) {
 		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
@@ -168,4 +202,17 @@ void VertexBuffer::Render(uint64_t vertexCount)
 		glDrawElements(GL_TRIANGLES, vertexCount, GL_UNSIGNED_INT, nullptr);
 	}
 	glBindVertexArray(0);
+}
+
+void VertexBuffer::RenderRanges(const int32_t *firsts, const int32_t *counts, int rangeCount)
+{
+	if (rangeCount == 0) return;
+	#ifdef PROFILER
+		uint64_t vertexCount = 0;
+		for (int i = 0; i < rangeCount; i++) vertexCount += counts[i];
+		PROFILE_COUNTER(VerticesDrawn, vertexCount);
+	#endif
+	glBindVertexArray(vao);
+	glMultiDrawArrays(GL_TRIANGLES, firsts, counts, rangeCount);
+	glBindVertexArray(0);
 }
\ No newline at end of file
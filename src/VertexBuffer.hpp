@@ -47,8 +47,13 @@ public:
 	~VertexBuffer();
 
 	void UpdateVertices(const void *vertices, uint64_t vertexCount);
+	void CopyVertices(uint32_t sourceBuffer, uint64_t sourceOffset, uint64_t vertexCount);
 	void UpdateIndices(const uint32_t *indices, uint64_t indexCount);
 	void Render(uint64_t vertexCount = 0);
+	void RenderRanges(const int32_t *firsts, const int32_t *counts, int rangeCount); // Draws several vertex ranges in one call, indices are ignored
+
+	uint32_t GetStride() const { return stride; }
+	uint64_t GetSize() const { return vboSize + eboSize; }
 private:
 	std::string name;
 
@@ -0,0 +1,169 @@
+#include "World.hpp"
+#include "Lighting.hpp"
+#include "BakeFile.hpp"
+#include "JobSystem.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Generates, lights and meshes a rectangle of chunks ahead of time on every core and writes them to a bake, which the game and the server
+// stream with --bake instead of generating those chunks. Needs neither SDL nor OpenGL
+// --from <x> <z> --to <x> <z> are the chunk coordinates of opposite corners, both included, --output <file> is the bake to write
+// --seed <seed> picks the generator's terrain, --threads <count> overrides the number of workers
+static const char *usage = "VoxelBaker::main: Usage: VoxelBaker --from <x> <z> --to <x> <z> --output <file> [--seed <seed>] [--threads <count>]";
+
+// Light crosses chunk borders, so a ring of chunks around the rectangle is lit along with it but not written. Rows of chunks are generated
+// in bands and a row is written once the rows on both sides of it are lit, so memory stays bounded however large the rectangle is
+static const int bandChunks = 256; // Generated at a time at least, enough to keep every worker busy
+
+static void GenerateChunk(std::shared_ptr<WorldChunk> chunk, std::shared_ptr<Lighting> lighting, uint32_t seed, int x, int z)
+{
+	chunk->TransitionState(ChunkState::Queued, ChunkState::Generating);
+	{
+		auto guard = chunk->LockVoxels();
+		World::GenerateTerrain(seed, x, z, *chunk);
+	}
+	chunk->TransitionState(ChunkState::Generating, ChunkState::Meshing);
+	lighting->AddChunk(chunk, x, z); // Its faces are only built once it is written, its neighbours can still change its light until then
+}
+
+static void EncodeChunk(const WorldChunk &chunk, std::vector<uint8_t> &data)
+{
+	static thread_local std::vector<uint8_t>  light(WorldChunk::lightBytes);
+	static thread_local std::vector<MeshFace> faces;
+	WorldChunk::Snapshot snapshot;
+	{
+		auto guard = chunk.LockVoxelsShared();
+		snapshot = chunk.TakeSnapshot();
+		chunk.CopyLight(light.data());
+	}
+	FaceOffsets faceOffsets;
+	chunk.BuildFaces(faces, faceOffsets);
+	BakeFile::EncodeChunk(snapshot, light.data(), faces, faceOffsets, data);
+}
+
+int main(int argc, char **argv)
+{
+	Log::Initialize();
+
+	glm::ivec2  from(0, 0);
+	glm::ivec2  to(0, 0);
+	bool        hasFrom        = false;
+	bool        hasTo          = false;
+	const char *outputFileName = nullptr;
+	uint32_t    seed           = 0;
+	int         threadCount    = 0;
+	int i = 1;
+	try {
+		for (; i < argc; i++) {
+			const std::string argument = argv[i];
+			if (argument == "--from" && i + 2 < argc) {
+				from.x = std::stoi(argv[++i]);
+				from.y = std::stoi(argv[++i]);
+				hasFrom = true;
+			}
+			else if (argument == "--to" && i + 2 < argc) {
+				to.x = std::stoi(argv[++i]);
+				to.y = std::stoi(argv[++i]);
+				hasTo = true;
+			}
+			else if (argument == "--output" && i + 1 < argc)  outputFileName = argv[++i];
+			else if (argument == "--seed" && i + 1 < argc)    seed           = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if (argument == "--threads" && i + 1 < argc) threadCount    = std::stoi(argv[++i]);
+			else Log::Error("VoxelBaker::main: Unknown argument " + argument);
+		}
+	}
+	catch (const std::exception &exception) {
+		Log::Error("VoxelBaker::main: Invalid value " + std::string(argv[i]) + " - " + exception.what());
+		Log::Error(usage);
+		Log::Cleanup();
+		return 1;
+	}
+	if (!hasFrom || !hasTo || !outputFileName) {
+		Log::Error(usage);
+		Log::Cleanup();
+		return 1;
+	}
+	const glm::ivec2 min        = glm::min(from, to);
+	const glm::ivec2 max        = glm::max(from, to);
+	const int        width      = max.x - min.x + 1;
+	const uint32_t   chunkCount = width * (max.y - min.y + 1);
+	const int        bandRows   = std::max(1, bandChunks / (width + 2));
+	threadCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	BakeFile::Writer writer(outputFileName, seed, chunkCount);
+	if (!writer.IsOpen()) {
+		Log::Error(std::string("VoxelBaker::main: Failed to create ") + outputFileName);
+		Log::Cleanup();
+		return 1;
+	}
+
+	JobSystem::StartThreads(threadCount);
+	Log::Info("VoxelBaker: Baking " + std::to_string(chunkCount) + " chunks to " + outputFileName, {{"seed", seed}, {"width", width}, {"depth", max.y - min.y + 1}, {"threads", threadCount}});
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto lighting  = std::make_shared<Lighting>();
+
+	std::map<int, std::vector<std::shared_ptr<WorldChunk>>> rows; // Lit rows from the ring's first column to its last, by z
+	std::vector<std::vector<uint8_t>> records;
+	std::vector<glm::ivec2> relitChunks;
+	uint32_t written   = 0;
+	uint64_t generated = 0;
+	int      nextRow   = min.y - 1;
+	bool     failed    = false;
+	for (int row = min.y; row <= max.y && !failed;) {
+		const int lastRow = std::min(std::max(nextRow + bandRows - 1, row + 1), max.y + 1);
+		for (; nextRow <= lastRow; nextRow++) {
+			std::vector<std::shared_ptr<WorldChunk>> &chunks = rows[nextRow];
+			for (int x = min.x - 1; x <= max.x + 1; x++) {
+				const auto chunk = std::make_shared<WorldChunk>();
+				chunk->meshing = false;
+				chunks.push_back(chunk);
+				JobSystem::AddJob(std::bind(GenerateChunk, chunk, lighting, seed, x, nextRow));
+			}
+			generated += chunks.size();
+		}
+		JobSystem::WaitForIdle(); // Lighting runs as jobs, so this waits for the light to settle too
+		lighting->TakeChangedChunks(relitChunks); // Nothing is meshed before it is written, so chunks whose light changed need nothing
+
+		// Each job encodes one chunk, they are written in order once all of them have finished
+		const int writeEnd = std::min(lastRow - 1, max.y);
+		records.resize((writeEnd - row + 1) * width);
+		std::vector<JobSystem::Job> jobs;
+		for (int z = row; z <= writeEnd; z++) {
+			for (int x = 0; x < width; x++) {
+				const WorldChunk &chunk  = *rows[z][x + 1];
+				std::vector<uint8_t> &record = records[((z - row) * width) + x];
+				jobs.push_back([&chunk, &record]() { EncodeChunk(chunk, record); });
+			}
+		}
+		JobSystem::RunBatch(jobs);
+		for (int z = row; z <= writeEnd && !failed; z++) {
+			for (int x = 0; x < width && !failed; x++) {
+				failed = !writer.Add(glm::ivec2(min.x + x, z), records[((z - row) * width) + x]);
+			}
+		}
+		written += jobs.size();
+
+		// Light from the rows still to come only reaches into the last lit row, so the rows that were written are no longer needed
+		rows.erase(rows.begin(), rows.upper_bound(writeEnd));
+		row = writeEnd + 1;
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		Log::Info("VoxelBaker: Progress", {{"chunks", written}, {"percent", 100.0 * written / chunkCount}, {"chunksPerSecond", written / seconds}, {"megabytes", writer.GetSize() / (1024.0 * 1024.0)}});
+	}
+	if (failed) Log::Error(std::string("VoxelBaker: Failed to write ") + outputFileName);
+	else failed = !writer.Finish();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	if (!failed) {
+		Log::Info("VoxelBaker: Baked " + std::to_string(written) + " chunks to " + outputFileName + " in " + std::to_string(seconds) + "s",
+			{{"chunksPerSecond", written / seconds}, {"generatedPerSecond", generated / seconds}, {"kilobytesPerChunk", writer.GetSize() / 1024.0 / written}});
+	}
+	rows.clear();
+	JobSystem::StopThreads();
+	Log::Cleanup();
+	return failed ? 1 : 0;
+}
\ No newline at end of file
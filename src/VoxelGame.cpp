@@ -2,40 +2,62 @@
 #include "Renderer.hpp"
 #include "Log.hpp"
 #include "JobSystem.hpp"
+#include "AsyncIo.hpp"
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
 #include "FreeCamera.hpp"
-#include "Chunk.hpp"
+#include "World.hpp"
+#include "ChunkRenderer.hpp"
+#include "Importer.hpp"
+#include "DistanceController.hpp"
+#include "Entities.hpp"
 #include "TextureArray.hpp"
 #include "VertexBuffer.hpp"
+#include "CommandBuffer.hpp"
+#include "Profiler.hpp"
+#include "UploadManager.hpp"
+#include "UniformBuffer.hpp"
+#include "MemoryManager.hpp"
+#include "Recording.hpp"
+#include "FrameStats.hpp"
 #include <cstdint>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/noise.hpp>
-#include <functional>
-#include <map>
 #include <array>
+#include <algorithm>
 #include <memory>
+#include <chrono>
+#include <sstream>
+#include <filesystem>
 
 const char *vertexCode =
 R"(#version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNorm;
 layout (location = 2) in vec3 aTexCoord;
+layout (location = 3) in float aLight;
 
-uniform mat4 uCamera;
-uniform mat4 uModel;
+layout (std140) uniform Frame
+{
+	mat4 uCamera;
+	vec3 uCameraPos;
+};
+
+uniform ivec3 uChunkOffset;
 
 uniform sampler2DArray uTexture;
 
 out vec3 fragPos;
 out vec3 norm;
 out vec3 texCoord;
+out vec2 light;
 
 void main()
 {
-	fragPos     = vec3(uModel * vec4(aPos, 1.0));
+	fragPos     = aPos + vec3(uChunkOffset);
 	norm        = aNorm;
 	texCoord    = vec3(vec2(1.0) / textureSize(uTexture, 0).xy, 1.0) * aTexCoord;
-	gl_Position = uCamera * uModel * vec4(aPos, 1.0);
+	light       = vec2(floor(aLight / 16.0), mod(aLight, 16.0)) / 15.0;
+	gl_Position = uCamera * vec4(fragPos, 1.0);
 })";
 
 const char *fragmentCode =
@@ -44,10 +66,16 @@ R"(#version 330 core
 in      vec3 fragPos;
 in      vec3 norm;
 in      vec3 texCoord;
+in      vec2 light;
 
 out     vec4 outColor;
 
-uniform vec3 uCameraPos;
+layout (std140) uniform Frame
+{
+	mat4 uCamera;
+	vec3 uCameraPos;
+};
+
 uniform sampler2DArray uTexture;
 
 const vec3  lightPos = vec3(-200, 200.0, -200.0);
@@ -57,17 +85,21 @@ void main()
 {
 	// vec3  color      = vec3(1.0, 0.0, 0.0);
 	vec3  color      = texture(uTexture, texCoord).rgb;
-	vec3  ambient    = 0.3 * color;
+
+	// Each light level is 80% of the one above, the sun only reaches surfaces with sky light
+	float skyLight   = pow(0.8, 15.0 * (1.0 - light.x));
+	float blockLight = pow(0.8, 15.0 * (1.0 - light.y));
+	vec3  ambient    = 0.3 * max(skyLight, blockLight) * color;
 	vec3  lightDir   = normalize(lightPos - fragPos);
 
 	float diff       = max(dot(lightDir, norm), 0.0);
-	vec3  diffuse    = diff * color;
+	vec3  diffuse    = diff * skyLight * color;
 
 	vec3  viewDir    = normalize(uCameraPos - fragPos);
 	vec3  reflectDir = reflect(-lightDir, norm);
 	vec3  halfwayDir = normalize(lightDir + viewDir);
 	float spec       = pow(max(dot(norm, halfwayDir), 0.0), 32.0);
-	vec3  specular   = vec3(0.3) * spec;
+	vec3  specular   = vec3(0.3) * spec * skyLight;
 
 	outColor = vec4(ambient + diffuse + specular, 1.0);
 })";
@@ -102,6 +134,13 @@ void main()
 	outColor = texture(uTexture, texCoord);
 })";
 
+// Matches the std140 layout of the Frame uniform block
+struct FrameUniforms
+{
+	glm::mat4 camera;
+	glm::vec4 cameraPos;
+};
+
 struct CursorVertex
 {
 	int8_t  pX, pZ;
@@ -117,124 +156,218 @@ const std::array<CursorVertex, 6> cursorVertices = {
 	CursorVertex{ 16,  16, 16, 16, 3}
 };
 
-template<uint8_t Width, uint8_t Height, uint8_t Depth, typename VoxelType, VoxelType NullVoxel>
-void GenerateChunk(std::shared_ptr<Chunk<Width, Height, Depth, VoxelType, NullVoxel>> chunk, int x, int y, int z)
-{
-	chunk->lock.lock();
-	for (uint8_t iZ = 0; iZ < Depth; iZ++) {
-		for (uint8_t iX = 0; iX < Width; iX++) {
-			chunk->SetVoxel(iX, 0, iZ, 1);
-			const int aX = iX + (x * Width);
-			const int aZ = iZ + (z * Depth);
-			float noise = (24.0f) * glm::simplex(glm::vec2((float)aX / (float)(512), (float)aZ / (float)(512)));
-			noise += (12.0f) * glm::simplex(glm::vec2((float)aX / (float)(64), (float)aZ / (float)(64)));
-			noise += 12.0f;
-			for (uint8_t iY = 0; iY <= noise + 2; iY++) {
-				chunk->SetVoxel(iX, iY, iZ, 1);
-			}
-		}
-	}
-	chunk->UpdateVertices();
-	chunk->lock.unlock();
-}
-
 int main(int argc, char **argv)
 {
 	const int windowWidth  = 1280;
 	const int windowHeight = 720;
 
-	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-		Log::Error(std::string("VoxelGame::main: Failed to initialize SDL2 - ") + SDL_GetError());
-		return 0;
+	Log::Initialize();
+
+	// --record <file> saves a flythrough, --replay <file> plays one back and reports frame times, --deterministic makes replay wait for every chunk
+	// --headless <frames> renders offscreen without a display, --dump <prefix> saves every frame as <prefix>NNNNN.png
+	// --save <file> loads the world from the file if it exists, saves it every minute in the background and again on exit
+	// --import <file> builds the terrain from a .r16 or .png heightmap or a .vol volume, --import-scale <scale> sets voxels per heightmap unit
+	// --fixed-distance keeps the render and load distances from adapting to the frame time, as do replays and --deterministic
+	// --seed <seed> picks the generator's terrain, --bake <file> streams chunks that VoxelBaker generated, lit and meshed ahead of time
+	const char *recordFileName = nullptr;
+	const char *saveFileName   = nullptr;
+	const char *replayFileName = nullptr;
+	const char *dumpPrefix     = nullptr;
+	const char *importFileName = nullptr;
+	const char *bakeFileName   = nullptr;
+	float       importScale    = Importer::defaultHeightScale;
+	uint32_t    seed           = 0;
+	bool        deterministic  = false;
+	bool        fixedDistance  = false;
+	bool        headless       = false;
+	uint64_t    frameLimit     = 0;
+	int i = 1;
+	try {
+		for (; i < argc; i++) {
+			const std::string argument = argv[i];
+			if (argument == "--record" && i + 1 < argc)      recordFileName = argv[++i];
+			else if (argument == "--replay" && i + 1 < argc) replayFileName = argv[++i];
+			else if (argument == "--deterministic")          deterministic  = true;
+			else if (argument == "--fixed-distance")         fixedDistance  = true;
+			else if (argument == "--dump" && i + 1 < argc)   dumpPrefix     = argv[++i];
+			else if (argument == "--save" && i + 1 < argc)   saveFileName   = argv[++i];
+			else if (argument == "--import" && i + 1 < argc) importFileName = argv[++i];
+			else if (argument == "--import-scale" && i + 1 < argc) importScale = std::stof(argv[++i]);
+			else if (argument == "--bake" && i + 1 < argc)   bakeFileName   = argv[++i];
+			else if (argument == "--seed" && i + 1 < argc)   seed           = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else if (argument == "--headless" && i + 1 < argc) {
+				headless   = true;
+				frameLimit = std::stoull(argv[++i]);
+			}
+			else Log::Error("VoxelGame::main: Unknown argument " + argument);
+		}
+	}
+	catch (const std::exception &exception) {
+		Log::Error("VoxelGame::main: Invalid value " + std::string(argv[i]) + " - " + exception.what());
+		Log::Error("VoxelGame::main: Usage: VoxelGame [--record <file> | --replay <file>] [--deterministic] [--fixed-distance] [--headless <frames>] [--dump <prefix>] "
+			"[--save <file>] [--import <file>] [--import-scale <scale>] [--seed <seed>] [--bake <file>]");
+		Log::Cleanup();
+		return 1;
 	}
 
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
-
-	SDL_ClearError();
-	SDL_Window *window = SDL_CreateWindow("VoxelGame", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, windowWidth, windowHeight, SDL_WINDOW_OPENGL);
-	if (!window) {
-		Log::Error(std::string("VoxelGame::main: Failed to create window - ") + SDL_GetError());
+	SDL_Window *window  = nullptr;
+	bool        running = false;
+	if (headless) {
+		#ifdef HEADLESS
+			running = Renderer::InitializeHeadless(windowWidth, windowHeight);
+		#else
+			Log::Error("VoxelGame::main: --headless requires a build with HEADLESS enabled");
+		#endif
 	}
+	else {
+		if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+			Log::Error(std::string("VoxelGame::main: Failed to initialize SDL2 - ") + SDL_GetError());
+			Log::Cleanup();
+			return 0;
+		}
+
+		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
+
+		SDL_ClearError();
+		window = SDL_CreateWindow("VoxelGame", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, windowWidth, windowHeight, SDL_WINDOW_OPENGL);
+		if (!window) {
+			Log::Error(std::string("VoxelGame::main: Failed to create window - ") + SDL_GetError());
+		}
 
-	bool running = window && Renderer::Initialize(window);
+		running = window && Renderer::Initialize(window);
+	}
+	#ifdef PROFILER
+		if (running) Profiler::Initialize();
+	#endif
 	Renderer::SetClearColor((1.0f / 255.0f) * 135.0f, (1.0f / 255.0f) * 206.0f, (1.0f / 255.0f) * 235.0f, (1.0f / 255.0f) * 255.0f);
 
+	if (running) ShaderCache::Initialize("shadercache");
+	const auto shaderStartTime = std::chrono::steady_clock::now();
+
 	Shader *shader = new Shader(vertexCode, fragmentCode, "Test Shader");
 
 	Shader *cursorShader = new Shader(cursorVertexCode, cursorFragmentCode, "Cursor Shader");
+	Log::Info("Shaders ready in " + std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStartTime).count()) + "ms");
 	FreeCamera *camera = new FreeCamera();
 
 	glm::mat4 projection = glm::perspectiveFov(45.0f, 1280.0f, 720.0f, 0.1f, 1000.0f);
 	SDL_bool isCaptured = SDL_FALSE;
 
-	const int chunkWidth  = 64;
-	const int chunkHeight = 64;
-	const int chunkDepth  = 64;
-
 	TextureArray *texture_atlas = new TextureArray("../res/texture_atlas.png", 4);
 	texture_atlas->Bind(0);
 	shader->SetUniformInt("uTexture", 0);
 	cursorShader->SetUniformInt("uTexture", 0);
+	cursorShader->SetUniformMat4("uTransform", glm::ortho(0.0f, 1280.0f, 720.0f, 0.0f) * glm::translate(glm::mat4(1.0f), glm::vec3(1280.0f / 2.0f, 720.0f / 2.0f, 0.0f)));
+
+	const uint32_t frameUniformBinding = 0;
+	UniformBuffer *frameUniformBuffer = new UniformBuffer(sizeof(FrameUniforms), "Frame Uniforms");
+	frameUniformBuffer->Bind(frameUniformBinding);
+	shader->BindUniformBlock("Frame", frameUniformBinding);
+	const int chunkOffsetLocation = shader->GetUniformLocation("uChunkOffset");
 
 	VertexBuffer *cursorVertexBuffer = new VertexBuffer({VertexType::Int8_2, VertexType::Uint8_3});
 	cursorVertexBuffer->UpdateVertices(cursorVertices.data(), cursorVertices.size());
 
+	// Kept between frames so recording stops allocating once the buffers have grown
+	CommandBuffer              commandBuffer;
+	std::vector<CommandBuffer> batchBuffers;
+	const size_t               recordBatchSize = 128; // Render items per recording job
+
 	// const float loadDistance   = 256.0f;
 	// const float renderDistance = 160.0f;
-	const float loadDistance   = 512.0f;
+	const float loadDistance   = 512.0f; // Starting distances, the controller adapts them unless they are fixed
 	const float renderDistance = 384.0f;
-	std::map<uint64_t, std::shared_ptr<Chunk<chunkWidth, chunkHeight, chunkDepth, uint8_t, 0>>> chunks;
+
+	DistanceController::Settings distanceSettings;
+	distanceSettings.loadMargin        = loadDistance - renderDistance;
+	distanceSettings.maxRenderDistance = 896.0f; // Chunks further out would reach past the far plane
+	DistanceController distanceController(renderDistance, distanceSettings);
+	const bool         adaptiveDistance = !fixedDistance && !deterministic && !replayFileName;
+
+	// Generation stops being queued beyond this many waiting jobs, except when deterministic frames wait for every chunk anyway
+	const size_t maxQueuedJobs = 256;
+
+	const uint64_t stagingSize  = 64 * 1024 * 1024;
+	const uint64_t uploadBudget = 4 * 1024 * 1024; // Bytes per frame
+	if (running) {
+		UploadManager::Initialize(stagingSize, uploadBudget);
+		ChunkRenderer::Initialize();
+	}
+
+	// Chunks that are out of view are evicted once a budget is exceeded, and new chunks stop loading at the voxel budget
+	MemoryManager::SetBudget(MemoryManager::Category::Voxels,     1024ull * 1024 * 1024);
+	MemoryManager::SetBudget(MemoryManager::Category::Meshes,     256ull  * 1024 * 1024);
+	MemoryManager::SetBudget(MemoryManager::Category::GpuBuffers, 512ull  * 1024 * 1024);
+
+	World *world = new World(loadDistance, renderDistance);
+	if (!deterministic) world->SetMaxQueuedJobs(maxQueuedJobs);
+	world->SetSeed(seed);
+	if (saveFileName && std::filesystem::exists(saveFileName)) world->Load(saveFileName);
+	if (bakeFileName) world->LoadBake(bakeFileName);
+	std::shared_ptr<Importer> importer;
+	if (importFileName) {
+		importer = std::make_shared<Importer>(importFileName, importScale);
+		if (importer->IsOpen()) world->SetChunkSource(importer);
+	}
+
+	Recording recording;
+	size_t    replayStep = 0;
+	if (replayFileName && !recording.Load(replayFileName)) {
+		Log::Error(std::string("VoxelGame::main: Failed to load ") + replayFileName);
+		running = false;
+	}
+	FrameStats::SetEnabled(replayFileName || headless);
+	FrameStats::SetStallThreshold(static_cast<uint64_t>(recording.timestep * 2.0f * 1e9f));
+
+	// The camera is the first entity, so it collides with the terrain
+	Entities entities;
+	const Entities::Id cameraEntity = entities.Add(camera->position, glm::vec3(0.3f));
 
 	JobSystem::StartThreads();
+	AsyncIo::Start();
+	world->Start();
 
 	auto keyState = SDL_GetKeyboardState(nullptr);
 
+	// The camera is simulated at a fixed timestep so recordings replay the same regardless of frame rate
+	const float cameraSpeed     = 180.0f; // Units per second
+	const float explosionRadius = 6.0f;
+	const float placeDistance   = 12.0f;
+	const float placeRadius     = 3.0f;
+	double      accumulator     = 0.0;
+	bool        removeVoxel     = false;
+	bool        explode         = false;
+	bool        placeWater      = false;
+	bool        placeSand       = false;
+	auto        previousTime    = std::chrono::steady_clock::now();
+	auto        autosaveTime    = previousTime;
+	auto        frameEndTime    = previousTime;
+	uint64_t    frame           = 0;
+
 	while (running) {
+		if (replayFileName && replayStep >= recording.steps.size()) break;
+		if (frameLimit && frame >= frameLimit) break;
+		auto frameStartTime = std::chrono::steady_clock::now();
+
+		#ifdef PROFILER
+			Profiler::BeginFrame();
+		#endif
+		UploadManager::BeginFrame();
+
 		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
+		while (!headless && SDL_PollEvent(&event)) {
 			switch (event.type) {
 				case SDL_QUIT:
 					running = false;
 					break;
 				case SDL_MOUSEMOTION:
-					if (isCaptured) camera->ProcessMouseInput(event.motion.xrel, event.motion.yrel);
+					if (isCaptured && !replayFileName) camera->ProcessMouseInput(event.motion.xrel, event.motion.yrel);
 					break;
 				case SDL_MOUSEBUTTONDOWN:
-					if (isCaptured && event.button.button == SDL_BUTTON_LEFT) {
-						glm::vec3 direction = camera->front;
-						for (float i = 0.0f; i < 256.0f; i += 0.01f) {
-							glm::vec3 pos = camera->position + (direction * i);
-							pos.x = floor(pos.x);
-							pos.y = floor(pos.y);
-							pos.z = floor(pos.z);
-
-							int chunkX = floor((double)pos.x / (double)chunkWidth);
-							int chunkZ = floor((double)pos.z / (double)chunkDepth);
-
-							int localX = (int)pos.x % chunkWidth;
-							int localZ = (int)pos.z % chunkDepth;
-							if (localX < 0) localX += chunkWidth;
-							if (localZ < 0) localZ += chunkDepth;
-
-							uint64_t chunkIndex;
-							*(reinterpret_cast<int*>(&chunkIndex) + 0) = chunkX;
-							*(reinterpret_cast<int*>(&chunkIndex) + 1) = chunkZ;
-
-							if (chunks.count(chunkIndex) > 0) {
-								auto chunk = chunks[chunkIndex];
-								chunk->lock.lock();
-								if (chunk->TestPos(localX, pos.y, localZ)) {
-									chunk->SetVoxel(localX, pos.y, localZ, 0);
-									chunk->modified = true;
-									chunk->UpdateVertices();
-									chunk->lock.unlock();
-									break;
-								}
-								chunk->lock.unlock();
-							}
-						}
-					}
+					if (isCaptured && event.button.button == SDL_BUTTON_LEFT)   removeVoxel = true;
+					if (isCaptured && event.button.button == SDL_BUTTON_RIGHT)  explode     = true;
+					if (isCaptured && event.button.button == SDL_BUTTON_MIDDLE) placeWater  = true;
 					break;
 				case SDL_KEYDOWN:
 					if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE && !event.key.repeat) {
@@ -243,106 +376,196 @@ int main(int argc, char **argv)
 						SDL_SetRelativeMouseMode(isCaptured);
 						// SDL_ShowCursor(isCaptured == SDL_TRUE ? SDL_FALSE : SDL_TRUE);
 					}
+					if (isCaptured && event.key.keysym.scancode == SDL_SCANCODE_E && !event.key.repeat) placeSand = true;
+					#ifdef PROFILER
+						if (event.key.keysym.scancode == SDL_SCANCODE_F2 && !event.key.repeat) {
+							Profiler::WriteTrace("VoxelGame.trace.json");
+						}
+					#endif
 					break;
 			}
 		}
 
-		glm::vec3 movement = {0.0f, 0.0f, 0.0f};
-		// float speed = 0.5f;
-		float speed = 3.0f;
-		if (keyState[SDL_SCANCODE_SPACE])  movement.y += speed;
-		if (keyState[SDL_SCANCODE_LSHIFT]) movement.y -= speed;
-		if (keyState[SDL_SCANCODE_W])      movement.z += speed;
-		if (keyState[SDL_SCANCODE_S])      movement.z -= speed;
-		if (keyState[SDL_SCANCODE_D])      movement.x += speed;
-		if (keyState[SDL_SCANCODE_A])      movement.x -= speed;
-		camera->Move(movement);
-
-		// Unload chunks
-		for (auto it = chunks.cbegin(); it != chunks.cend();) {
-			int x = *(reinterpret_cast<const int*>(&it->first) + 0);
-			int z = *(reinterpret_cast<const int*>(&it->first) + 1);
-			if (glm::length(glm::vec2(x * chunkWidth, z * chunkDepth) - glm::vec2(camera->position.x, camera->position.z)) > loadDistance) {
-				if (it->second.use_count() == 1 && it->second->lock.try_lock()) {
-					if (it->second->modified) {
-						it->second->lock.unlock();
-						it++;
-					}
-					else {
-						it->second->lock.unlock();
-						chunks.erase(it++);
-					}
+		if (replayFileName) {
+			// One step per frame, so a slow frame never skips input
+			const Recording::Step &step = recording.steps[replayStep++];
+			camera->position = step.position;
+			camera->SetRotation(step.yaw, step.pitch);
+			entities.SetPosition(cameraEntity, step.position);
+			if (step.flags & Recording::RemoveVoxel) world->RemoveVoxel(camera->position, camera->front);
+			if (step.flags & Recording::Explode)     world->RemoveVoxel(camera->position, camera->front, explosionRadius);
+			if (step.flags & Recording::PlaceWater)  world->Edit(VoxelShape::Sphere(camera->position + (camera->front * placeDistance), placeRadius), waterVoxel + waterLevels - 1);
+			if (step.flags & Recording::PlaceSand)   world->Edit(VoxelShape::Sphere(camera->position + (camera->front * placeDistance), placeRadius), sandVoxel);
+			world->Advance(recording.timestep);
+		}
+		else {
+			const auto currentTime = std::chrono::steady_clock::now();
+			accumulator  = std::min(accumulator + std::chrono::duration<double>(currentTime - previousTime).count(), 0.25);
+			previousTime = currentTime;
+			while (accumulator >= recording.timestep) {
+				accumulator -= recording.timestep;
+
+				glm::vec3 movement = {0.0f, 0.0f, 0.0f};
+				if (keyState[SDL_SCANCODE_SPACE])  movement.y += 1.0f;
+				if (keyState[SDL_SCANCODE_LSHIFT]) movement.y -= 1.0f;
+				if (keyState[SDL_SCANCODE_W])      movement.z += 1.0f;
+				if (keyState[SDL_SCANCODE_S])      movement.z -= 1.0f;
+				if (keyState[SDL_SCANCODE_D])      movement.x += 1.0f;
+				if (keyState[SDL_SCANCODE_A])      movement.x -= 1.0f;
+				entities.SetVelocity(cameraEntity, camera->GetMovement(movement) * cameraSpeed);
+				entities.Update(*world, recording.timestep);
+				camera->position = entities.GetPosition(cameraEntity);
+
+				if (removeVoxel) world->RemoveVoxel(camera->position, camera->front);
+				if (explode)     world->RemoveVoxel(camera->position, camera->front, explosionRadius);
+				if (placeWater)  world->Edit(VoxelShape::Sphere(camera->position + (camera->front * placeDistance), placeRadius), waterVoxel + waterLevels - 1);
+				if (placeSand)   world->Edit(VoxelShape::Sphere(camera->position + (camera->front * placeDistance), placeRadius), sandVoxel);
+				world->Advance(recording.timestep);
+				if (recordFileName) {
+					const uint32_t flags = (removeVoxel ? Recording::RemoveVoxel : 0u) | (explode ? Recording::Explode : 0u) |
+					                       (placeWater ? Recording::PlaceWater : 0u) | (placeSand ? Recording::PlaceSand : 0u);
+					recording.steps.push_back({camera->position, camera->GetYaw(), camera->GetPitch(), movement, flags});
 				}
-				else it++;
+				removeVoxel = false;
+				explode     = false;
+				placeWater  = false;
+				placeSand   = false;
 			}
-			else it++;
 		}
 
-		// Load chunks
-		{
-			int z1 = round((camera->position.z - loadDistance) / chunkDepth);
-			int z2 = round((camera->position.z + loadDistance) / chunkDepth);
-			int x1 = round((camera->position.x - loadDistance) / chunkWidth);
-			int x2 = round((camera->position.x + loadDistance) / chunkWidth);
-			for (int iZ = z1; iZ < z2; iZ++) {
-				for (int iX = x1; iX < x2; iX++) {
-					if (glm::length(glm::vec2(iX * chunkWidth, iZ * chunkDepth) - glm::vec2(camera->position.x, camera->position.z)) <= loadDistance) {
-						uint64_t index;
-						*(reinterpret_cast<int*>(&index) + 0) = iX;
-						*(reinterpret_cast<int*>(&index) + 1) = iZ;
-						if (chunks.count(index) == 0) {
-							chunks[index] = std::make_shared<Chunk<chunkWidth, chunkHeight, chunkDepth, uint8_t, 0>>();
-							const JobSystem::Job &job = std::bind(GenerateChunk<chunkWidth, chunkHeight, chunkDepth, uint8_t, 0>, chunks[index], iX, 0, iZ);
-							JobSystem::AddJob(job);
-						}
-					}
-				}
-			}
+		if (saveFileName && frameStartTime - autosaveTime >= std::chrono::minutes(1)) {
+			world->Save(saveFileName);
+			autosaveTime = frameStartTime;
+		}
+		world->SetCamera(camera->position);
+		if (deterministic) {
+			// Waiting is left out of the frame time, only the work done on this thread is measured
+			world->WaitForUpdate();
+			AsyncIo::WaitForIdle();
+			JobSystem::WaitForIdle();
+			frameStartTime = std::chrono::steady_clock::now();
 		}
+		const RenderList &renderList = world->AcquireRenderList();
+		ChunkRenderer::DeleteUnusedBuffers();
 
+		const auto submitStartTime = std::chrono::steady_clock::now();
 		Renderer::ClearBuffer();
 
-		shader->Bind();
+		FrameUniforms frameUniforms;
+		frameUniforms.camera    = projection * camera->GetMatrix();
+		frameUniforms.cameraPos = glm::vec4(camera->position, 1.0f);
+		frameUniformBuffer->Update(&frameUniforms, sizeof(frameUniforms));
 
-		shader->SetUniformVec3("uCameraPos", camera->position);
-		// shader->SetUniformMat4("uCamera", projection * camera->GetMatrix() * glm::scale(glm::mat4(1.0f), glm::vec3(0.25f, 0.25f, 0.25f)));
-		// shader->SetUniformMat4("uCamera", projection * camera->GetMatrix() * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f, 0.5f, 0.5f)));
-		shader->SetUniformMat4("uCamera", projection * camera->GetMatrix());
+		{
+			PROFILE_ZONE("Upload chunks");
+			for (const RenderItem &item : renderList) ChunkRenderer::Upload(*item.chunk);
+		}
 
-		// Render chunks
+		// Draws are recorded on the workers in batches, then sorted and replayed here
 		{
-			int z1 = round((camera->position.z - renderDistance) / chunkDepth);
-			int z2 = round((camera->position.z + renderDistance) / chunkDepth);
-			int x1 = round((camera->position.x - renderDistance) / chunkWidth);
-			int x2 = round((camera->position.x + renderDistance) / chunkWidth);
-			for (int iZ = z1; iZ < z2; iZ++) {
-				for (int iX = x1; iX < x2; iX++) {
-					if (glm::length(glm::vec2(iX * chunkWidth, iZ * chunkDepth) - glm::vec2(camera->position.x, camera->position.z)) <= renderDistance) {
-						uint64_t index;
-						*(reinterpret_cast<int*>(&index) + 0) = iX;
-						*(reinterpret_cast<int*>(&index) + 1) = iZ;
-						auto chunk = chunks[index];
-						if (chunk && chunk->lock.try_lock()) {
-							shader->SetUniformMat4("uModel", glm::translate(glm::mat4(1.0f), glm::vec3(iX * chunkWidth, 0.0f, iZ * chunkDepth)));
-							chunk->Render();
-							chunk->lock.unlock();
-						}
-					}
+			PROFILE_ZONE("Record draws");
+			const glm::vec3 cameraPosition = camera->position;
+			const auto record = [&renderList, shader, chunkOffsetLocation, cameraPosition](size_t begin, size_t end, CommandBuffer &commands) {
+				for (size_t i = begin; i < end; i++) {
+					const RenderItem &item = renderList[i];
+					CommandBuffer::Draw draw;
+					if (!ChunkRenderer::RecordDraw(*item.chunk, cameraPosition - glm::vec3(item.offset), draw)) continue;
+					draw.shader         = shader;
+					draw.offsetLocation = chunkOffsetLocation;
+					draw.offset         = item.offset;
+					const glm::vec3 min     = item.offset;
+					const glm::vec3 nearest = glm::clamp(cameraPosition, min, min + glm::vec3(chunkWidth, chunkHeight, chunkDepth));
+					commands.Add(CommandBuffer::Pass::Opaque, glm::length(nearest - cameraPosition), draw);
+				}
+			};
+
+			commandBuffer.Clear();
+			const size_t batches = (renderList.size() + recordBatchSize - 1) / recordBatchSize;
+			if (batches <= 1) record(0, renderList.size(), commandBuffer);
+			else {
+				batchBuffers.resize(batches);
+				std::vector<JobSystem::Job> jobs;
+				for (size_t batch = 0; batch < batches; batch++) {
+					jobs.push_back([&, batch]() {
+						batchBuffers[batch].Clear();
+						record(batch * recordBatchSize, std::min((batch + 1) * recordBatchSize, renderList.size()), batchBuffers[batch]);
+					});
 				}
+				JobSystem::RunBatch(jobs);
+				for (const CommandBuffer &batchBuffer : batchBuffers) commandBuffer.Append(batchBuffer);
 			}
+
+			CommandBuffer::Draw cursorDraw;
+			cursorDraw.shader = cursorShader;
+			cursorDraw.buffer = cursorVertexBuffer;
+			commandBuffer.Add(CommandBuffer::Pass::Overlay, 0.0f, cursorDraw);
 		}
 
-		cursorShader->Bind();
-		cursorShader->SetUniformMat4("uTransform", glm::ortho(0.0f, 1280.0f, 720.0f, 0.0f) * glm::translate(glm::mat4(1.0f), glm::vec3(1280.0f / 2.0f, 720.0f / 2.0f, 0.0f)));
-		cursorVertexBuffer->Render();
+		PROFILE_GPU_BEGIN("Submit draws");
+		commandBuffer.Submit();
+		PROFILE_GPU_END();
+		FrameStats::AddSubmitTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submitStartTime).count());
+
+		if (dumpPrefix) {
+			const std::string frameNumber = std::to_string(frame);
+			Renderer::SaveScreenshot((dumpPrefix + std::string(5 - std::min<size_t>(frameNumber.size(), 5), '0') + frameNumber + ".png").c_str());
+		}
 
-		Renderer::FlushBuffer();
+		UploadManager::EndFrame();
+		const auto workEndTime = std::chrono::steady_clock::now(); // Waiting for vsync in the swap is not load
+		{
+			PROFILE_ZONE("Swap buffers");
+			Renderer::FlushBuffer();
+		}
+
+		PROFILE_GAUGE(VoxelMemory, MemoryManager::GetUsage(MemoryManager::Category::Voxels));
+		PROFILE_GAUGE(MeshMemory,  MemoryManager::GetUsage(MemoryManager::Category::Meshes));
+		PROFILE_GAUGE(GpuMemory,   MemoryManager::GetUsage(MemoryManager::Category::GpuBuffers));
+
+		#ifdef PROFILER
+			Profiler::EndFrame();
+		#endif
+		FrameStats::AddFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frameStartTime).count());
+		if (adaptiveDistance) {
+			const auto  currentTime = std::chrono::steady_clock::now();
+			const float seconds     = std::chrono::duration<float>(currentTime - frameEndTime).count();
+			if (distanceController.Update(seconds, std::chrono::duration<float>(workEndTime - frameStartTime).count())) {
+				world->SetDistances(distanceController.GetLoadDistance(), distanceController.GetRenderDistance());
+			}
+			frameEndTime = currentTime;
+		}
+		frame++;
 	}
 
+	if (replayFileName || headless) {
+		Log::Info("Rendered " + std::to_string(frame) + " frames");
+		std::istringstream report(FrameStats::GetReport());
+		for (std::string line; std::getline(report, line);) Log::Info(line);
+	}
+	if (recordFileName) recording.Save(recordFileName);
+	if (saveFileName) {
+		JobSystem::WaitForIdle(); // An autosave that is still being written would cause this save to be skipped
+		world->Save(saveFileName);
+		world->WaitForUpdate();
+		JobSystem::WaitForIdle();
+	}
+
+	world->Stop();
+	AsyncIo::Stop();
+	if (saveFileName || bakeFileName || importFileName) AsyncIo::LogReport();
 	JobSystem::StopThreads();
-	chunks.clear();
+	delete world;
+	if (importer) importer->LogReport();
+	ChunkRenderer::Cleanup();
+	UploadManager::Cleanup();
+
+	#ifdef PROFILER
+		Profiler::WriteTrace("VoxelGame.trace.json");
+		Profiler::Cleanup();
+	#endif
 
 	delete cursorVertexBuffer;
+	delete frameUniformBuffer;
 	delete texture_atlas;
 	delete camera;
 	delete cursorShader;
@@ -352,5 +575,6 @@ int main(int argc, char **argv)
 	if (window) SDL_DestroyWindow(window);
 
 	SDL_Quit();
+	Log::Cleanup();
 	return 0;
 }
\ No newline at end of file
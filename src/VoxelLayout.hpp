@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+
+// Layout policies map a voxel position to its index in the chunk's storage, Chunk takes one as its last template parameter
+// Each provides size, Index(x, y, z), ForEach(function), which calls function(x, y, z, index) in storage order, and
+// Neighbour(index, x, y, z, face), which steps from a voxel's index to the index across one of its faces. The neighbour must be in the chunk
+
+// One step along x (0), y (1) or z (2) for each face, in the order of Chunk's Face
+struct LayoutStep
+{
+	int axis;
+	int direction;
+};
+
+constexpr LayoutStep layoutSteps[6] = {{2, -1}, {2, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 1}};
+
+// Y-major rows, X neighbours are adjacent but Z and Y neighbours are Width and Width * Depth elements away
+template<int Width, int Height, int Depth>
+struct LinearLayout
+{
+	static const uint64_t size = static_cast<uint64_t>(Width) * Height * Depth;
+
+	static constexpr uint64_t Index(int x, int y, int z)
+	{
+		return (static_cast<uint64_t>(y) * Width * Depth) + (z * Width) + x;
+	}
+
+	static constexpr uint64_t Neighbour(uint64_t index, int, int, int, int face)
+	{
+		const uint64_t strides[3] = {1, static_cast<uint64_t>(Width) * Depth, Width};
+		const LayoutStep step = layoutSteps[face];
+		return step.direction < 0 ? index - strides[step.axis] : index + strides[step.axis];
+	}
+
+	template<typename Function>
+	static void ForEach(Function &&function)
+	{
+		uint64_t index = 0;
+		for (int y = 0; y < Height; y++) {
+			for (int z = 0; z < Depth; z++) {
+				for (int x = 0; x < Width; x++) {
+					function(x, y, z, index++);
+				}
+			}
+		}
+	}
+};
+
+// Z-order curve with the bits of x, z and y interleaved, so all three neighbours are usually within the same cache line or page
+// Dimensions that are not the same power of two leave holes in the storage
+template<int Width, int Height, int Depth>
+struct MortonLayout
+{
+	static constexpr uint64_t Spread(uint64_t value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8))  & 0x0300F00F;
+		value = (value | (value << 4))  & 0x030C30C3;
+		value = (value | (value << 2))  & 0x09249249;
+		return value;
+	}
+
+	static constexpr uint64_t Compact(uint64_t value)
+	{
+		value &= 0x09249249;
+		value = (value | (value >> 2))  & 0x030C30C3;
+		value = (value | (value >> 4))  & 0x0300F00F;
+		value = (value | (value >> 8))  & 0x030000FF;
+		value = (value | (value >> 16)) & 0x3FF;
+		return value;
+	}
+
+	static constexpr uint64_t Index(int x, int y, int z)
+	{
+		return Spread(x) | (Spread(z) << 1) | (Spread(y) << 2);
+	}
+
+	// Adds or subtracts one in the bits of a single coordinate, the carry or borrow is passed through the other coordinates' bits
+	static constexpr uint64_t Neighbour(uint64_t index, int, int, int, int face)
+	{
+		const uint64_t bits[3] = {0x09249249, 0x09249249 << 2, 0x09249249 << 1};
+		const LayoutStep step  = layoutSteps[face];
+		const uint64_t   mask  = bits[step.axis];
+		const uint64_t   moved = step.direction < 0 ? (index & mask) - 1 : (index | ~mask) + 1;
+		return (moved & mask) | (index & ~mask);
+	}
+
+	static const uint64_t size = Index(Width - 1, Height - 1, Depth - 1) + 1;
+
+	template<typename Function>
+	static void ForEach(Function &&function)
+	{
+		for (uint64_t index = 0; index < size; index++) {
+			const int x = static_cast<int>(Compact(index));
+			const int z = static_cast<int>(Compact(index >> 1));
+			const int y = static_cast<int>(Compact(index >> 2));
+			if (x < Width && y < Height && z < Depth) function(x, y, z, index);
+		}
+	}
+};
+
+// Linear bricks of BrickSize^3 voxels stored one after another, so every neighbour inside a brick is at most BrickSize^2 elements away
+template<int BrickSize, int Width, int Height, int Depth>
+struct BrickedLayout
+{
+	static_assert(Width % BrickSize == 0 && Height % BrickSize == 0 && Depth % BrickSize == 0, "Chunk dimensions must be a multiple of the brick size");
+
+	static const int      bricksX    = Width / BrickSize;
+	static const int      bricksZ    = Depth / BrickSize;
+	static const uint64_t brickCount = BrickSize * BrickSize * BrickSize;
+	static const uint64_t size       = static_cast<uint64_t>(Width) * Height * Depth;
+
+	static constexpr uint64_t Index(int x, int y, int z)
+	{
+		const uint64_t brick = (static_cast<uint64_t>(y / BrickSize) * bricksX * bricksZ) + ((z / BrickSize) * bricksX) + (x / BrickSize);
+		const uint64_t local = ((y % BrickSize) * BrickSize * BrickSize) + ((z % BrickSize) * BrickSize) + (x % BrickSize);
+		return (brick * brickCount) + local;
+	}
+
+	// A step within the brick is a fixed stride, a step into the next brick moves back across this one's local coordinate
+	static constexpr uint64_t Neighbour(uint64_t index, int x, int y, int z, int face)
+	{
+		const int64_t    localStrides[3] = {1, BrickSize * BrickSize, BrickSize};
+		const int64_t    brickStrides[3] = {brickCount, bricksX * bricksZ * brickCount, bricksX * brickCount};
+		const int        position[3]     = {x, y, z};
+		const LayoutStep step            = layoutSteps[face];
+		const int        local           = position[step.axis] % BrickSize;
+		const bool       crosses         = local == (step.direction < 0 ? 0 : BrickSize - 1);
+		const int64_t    stride          = crosses ? brickStrides[step.axis] - ((BrickSize - 1) * localStrides[step.axis]) : localStrides[step.axis];
+		return index + (step.direction * stride);
+	}
+
+	template<typename Function>
+	static void ForEach(Function &&function)
+	{
+		uint64_t index = 0;
+		for (int bY = 0; bY < Height; bY += BrickSize) {
+			for (int bZ = 0; bZ < Depth; bZ += BrickSize) {
+				for (int bX = 0; bX < Width; bX += BrickSize) {
+					for (int y = bY; y < bY + BrickSize; y++) {
+						for (int z = bZ; z < bZ + BrickSize; z++) {
+							for (int x = bX; x < bX + BrickSize; x++) {
+								function(x, y, z, index++);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+template<int Width, int Height, int Depth>
+using Brick4Layout = BrickedLayout<4, Width, Height, Depth>;
+
+template<int Width, int Height, int Depth>
+using Brick8Layout = BrickedLayout<8, Width, Height, Depth>;
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "Server.hpp"
+#include "World.hpp"
+#include "Importer.hpp"
+#include "JobSystem.hpp"
+#include "AsyncIo.hpp"
+#include "Log.hpp"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+// Headless world server that owns generation and saving and streams the world to clients on localhost, needs neither SDL nor OpenGL
+// --port <port> listens on another port, --save <file> loads the world from the file if it exists, saves it every minute and again on exit
+// --import <file> builds the terrain from a .r16 or .png heightmap or a .vol volume, --import-scale <scale> sets voxels per heightmap unit
+// --seed <seed> picks the generator's terrain, --bake <file> restores chunks that VoxelBaker generated and lit ahead of time
+
+static std::atomic<bool> running{true};
+
+static void RequestStop(int)
+{
+	running = false;
+}
+
+int main(int argc, char **argv)
+{
+	Log::Initialize();
+
+	uint16_t    port           = ServerProtocol::defaultPort;
+	const char *saveFileName   = nullptr;
+	const char *importFileName = nullptr;
+	const char *bakeFileName   = nullptr;
+	float       importScale    = Importer::defaultHeightScale;
+	uint32_t    seed           = 0;
+	int i = 1;
+	try {
+		for (; i < argc; i++) {
+			const std::string argument = argv[i];
+			if (argument == "--port" && i + 1 < argc)              port           = static_cast<uint16_t>(std::stoi(argv[++i]));
+			else if (argument == "--save" && i + 1 < argc)         saveFileName   = argv[++i];
+			else if (argument == "--import" && i + 1 < argc)       importFileName = argv[++i];
+			else if (argument == "--import-scale" && i + 1 < argc) importScale    = std::stof(argv[++i]);
+			else if (argument == "--bake" && i + 1 < argc)         bakeFileName   = argv[++i];
+			else if (argument == "--seed" && i + 1 < argc)         seed           = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else Log::Error("VoxelServer::main: Unknown argument " + argument);
+		}
+	}
+	catch (const std::exception &exception) {
+		Log::Error("VoxelServer::main: Invalid value " + std::string(argv[i]) + " - " + exception.what());
+		Log::Error("VoxelServer::main: Usage: VoxelServer [--port <port>] [--save <file>] [--import <file>] [--import-scale <scale>] [--seed <seed>] [--bake <file>]");
+		Log::Cleanup();
+		return 1;
+	}
+
+	const float loadDistance   = 256.0f; // Also the largest radius a client can subscribe to
+	const float updateInterval = 1.0f / 20.0f;
+
+	JobSystem::StartThreads();
+	AsyncIo::Start();
+	World *world = new World(loadDistance, 0.0f, false);
+	world->SetSeed(seed);
+	if (saveFileName && std::filesystem::exists(saveFileName)) world->Load(saveFileName);
+	if (bakeFileName) world->LoadBake(bakeFileName);
+	std::shared_ptr<Importer> importer;
+	if (importFileName) {
+		importer = std::make_shared<Importer>(importFileName, importScale);
+		if (importer->IsOpen()) world->SetChunkSource(importer);
+	}
+	Server *server = new Server(*world, port, loadDistance);
+	if (!server->IsListening()) running = false;
+	world->Start();
+	std::signal(SIGINT,  RequestStop);
+	std::signal(SIGTERM, RequestStop);
+
+	const auto interval     = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(updateInterval));
+	auto       nextUpdate   = std::chrono::steady_clock::now();
+	auto       autosaveTime = nextUpdate;
+	auto       reportTime   = nextUpdate;
+	uint64_t   reportBytes  = 0;
+	while (running) {
+		server->Update();
+		world->Advance(updateInterval);
+
+		const auto currentTime = std::chrono::steady_clock::now();
+		if (saveFileName && currentTime - autosaveTime >= std::chrono::minutes(1)) {
+			world->Save(saveFileName);
+			autosaveTime = currentTime;
+		}
+		if (currentTime - reportTime >= std::chrono::seconds(10)) {
+			const double seconds = std::chrono::duration<double>(currentTime - reportTime).count();
+			Log::Info("Server: Status", {{"clients", server->GetClientCount()}, {"kilobytesPerSecond", (server->GetBytesSent() - reportBytes) / 1024.0 / seconds}, {"readQueueDepth", AsyncIo::GetQueueDepth()}});
+			reportTime  = currentTime;
+			reportBytes = server->GetBytesSent();
+		}
+
+		// Updates that run late are not made up for, the next one is simply sooner
+		nextUpdate = std::max(nextUpdate + interval, currentTime);
+		std::this_thread::sleep_until(nextUpdate);
+	}
+
+	if (saveFileName) {
+		JobSystem::WaitForIdle(); // An autosave that is still being written would cause this save to be skipped
+		world->Save(saveFileName);
+		world->WaitForUpdate();
+	}
+	world->Stop();
+	AsyncIo::Stop();
+	if (saveFileName || bakeFileName || importFileName) AsyncIo::LogReport();
+	JobSystem::WaitForIdle();
+	delete server;
+	JobSystem::StopThreads();
+	delete world;
+	if (importer) importer->LogReport();
+
+	Log::Cleanup();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "VoxelShape.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <utility>
+
+VoxelShape VoxelShape::Box(const glm::ivec3 &min, const glm::ivec3 &max)
+{
+	VoxelShape shape;
+	shape.type = Type::Box;
+	shape.min  = min;
+	shape.max  = glm::max(min, max);
+	return shape;
+}
+
+VoxelShape VoxelShape::Sphere(const glm::vec3 &center, float radius)
+{
+	VoxelShape shape;
+	shape.type   = Type::Sphere;
+	shape.from   = center;
+	shape.to     = center;
+	shape.radius = radius;
+	shape.min    = glm::ivec3(glm::floor(center - radius));
+	shape.max    = glm::ivec3(glm::floor(center + radius)) + 1;
+	return shape;
+}
+
+VoxelShape VoxelShape::Line(const glm::vec3 &from, const glm::vec3 &to, float radius)
+{
+	VoxelShape shape;
+	shape.type   = Type::Line;
+	shape.from   = from;
+	shape.to     = to;
+	shape.radius = radius;
+	shape.min    = glm::ivec3(glm::floor(glm::min(from, to) - radius));
+	shape.max    = glm::ivec3(glm::floor(glm::max(from, to) + radius)) + 1;
+	return shape;
+}
+
+VoxelShape VoxelShape::List(std::vector<glm::ivec3> positions)
+{
+	VoxelShape shape;
+	shape.type = Type::List;
+	if (!positions.empty()) {
+		shape.min = positions[0];
+		shape.max = positions[0];
+		for (const glm::ivec3 &position : positions) {
+			shape.min = glm::min(shape.min, position);
+			shape.max = glm::max(shape.max, position);
+		}
+		shape.max += 1;
+	}
+	shape.positions = std::move(positions);
+	return shape;
+}
+
+bool VoxelShape::Contains(const glm::ivec3 &position) const
+{
+	if (glm::any(glm::lessThan(position, min)) || glm::any(glm::greaterThanEqual(position, max))) return false;
+
+	// Spheres are lines of zero length
+	const glm::vec3 center  = glm::vec3(position) + 0.5f;
+	const glm::vec3 segment = to - from;
+	const float     length  = glm::dot(segment, segment);
+	switch (type) {
+		case Type::Box:
+			return true;
+		case Type::Sphere:
+		case Type::Line: {
+			const float t = length > 0.0f ? glm::clamp(glm::dot(center - from, segment) / length, 0.0f, 1.0f) : 0.0f;
+			const glm::vec3 offset = center - (from + (segment * t));
+			return glm::dot(offset, offset) <= radius * radius;
+		}
+		case Type::List:
+			return std::find(positions.begin(), positions.end(), position) != positions.end();
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+#include <cstdint>
+#include <vector>
+
+// A set of voxels in world coordinates used by batched edits and region queries, a voxel belongs to a shape when its centre does
+class VoxelShape
+{
+public:
+	static VoxelShape Box(const glm::ivec3 &min, const glm::ivec3 &max); // Max is exclusive
+	static VoxelShape Sphere(const glm::vec3 &center, float radius);
+	static VoxelShape Line(const glm::vec3 &from, const glm::vec3 &to, float radius = 0.87f); // Every voxel within radius of the segment, the default covers every voxel it passes through
+	static VoxelShape List(std::vector<glm::ivec3> positions);
+
+	bool Contains(const glm::ivec3 &position) const;
+
+	// Calls function(position) for every voxel of the shape inside the region, max is exclusive
+	template<typename Function>
+	void ForEach(const glm::ivec3 &regionMin, const glm::ivec3 &regionMax, Function &&function) const
+	{
+		if (type == Type::List) {
+			for (const glm::ivec3 &position : positions) {
+				if (glm::all(glm::greaterThanEqual(position, regionMin)) && glm::all(glm::lessThan(position, regionMax))) function(position);
+			}
+			return;
+		}
+
+		const glm::ivec3 from = glm::max(min, regionMin);
+		const glm::ivec3 to   = glm::min(max, regionMax);
+		for (int y = from.y; y < to.y; y++) {
+			for (int z = from.z; z < to.z; z++) {
+				for (int x = from.x; x < to.x; x++) {
+					const glm::ivec3 position(x, y, z);
+					if (type == Type::Box || Contains(position)) function(position);
+				}
+			}
+		}
+	}
+
+	bool IsList() const { return type == Type::List; }
+	const std::vector<glm::ivec3> &GetPositions() const { return positions; }
+
+	// Bounds of every voxel in the shape, max is exclusive
+	const glm::ivec3 &GetMin() const { return min; }
+	const glm::ivec3 &GetMax() const { return max; }
+private:
+	enum struct Type : uint8_t
+	{
+		Box,
+		Sphere,
+		Line,
+		List
+	};
+
+	Type                    type   = Type::Box;
+	glm::ivec3              min    = {0, 0, 0};
+	glm::ivec3              max    = {0, 0, 0};
+	glm::vec3               from   = {0.0f, 0.0f, 0.0f};
+	glm::vec3               to     = {0.0f, 0.0f, 0.0f};
+	float                   radius = 0.0f;
+	std::vector<glm::ivec3> positions;
+};
\ No newline at end of file
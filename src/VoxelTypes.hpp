@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+// Values stored in world chunks, everything but air is solid and opaque
+const uint8_t airVoxel    = 0;
+const uint8_t stoneVoxel  = 1;
+const uint8_t lampVoxel   = 2;  // Emits block light
+const uint8_t sandVoxel   = 3;  // Falls
+const uint8_t waterVoxel  = 16; // Flows, holds waterVoxel + level - 1 for levels 1 to waterLevels
+const int     waterLevels = 8;
+
+inline bool IsWater(uint8_t voxel)
+{
+	return voxel >= waterVoxel && voxel < waterVoxel + waterLevels;
+}
\ No newline at end of file
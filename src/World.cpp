@@ -0,0 +1,835 @@
+#include "World.hpp"
+#include "Lighting.hpp"
+#include "BlockUpdates.hpp"
+#include "SaveFile.hpp"
+#include "BakeFile.hpp"
+#include "AsyncIo.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "MemoryManager.hpp"
+#include "Log.hpp"
+#include "Pool.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <optional>
+#include <limits>
+
+// Floor division, so negative world positions map to the chunk below rather than towards zero
+static int ChunkCoordinate(int position, int size)
+{
+	return (position >= 0 ? position : position - size + 1) / size;
+}
+
+// Saved chunks share the saved voxels instead of generating them, the first edit to a section copies it. A chunk source replaces the noise,
+// with the bytes of the chunk's tile when they were read
+template<typename ChunkType>
+void GenerateChunk(std::shared_ptr<ChunkType> chunk, std::shared_ptr<Lighting> lighting, std::shared_ptr<ChunkSource> source, std::optional<typename ChunkType::Snapshot> saved, uint32_t seed, int x, int y, int z, const uint8_t *tile = nullptr)
+{
+	PROFILE_ZONE("Generate chunk");
+	if (!chunk->TransitionState(ChunkState::Queued, ChunkState::Generating)) return; // Evicted before the job ran
+	auto guard = chunk->LockVoxels();
+	if (saved) chunk->RestoreSnapshot(*saved);
+	else if (source) source->Fill(x, z, tile, *chunk);
+	else World::GenerateTerrain(seed, x, z, *chunk);
+	guard.unlock();
+	PROFILE_COUNTER(ChunksGenerated, 1);
+	chunk->TransitionState(ChunkState::Generating, ChunkState::Meshing);
+	lighting->AddChunk(chunk, x, z); // Meshed once it is lit
+}
+
+// Where an octave of the noise is sampled from, seed 0 samples it where worlds from before seeds did
+static glm::vec2 GetSeedOffset(uint32_t seed, uint32_t octave)
+{
+	if (seed == 0) return glm::vec2(0.0f);
+	uint32_t hash = (seed * 0x9E3779B9u) ^ (octave * 0x85EBCA6Bu);
+	hash ^= hash >> 16;
+	hash *= 0x7FEB352Du;
+	hash ^= hash >> 15;
+	hash *= 0x846CA68Bu;
+	hash ^= hash >> 16;
+	return glm::vec2(hash & 0x3FF, (hash >> 10) & 0x3FF); // Small enough to keep the float precision of the sample positions
+}
+
+// The noise is sampled once per column into a buffer on the stack, then the voxels are written in storage order
+void World::GenerateTerrain(uint32_t seed, int x, int z, WorldChunk &chunk)
+{
+	const glm::vec2 broad  = GetSeedOffset(seed, 0);
+	const glm::vec2 detail = GetSeedOffset(seed, 1);
+	std::array<uint8_t, chunkWidth * chunkDepth> tops;
+	for (int iZ = 0; iZ < chunkDepth; iZ++) {
+		for (int iX = 0; iX < chunkWidth; iX++) {
+			const int aX = iX + (x * chunkWidth);
+			const int aZ = iZ + (z * chunkDepth);
+			float noise = (24.0f) * glm::simplex(glm::vec2((float)aX / (float)(512), (float)aZ / (float)(512)) + broad);
+			noise += (12.0f) * glm::simplex(glm::vec2((float)aX / (float)(64), (float)aZ / (float)(64)) + detail);
+			noise += 12.0f;
+			tops[iZ * chunkWidth + iX] = static_cast<uint8_t>(glm::clamp(std::floor(noise + 2), 0.0f, chunkHeight - 1.0f));
+		}
+	}
+	WorldChunk::VoxelLayout::ForEach([&](int iX, int iY, int iZ, uint64_t) {
+		if (iY <= tops[iZ * chunkWidth + iX]) chunk.SetVoxel(iX, iY, iZ, 1);
+	});
+}
+
+// Baked chunks already have their light and faces, they are only lit where they meet chunks that were not baked along with them
+static void RestoreBakedChunk(std::shared_ptr<WorldChunk> chunk, std::shared_ptr<Lighting> lighting, const BakeFile::DecodedChunk &baked, int x, int z)
+{
+	PROFILE_ZONE("Restore baked chunk");
+	if (!chunk->TransitionState(ChunkState::Queued, ChunkState::Generating)) return; // Evicted before the read finished
+	{
+		auto guard = chunk->LockVoxels();
+		chunk->RestoreSnapshot(baked.snapshot);
+		chunk->RestoreLight(baked.light);
+	}
+	chunk->TransitionState(ChunkState::Generating, ChunkState::Meshing);
+	chunk->PublishFaces(baked.faces, baked.faceOffsets);
+	lighting->AddChunk(chunk, x, z, true);
+}
+
+// Runs on the job system with snapshots, so the chunks can be edited while they are written
+static void WriteSave(std::shared_ptr<std::vector<SaveFile::Entry>> chunks, const std::string &fileName, std::shared_ptr<std::atomic<bool>> saving)
+{
+	PROFILE_ZONE("Write save");
+	const auto startTime = std::chrono::steady_clock::now();
+	if (SaveFile::Save(fileName.c_str(), *chunks)) {
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		Log::Info("World: Saved " + std::to_string(chunks->size()) + " chunks to " + fileName + " in " + std::to_string(milliseconds) + "ms");
+	}
+	chunks->clear(); // Sections the chunks no longer share stop being copied on write
+	saving->store(false, std::memory_order_release);
+}
+
+void World::ApplyChunkEdits(std::shared_ptr<WorldChunk> chunk, std::shared_ptr<Lighting> lighting, std::shared_ptr<BlockUpdates> blockUpdates, const ChangeListener &listener, const glm::ivec3 &origin, const std::vector<ChunkEdit> &edits)
+{
+	PROFILE_ZONE("Apply edits");
+	std::vector<glm::ivec3> changes;
+	auto guard = chunk->LockVoxels();
+	const glm::ivec3 end = origin + glm::ivec3(chunkWidth, chunkHeight, chunkDepth);
+	for (const ChunkEdit &edit : edits) {
+		edit.shape->ForEach(origin, end, [&](const glm::ivec3 &position) {
+			const glm::ivec3 local = position - origin;
+			if (chunk->GetVoxel(local.x, local.y, local.z) == edit.voxel) return;
+			chunk->SetVoxel(local.x, local.y, local.z, edit.voxel);
+			changes.push_back(local);
+		});
+	}
+	guard.unlock();
+
+	// The new geometry is shown straight away, the light catches up with another remesh
+	if (!changes.empty()) {
+		blockUpdates->VoxelsChanged(origin.x / chunkWidth, origin.z / chunkDepth, changes);
+		if (listener) listener(origin.x / chunkWidth, origin.z / chunkDepth, changes);
+		lighting->VoxelsChanged(origin.x / chunkWidth, origin.z / chunkDepth, std::move(changes));
+	}
+	if (!edits.empty()) PROFILE_COUNTER(ChunksEdited, 1);
+	chunk->UpdateVertices();
+}
+
+World::World(float loadDistance, float renderDistance, bool meshing) : loadDistance(loadDistance), renderDistance(renderDistance), meshing(meshing), lighting(std::make_shared<Lighting>()), blockUpdates(std::make_shared<BlockUpdates>()), saving(std::make_shared<std::atomic<bool>>(false)), requestedLoadDistance(loadDistance), requestedRenderDistance(renderDistance)
+{
+}
+
+World::~World()
+{
+	Stop();
+	for (RenderList &renderList : renderLists) renderList.clear();
+	std::lock_guard<std::shared_mutex> guard(chunksLock);
+	chunks.clear();
+}
+
+void World::Start()
+{
+	stop   = false;
+	thread = std::thread(&World::ThreadLoop, this);
+}
+
+void World::Stop()
+{
+	if (!thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		stop = true;
+	}
+	inputChanged.notify_one();
+	updateFinished.notify_all();
+	thread.join();
+}
+
+bool World::Load(const char *fileName)
+{
+	auto file = std::make_shared<AsyncIo::File>(fileName);
+	if (!file->IsOpen()) return false;
+	std::vector<std::pair<glm::ivec2, SaveFile::Location>> locations;
+	if (SaveFile::LoadDirectory(fileName, *file, locations)) {
+		for (const auto &location : locations) savedChunks[GetChunkIndex(location.first.x, location.first.y)] = {std::nullopt, location.second.offset, location.second.runCount};
+		saveFile = std::move(file);
+		Log::Info("World: Found " + std::to_string(locations.size()) + " chunks in " + fileName);
+		return true;
+	}
+
+	std::vector<SaveFile::Entry> entries;
+	if (!SaveFile::Load(fileName, entries)) return false;
+	for (SaveFile::Entry &entry : entries) savedChunks[GetChunkIndex(entry.coordinate.x, entry.coordinate.y)] = {std::move(entry.snapshot)};
+	Log::Info("World: Loaded " + std::to_string(entries.size()) + " chunks from " + fileName);
+	return true;
+}
+
+void World::SetChunkSource(std::shared_ptr<ChunkSource> source)
+{
+	this->source = std::move(source);
+}
+
+void World::SetSeed(uint32_t seed)
+{
+	this->seed = seed;
+}
+
+bool World::LoadBake(const char *fileName)
+{
+	auto file = std::make_shared<AsyncIo::File>(fileName);
+	if (!file->IsOpen()) {
+		Log::Error(std::string("World: Failed to open ") + fileName);
+		return false;
+	}
+	uint32_t bakeSeed;
+	std::vector<std::pair<glm::ivec2, BakeFile::Location>> locations;
+	if (!BakeFile::LoadDirectory(fileName, *file, bakeSeed, locations)) return false;
+	for (const auto &location : locations) bakedChunks[GetChunkIndex(location.first.x, location.first.y)] = {location.second.offset, location.second.size};
+	bakeFile = std::move(file);
+	if (bakeSeed != seed) Log::Info("World: Using seed " + std::to_string(bakeSeed) + ", which " + fileName + " was baked with");
+	seed = bakeSeed;
+	Log::Info("World: Found " + std::to_string(locations.size()) + " baked chunks in " + fileName);
+	return true;
+}
+
+void World::Save(const char *fileName)
+{
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		saveFileName = fileName;
+		inputPending = true;
+		requestedUpdate++;
+	}
+	inputChanged.notify_one();
+}
+
+void World::SetCamera(const glm::vec3 &position)
+{
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		cameraPosition = position;
+		inputPending   = true;
+		requestedUpdate++;
+	}
+	inputChanged.notify_one();
+}
+
+void World::SetViewers(const std::vector<glm::vec3> &positions)
+{
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		viewers      = positions;
+		inputPending = true;
+		requestedUpdate++;
+	}
+	inputChanged.notify_one();
+}
+
+void World::SetDistances(float loadDistance, float renderDistance)
+{
+	std::lock_guard<std::mutex> guard(inputLock);
+	requestedLoadDistance   = loadDistance;
+	requestedRenderDistance = renderDistance;
+}
+
+void World::SetMaxQueuedJobs(size_t maxQueuedJobs)
+{
+	this->maxQueuedJobs.store(maxQueuedJobs, std::memory_order_relaxed);
+}
+
+void World::SetChangeListener(ChangeListener listener)
+{
+	changeListener = std::move(listener);
+}
+
+void World::RemoveVoxel(const glm::vec3 &origin, const glm::vec3 &direction, float radius)
+{
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		edits.push_back({VoxelShape(), 0, true, origin, direction, radius});
+		inputPending = true;
+		requestedUpdate++;
+	}
+	inputChanged.notify_one();
+}
+
+void World::Advance(float seconds)
+{
+	std::lock_guard<std::mutex> guard(inputLock);
+	blockTime += seconds;
+}
+
+void World::Edit(const VoxelShape &shape, uint8_t voxel)
+{
+	{
+		std::lock_guard<std::mutex> guard(inputLock);
+		edits.push_back({shape, voxel, false, {}, {}, 0.0f});
+		inputPending = true;
+		requestedUpdate++;
+	}
+	inputChanged.notify_one();
+}
+
+void World::WaitForUpdate()
+{
+	std::unique_lock<std::mutex> guard(inputLock);
+	updateFinished.wait(guard, [this]() { return completedUpdate >= requestedUpdate || stop; });
+}
+
+uint64_t World::CountSolid(const VoxelShape &shape)
+{
+	uint64_t count = 0;
+	VisitSolid(shape, [&count](const glm::ivec3 &, uint8_t) { count++; });
+	return count;
+}
+
+void World::ForEachSolid(const VoxelShape &shape, const std::function<void(const glm::ivec3 &position, uint8_t voxel)> &function)
+{
+	VisitSolid(shape, function);
+}
+
+template<typename Function>
+void World::VisitSolid(const VoxelShape &shape, Function &&function)
+{
+	PROFILE_ZONE("Region query");
+	const glm::ivec3 &min = shape.GetMin();
+	const glm::ivec3 &max = shape.GetMax();
+	if (max.y <= 0 || min.y >= chunkHeight) return;
+
+	std::shared_lock<std::shared_mutex> guard(chunksLock);
+	for (int iZ = ChunkCoordinate(min.z, chunkDepth); iZ <= ChunkCoordinate(max.z - 1, chunkDepth); iZ++) {
+		for (int iX = ChunkCoordinate(min.x, chunkWidth); iX <= ChunkCoordinate(max.x - 1, chunkWidth); iX++) {
+			const auto it = chunks.find(GetChunkIndex(iX, iZ));
+			if (it == chunks.end()) continue;
+			const WorldChunk &chunk = *it->second;
+			const auto voxelGuard = chunk.LockVoxelsShared();
+			const ChunkState state = chunk.GetState();
+			if (state == ChunkState::Queued || state == ChunkState::Generating || state == ChunkState::Evicting) continue;
+
+			const glm::ivec3 origin(iX * chunkWidth, 0, iZ * chunkDepth);
+			shape.ForEach(origin, origin + glm::ivec3(chunkWidth, chunkHeight, chunkDepth), [&](const glm::ivec3 &position) {
+				const uint8_t voxel = chunk.GetVoxel(position.x - origin.x, position.y, position.z - origin.z);
+				if (voxel != 0) function(position, voxel);
+			});
+		}
+	}
+}
+
+bool World::GetSnapshot(int x, int z, WorldChunk::Snapshot &snapshot)
+{
+	std::shared_lock<std::shared_mutex> guard(chunksLock);
+	const auto it = chunks.find(GetChunkIndex(x, z));
+	if (it == chunks.end()) return false;
+	const auto voxelGuard = it->second->LockVoxelsShared();
+	const ChunkState state = it->second->GetState();
+	if (state == ChunkState::Queued || state == ChunkState::Generating || state == ChunkState::Evicting) return false;
+	snapshot = it->second->TakeSnapshot();
+	return true;
+}
+
+bool World::TryGetSnapshot(int x, int z, WorldChunk::Snapshot &snapshot, bool &busy)
+{
+	busy = false;
+	std::shared_lock<std::shared_mutex> guard(chunksLock, std::try_to_lock);
+	if (!guard.owns_lock()) {
+		busy = true;
+		return false;
+	}
+	const auto it = chunks.find(GetChunkIndex(x, z));
+	if (it == chunks.end()) return false;
+	const auto voxelGuard = it->second->TryLockVoxelsShared();
+	if (!voxelGuard.owns_lock()) {
+		busy = true;
+		return false;
+	}
+	const ChunkState state = it->second->GetState();
+	if (state == ChunkState::Queued || state == ChunkState::Generating || state == ChunkState::Evicting) return false;
+	snapshot = it->second->TakeSnapshot();
+	return true;
+}
+
+const RenderList &World::AcquireRenderList()
+{
+	if (middleIndex.load(std::memory_order_relaxed) & freshList) {
+		readIndex = middleIndex.exchange(readIndex, std::memory_order_acq_rel) & ~freshList;
+	}
+	return renderLists[readIndex];
+}
+
+bool World::IsSettled(ChunkState state)
+{
+	return state == ChunkState::ReadyToUpload || state == ChunkState::Resident;
+}
+
+// Only the world thread starts remeshes and evictions, but the render thread can move a chunk from ReadyToUpload to Resident at any time
+bool World::BeginRemesh(WorldChunk &chunk)
+{
+	return chunk.TransitionState(ChunkState::Resident, ChunkState::Meshing) ||
+	       chunk.TransitionState(ChunkState::ReadyToUpload, ChunkState::Meshing) ||
+	       chunk.TransitionState(ChunkState::Resident, ChunkState::Meshing);
+}
+
+bool World::BeginEviction(WorldChunk &chunk)
+{
+	return chunk.TransitionState(ChunkState::Queued, ChunkState::Evicting) ||
+	       chunk.TransitionState(ChunkState::Resident, ChunkState::Evicting) ||
+	       chunk.TransitionState(ChunkState::ReadyToUpload, ChunkState::Evicting) ||
+	       chunk.TransitionState(ChunkState::Resident, ChunkState::Evicting);
+}
+
+float World::GetDistance(const std::vector<glm::vec3> &centers, int x, int z)
+{
+	float distance = std::numeric_limits<float>::max();
+	for (const glm::vec3 &center : centers) {
+		distance = std::min(distance, glm::length(glm::vec2(x * chunkWidth, z * chunkDepth) - glm::vec2(center.x, center.z)));
+	}
+	return distance;
+}
+
+uint64_t World::GetChunkIndex(int x, int z)
+{
+	uint64_t index;
+	*(reinterpret_cast<int*>(&index) + 0) = x;
+	*(reinterpret_cast<int*>(&index) + 1) = z;
+	return index;
+}
+
+glm::ivec3 World::GetChunkOrigin(uint64_t index)
+{
+	const int x = *(reinterpret_cast<const int*>(&index) + 0);
+	const int z = *(reinterpret_cast<const int*>(&index) + 1);
+	return glm::ivec3(x * chunkWidth, 0, z * chunkDepth);
+}
+
+// Runs at most once per camera update, so the world thread idles along with the render thread
+void World::ThreadLoop()
+{
+	PROFILE_THREAD_NAME("World");
+	std::vector<PendingEdit> pendingEdits;
+	std::vector<glm::vec3>   centers;        // Kept across updates with their capacity
+	std::vector<glm::ivec2>  relitChunks;
+	while (true) {
+		glm::vec3 position;
+		uint64_t  update;
+		int       blockTicks;
+		std::string pendingSave;
+		{
+			std::unique_lock<std::mutex> guard(inputLock);
+			inputChanged.wait(guard, [this]() { return inputPending || stop; });
+			if (stop) break;
+			position       = cameraPosition;
+			if (viewers.empty()) centers.assign(1, cameraPosition);
+			else centers.assign(viewers.begin(), viewers.end());
+			loadDistance   = requestedLoadDistance;
+			renderDistance = requestedRenderDistance;
+			update         = requestedUpdate;
+			inputPending   = false;
+			pendingEdits.swap(edits);
+			pendingSave.swap(saveFileName);
+			blockTicks = static_cast<int>(blockTime / BlockUpdates::tickInterval);
+			blockTime -= blockTicks * BlockUpdates::tickInterval;
+			blockTicks  = std::min(blockTicks, maxBlockTicks);
+		}
+
+		tick++;
+		for (const PendingEdit &edit : pendingEdits) QueueEdit(edit);
+		pendingEdits.clear();
+		for (int i = 0; i < blockTicks; i++) TickBlocks();
+		lighting->TakeChangedChunks(relitChunks);
+		for (const glm::ivec2 &coordinate : relitChunks) chunkEdits[GetChunkIndex(coordinate.x, coordinate.y)];
+		DispatchEdits();
+		if (!pendingSave.empty()) StartSave(pendingSave);
+
+		UnloadChunks(centers);
+		EvictOverBudget(centers);
+		LoadChunks(centers);
+		PublishRenderList(position);
+
+		{
+			std::lock_guard<std::mutex> guard(inputLock);
+			completedUpdate = update;
+		}
+		updateFinished.notify_all();
+	}
+}
+
+// Splits an edit into the chunks it touches, picks are resolved against the voxels as they are now
+void World::QueueEdit(const PendingEdit &edit)
+{
+	PROFILE_ZONE("Queue edit");
+	VoxelShape shape = edit.shape;
+	if (edit.isPick) {
+		bool hit = false;
+		for (float i = 0.0f; i < 256.0f && !hit; i += 0.01f) {
+			const glm::ivec3 pos = glm::floor(edit.origin + (edit.direction * i));
+			const int chunkX = ChunkCoordinate(pos.x, chunkWidth);
+			const int chunkZ = ChunkCoordinate(pos.z, chunkDepth);
+
+			// Chunks that are still being generated are not visible yet, so the ray passes through them
+			const auto it = chunks.find(GetChunkIndex(chunkX, chunkZ));
+			if (it != chunks.end() && IsSettled(it->second->GetState())) {
+				if (it->second->TestPos(pos.x - (chunkX * chunkWidth), pos.y, pos.z - (chunkZ * chunkDepth))) {
+					shape = edit.radius > 0.0f ? VoxelShape::Sphere(glm::vec3(pos) + 0.5f, edit.radius) : VoxelShape::List({pos});
+					hit   = true;
+				}
+			}
+		}
+		if (!hit) return;
+	}
+
+	const glm::ivec3 &min = shape.GetMin();
+	const glm::ivec3 &max = shape.GetMax();
+	if (max.y <= 0 || min.y >= chunkHeight) return;
+
+	// Lists are split up front so each chunk only walks its own positions
+	if (shape.IsList()) {
+		std::map<uint64_t, std::vector<glm::ivec3>> split;
+		for (const glm::ivec3 &position : shape.GetPositions()) {
+			split[GetChunkIndex(ChunkCoordinate(position.x, chunkWidth), ChunkCoordinate(position.z, chunkDepth))].push_back(position);
+		}
+		for (auto &it : split) {
+			if (chunks.count(it.first) == 0) continue;
+			chunkEdits[it.first].push_back({std::make_shared<const VoxelShape>(VoxelShape::List(std::move(it.second))), edit.voxel});
+		}
+		return;
+	}
+
+	const auto sharedShape = std::make_shared<const VoxelShape>(std::move(shape));
+	for (int iZ = ChunkCoordinate(min.z, chunkDepth); iZ <= ChunkCoordinate(max.z - 1, chunkDepth); iZ++) {
+		for (int iX = ChunkCoordinate(min.x, chunkWidth); iX <= ChunkCoordinate(max.x - 1, chunkWidth); iX++) {
+			const uint64_t index = GetChunkIndex(iX, iZ);
+			if (chunks.count(index) != 0) chunkEdits[index].push_back({sharedShape, edit.voxel});
+		}
+	}
+}
+
+// Every chunk with queued edits that is not generating or meshing gets one job that applies all of them and remeshes once
+void World::DispatchEdits()
+{
+	for (auto it = chunkEdits.begin(); it != chunkEdits.end();) {
+		const auto chunk = chunks.find(it->first);
+		if (chunk == chunks.end()) {
+			it = chunkEdits.erase(it); // Unloaded before its edits could be applied
+			continue;
+		}
+		if (!BeginRemesh(*chunk->second)) {
+			it++; // Tried again next update
+			continue;
+		}
+		if (!it->second.empty()) chunk->second->modified = true;
+		JobSystem::AddJob(std::bind(ApplyChunkEdits, chunk->second, lighting, blockUpdates, changeListener, GetChunkOrigin(it->first), std::move(it->second)));
+		it = chunkEdits.erase(it);
+	}
+}
+
+// Changed chunks are remeshed and relit like edited ones, and kept loaded since they no longer match the generator
+void World::TickBlocks()
+{
+	const auto changes = blockUpdates->Tick([this](int x, int z) {
+		const auto it = chunks.find(GetChunkIndex(x, z));
+		return it != chunks.end() ? it->second : nullptr;
+	});
+	for (const BlockUpdates::ChunkChanges &chunk : changes) {
+		const uint64_t index = GetChunkIndex(chunk.coordinate.x, chunk.coordinate.y);
+		chunks[index]->modified = true;
+		chunkEdits[index];
+		lighting->VoxelsChanged(chunk.coordinate.x, chunk.coordinate.y, chunk.positions);
+		if (changeListener) changeListener(chunk.coordinate.x, chunk.coordinate.y, chunk.positions);
+	}
+}
+
+// Only copies references to the voxel sections, encoding and writing them is left to a job
+void World::StartSave(const std::string &fileName)
+{
+	PROFILE_ZONE("Snapshot chunks");
+	if (saving->exchange(true, std::memory_order_acquire)) {
+		Log::Warning("World: Still writing the previous save, " + fileName + " was not saved");
+		return;
+	}
+	auto entries = std::make_shared<std::vector<SaveFile::Entry>>();
+	for (const auto &it : chunks) {
+		if (!it.second->modified) continue;
+
+		// Saved chunks that are still being restored are written from the save they came from
+		const ChunkState state = it.second->GetState();
+		if (state == ChunkState::Queued || state == ChunkState::Generating) continue;
+		const glm::ivec3 origin = GetChunkOrigin(it.first);
+		auto guard = it.second->LockVoxelsShared();
+		entries->push_back({glm::ivec2(origin.x / chunkWidth, origin.z / chunkDepth), it.second->TakeSnapshot()});
+		guard.unlock();
+		savedChunks.erase(it.first);
+	}
+	for (const auto &it : savedChunks) {
+		const glm::ivec3 origin     = GetChunkOrigin(it.first);
+		const glm::ivec2 coordinate = glm::ivec2(origin.x / chunkWidth, origin.z / chunkDepth);
+		if (it.second.snapshot) entries->push_back({coordinate, *it.second.snapshot});
+		else entries->push_back({coordinate, {}, saveFile, {it.second.offset, it.second.runCount}});
+	}
+	JobSystem::AddJob(std::bind(WriteSave, entries, fileName, saving));
+}
+
+void World::UnloadChunks(const std::vector<glm::vec3> &centers)
+{
+	PROFILE_ZONE("Unload chunks");
+	for (auto it = chunks.cbegin(); it != chunks.cend();) {
+		int x = *(reinterpret_cast<const int*>(&it->first) + 0);
+		int z = *(reinterpret_cast<const int*>(&it->first) + 1);
+		if (GetDistance(centers, x, z) > loadDistance && !it->second->modified) {
+			// Render lists may still hold the chunk, it is freed once the last of them lets go
+			if (BeginEviction(*it->second)) {
+				std::lock_guard<std::shared_mutex> guard(chunksLock);
+				chunks.erase(it++);
+			}
+			else it++;
+		}
+		else it++;
+	}
+}
+
+// Below nine tenths of the budget, so a limit that was just lowered is not raised again straight away
+static bool HasHeadroom(MemoryManager::Category category)
+{
+	return MemoryManager::GetUsage(category) <= MemoryManager::GetBudget(category) / 10 * 9;
+}
+
+// Chunks that were not in the last render list are evicted least recently visible first, modified chunks and chunks that hold nothing over
+// budget are never evicted. Evicted chunks are still inside the load distance, so loading stops short of the nearest of them until there is
+// headroom again. Only chunks that were drawn hold GPU buffers, so the GPU budget lowers the render distance, and the buffers of chunks
+// that fall out of it are evicted along with them
+void World::EvictOverBudget(const std::vector<glm::vec3> &centers)
+{
+	uint64_t voxelExcess = MemoryManager::GetExcess(MemoryManager::Category::Voxels);
+	uint64_t meshExcess  = MemoryManager::GetExcess(MemoryManager::Category::Meshes);
+	uint64_t gpuExcess   = MemoryManager::GetExcess(MemoryManager::Category::GpuBuffers);
+	if (voxelExcess == 0 && meshExcess == 0 && gpuExcess == 0) {
+		RaiseBudgetLimits();
+		return;
+	}
+
+	PROFILE_ZONE("Evict chunks");
+	struct Candidate
+	{
+		uint64_t lastVisible;
+		float    distance;
+		uint64_t index;
+	};
+
+	static thread_local std::vector<Candidate> candidates;
+	candidates.clear();
+	for (const auto &it : chunks) {
+		if (it.second->modified || it.second->lastVisible + 1 >= tick) continue;
+		const int x = *(reinterpret_cast<const int*>(&it.first) + 0);
+		const int z = *(reinterpret_cast<const int*>(&it.first) + 1);
+		candidates.push_back({it.second->lastVisible, GetDistance(centers, x, z), it.first});
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+		return a.lastVisible != b.lastVisible ? a.lastVisible < b.lastVisible : a.distance > b.distance;
+	});
+
+	// Usage only drops once render lists release the chunks, so the expected savings are subtracted up front
+	const auto subtract = [](uint64_t &excess, uint64_t bytes) { excess = excess > bytes ? excess - bytes : 0; };
+	float nearestEvicted = std::numeric_limits<float>::infinity();
+	bool  gpuEvicted     = false;
+	for (const Candidate &candidate : candidates) {
+		if (voxelExcess == 0 && meshExcess == 0 && gpuExcess == 0) break;
+		const auto it = chunks.find(candidate.index);
+		const uint64_t meshBytes = it->second->GetMeshBytes();
+		const uint64_t gpuBytes  = it->second->GetGpuBytes();
+		if (voxelExcess == 0 && (meshExcess == 0 || meshBytes == 0) && (gpuExcess == 0 || gpuBytes == 0)) continue;
+		if (!BeginEviction(*it->second)) continue;
+		subtract(voxelExcess, WorldChunk::voxelBytes);
+		subtract(meshExcess,  meshBytes);
+		subtract(gpuExcess,   gpuBytes);
+		nearestEvicted = std::min(nearestEvicted, candidate.distance);
+		gpuEvicted     = gpuEvicted || gpuBytes > 0;
+		std::lock_guard<std::shared_mutex> guard(chunksLock);
+		chunks.erase(it);
+	}
+	loadLimit = std::min(loadLimit, nearestEvicted);
+
+	// Buffers are only freed a frame or two after their chunks leave the render list, so the distance waits for them before dropping again
+	if (gpuExcess > 0 && !gpuEvicted && tick >= limitTick + limitInterval) {
+		const float distance = std::max(std::min(renderDistance, renderLimit) - chunkWidth, static_cast<float>(chunkWidth));
+		if (distance < renderLimit) Log::Info("World: GPU memory budget reached, lowered the render distance", {{"renderDistance", distance}});
+		renderLimit = distance;
+		limitTick   = tick;
+	}
+}
+
+// Limits are raised a chunk at a time, and dropped once they reach the distances they were lowered from
+void World::RaiseBudgetLimits()
+{
+	if (tick < limitTick + limitInterval) return;
+	if (loadLimit != std::numeric_limits<float>::infinity() && HasHeadroom(MemoryManager::Category::Voxels) && HasHeadroom(MemoryManager::Category::Meshes)) {
+		loadLimit += chunkWidth;
+		if (loadLimit > loadDistance) loadLimit = std::numeric_limits<float>::infinity();
+		limitTick = tick;
+	}
+	if (renderLimit != std::numeric_limits<float>::infinity() && HasHeadroom(MemoryManager::Category::GpuBuffers)) {
+		renderLimit += chunkWidth;
+		if (renderLimit > renderDistance) renderLimit = std::numeric_limits<float>::infinity();
+		limitTick = tick;
+	}
+}
+
+// Nearest chunks are loaded first so a full voxel budget only ever leaves out the most distant ones, chunks at or beyond the load limit
+// are left out as well
+void World::LoadChunks(const std::vector<glm::vec3> &centers)
+{
+	PROFILE_ZONE("Load chunks");
+	struct Candidate
+	{
+		float distance;
+		int   x;
+		int   z;
+	};
+
+	static thread_local std::vector<Candidate> candidates; // Only the world thread loads, it keeps the capacity between updates
+	candidates.clear();
+	for (const glm::vec3 &position : centers) {
+		int z1 = round((position.z - loadDistance) / chunkDepth);
+		int z2 = round((position.z + loadDistance) / chunkDepth);
+		int x1 = round((position.x - loadDistance) / chunkWidth);
+		int x2 = round((position.x + loadDistance) / chunkWidth);
+		for (int iZ = z1; iZ < z2; iZ++) {
+			for (int iX = x1; iX < x2; iX++) {
+				const float distance = glm::length(glm::vec2(iX * chunkWidth, iZ * chunkDepth) - glm::vec2(position.x, position.z));
+				if (distance <= loadDistance && chunks.count(GetChunkIndex(iX, iZ)) == 0) {
+					const float nearest = GetDistance(centers, iX, iZ);
+					if (nearest < loadLimit) candidates.push_back({nearest, iX, iZ});
+				}
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+		if (a.distance != b.distance) return a.distance < b.distance;
+		return a.x != b.x ? a.x < b.x : a.z < b.z;
+	});
+	candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.x == b.x && a.z == b.z; }), candidates.end());
+
+	const size_t queueLimit = maxQueuedJobs.load(std::memory_order_relaxed);
+	size_t       queued     = queueLimit > 0 ? JobSystem::GetQueuedCount() : 0;
+	for (const Candidate &candidate : candidates) {
+		if (queueLimit > 0 && queued++ >= queueLimit) break; // The rest are the furthest away and are queued by later updates
+		if (!MemoryManager::CanAllocate(MemoryManager::Category::Voxels, WorldChunk::voxelBytes)) {
+			if (!budgetLimited) Log::Info("World: Voxel memory budget reached, distant chunks will not be loaded");
+			budgetLimited = true;
+			return;
+		}
+		const uint64_t index = GetChunkIndex(candidate.x, candidate.z);
+		const auto chunk = std::allocate_shared<WorldChunk>(Pool::Allocator<WorldChunk>());
+		chunk->meshing = meshing;
+		chunk->drawn.store(false, std::memory_order_relaxed); // Until a render list includes it
+		{
+			std::lock_guard<std::shared_mutex> guard(chunksLock);
+			chunks[index] = chunk;
+		}
+		std::optional<WorldChunk::Snapshot> saved;
+		const auto savedChunk = savedChunks.find(index);
+		if (savedChunk != savedChunks.end()) {
+			chunk->modified = true; // No longer matches the generator
+			if (!savedChunk->second.snapshot) {
+				ReadSavedChunk(chunk, savedChunk->second, candidate.x, candidate.z);
+				continue;
+			}
+			saved = savedChunk->second.snapshot;
+		}
+		else if (!source) {
+			const auto bakedChunk = bakedChunks.find(index);
+			if (bakedChunk != bakedChunks.end()) {
+				ReadBakedChunk(chunk, bakedChunk->second, candidate.x, candidate.z);
+				continue;
+			}
+		}
+		else {
+			const ChunkSource::Tile tile = source->GetTile(candidate.x, candidate.z);
+			if (tile.file) {
+				ReadSourceTile(chunk, tile, candidate.x, candidate.z);
+				continue;
+			}
+		}
+		JobSystem::AddJob(std::bind(GenerateChunk<WorldChunk>, chunk, lighting, source, std::move(saved), seed, candidate.x, 0, candidate.z, nullptr));
+	}
+	budgetLimited = false;
+}
+
+// Only the read waits on the disk, the runs are decoded and the chunk generated on the job system. Chunks that cannot be read are generated
+void World::ReadSavedChunk(std::shared_ptr<WorldChunk> chunk, const SavedChunk &saved, int x, int z)
+{
+	const uint32_t runCount = saved.runCount;
+	AsyncIo::Read(saveFile, saved.offset, static_cast<uint64_t>(runCount) * sizeof(SaveFile::Run), [chunk, lighting = lighting, source = source, seed = seed, runCount, x, z](const uint8_t *data, uint64_t) {
+		std::optional<WorldChunk::Snapshot> snapshot(std::in_place);
+		if (!data || !SaveFile::DecodeSnapshot(data, runCount, *snapshot)) {
+			Log::Error("World: Failed to read a saved chunk, it is generated instead", {{"x", x}, {"z", z}});
+			snapshot.reset();
+		}
+		GenerateChunk<WorldChunk>(chunk, lighting, source, std::move(snapshot), seed, x, 0, z);
+	});
+}
+
+// Decoded and restored on the job system like saved chunks, chunks that cannot be read are generated
+void World::ReadBakedChunk(std::shared_ptr<WorldChunk> chunk, const BakedChunk &baked, int x, int z)
+{
+	AsyncIo::Read(bakeFile, baked.offset, baked.size, [chunk, lighting = lighting, seed = seed, x, z](const uint8_t *data, uint64_t size) {
+		BakeFile::DecodedChunk decoded;
+		if (!data || !BakeFile::DecodeChunk(data, size, decoded)) {
+			Log::Error("World: Failed to read a baked chunk, it is generated instead", {{"x", x}, {"z", z}});
+			GenerateChunk<WorldChunk>(chunk, lighting, nullptr, std::nullopt, seed, x, 0, z);
+			return;
+		}
+		RestoreBakedChunk(chunk, lighting, decoded, x, z);
+	});
+}
+
+// Converted on the job system once the tile is read, so a worker never waits on the disk. The source reads a tile that failed itself
+void World::ReadSourceTile(std::shared_ptr<WorldChunk> chunk, const ChunkSource::Tile &tile, int x, int z)
+{
+	AsyncIo::ReadRows(tile.file, tile.offset, tile.rowSize, tile.stride, tile.rowCount, [chunk, lighting = lighting, source = source, seed = seed, x, z](const uint8_t *data, uint64_t) {
+		GenerateChunk<WorldChunk>(chunk, lighting, source, std::nullopt, seed, x, 0, z, data);
+	});
+}
+
+void World::PublishRenderList(const glm::vec3 &position)
+{
+	PROFILE_ZONE("Build render list");
+	RenderList &renderList = renderLists[writeIndex];
+	renderList.clear();
+	const float distance = std::min(renderDistance, renderLimit);
+
+	int z1 = round((position.z - distance) / chunkDepth);
+	int z2 = round((position.z + distance) / chunkDepth);
+	int x1 = round((position.x - distance) / chunkWidth);
+	int x2 = round((position.x + distance) / chunkWidth);
+	for (int iZ = z1; iZ < z2; iZ++) {
+		for (int iX = x1; iX < x2; iX++) {
+			if (glm::length(glm::vec2(iX * chunkWidth, iZ * chunkDepth) - glm::vec2(position.x, position.z)) <= distance) {
+				const auto it = chunks.find(GetChunkIndex(iX, iZ));
+				if (it != chunks.end()) {
+					it->second->lastVisible = tick;
+					it->second->drawn.store(true, std::memory_order_relaxed);
+					if (it->second->meshDeferred.load(std::memory_order_relaxed) && IsSettled(it->second->GetState())) chunkEdits[it->first];
+					renderList.push_back({it->second, glm::ivec3(iX * chunkWidth, 0, iZ * chunkDepth)});
+				}
+			}
+		}
+	}
+	for (const auto &it : chunks) {
+		if (it.second->lastVisible != tick) it.second->drawn.store(false, std::memory_order_relaxed);
+	}
+
+	writeIndex = middleIndex.exchange(writeIndex | freshList, std::memory_order_acq_rel) & ~freshList;
+}
\ No newline at end of file
@@ -0,0 +1,225 @@
+#pragma once
+#include "Chunk.hpp"
+#include "Pool.hpp"
+#include "VoxelShape.hpp"
+#include "VoxelTypes.hpp"
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <array>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <limits>
+
+const int chunkWidth  = 64;
+const int chunkHeight = 64;
+const int chunkDepth  = 64;
+
+using WorldChunk = Chunk<chunkWidth, chunkHeight, chunkDepth, uint8_t, 0>;
+
+struct RenderItem
+{
+	std::shared_ptr<WorldChunk> chunk;
+	glm::ivec3                  offset;
+};
+
+using RenderList = std::vector<RenderItem>;
+
+class Lighting;
+class BlockUpdates;
+
+namespace AsyncIo
+{
+	class File;
+}
+
+// Fills chunks in place of the terrain generator, called from generation jobs while the chunk's voxels are locked. A source backed by a file
+// names the rows of bytes each chunk is converted from, the world reads them through the AsyncIo lane and passes them to Fill packed
+class ChunkSource
+{
+public:
+	struct Tile
+	{
+		std::shared_ptr<const AsyncIo::File> file; // Not set if the chunk needs nothing read
+		uint64_t                             offset   = 0; // Of the first row
+		uint64_t                             rowSize  = 0;
+		uint64_t                             stride   = 0; // From one row to the next
+		uint64_t                             rowCount = 0;
+	};
+
+	virtual ~ChunkSource() = default;
+	virtual Tile GetTile(int x, int z) const { return {}; }
+	virtual void Fill(int x, int z, const uint8_t *tile, WorldChunk &chunk) = 0; // The tile's bytes, or nullptr if they were not read
+};
+
+// Streaming, culling and edits run on the world thread, which publishes a render list for the render thread to draw
+class World
+{
+public:
+	// Worlds that are never drawn can turn meshing off, their chunks go straight to Resident once they are lit
+	World(float loadDistance, float renderDistance, bool meshing = true);
+	~World();
+
+	void Start();
+	void Stop();
+
+	// Call before Start, saved chunks replace the generated terrain as they are loaded. Their voxels are read from the file then, through
+	// the AsyncIo lane, which must be running. Saves from before the save file had a directory are read whole here instead
+	bool Load(const char *fileName);
+	void SetChunkSource(std::shared_ptr<ChunkSource> source); // Chunks that were not saved come from the source instead of the generator
+	void SetSeed(uint32_t seed); // Call before Start, the generator's terrain differs for every seed and 0 is the one worlds had before seeds
+
+	// Call before Start, baked chunks that were not saved are read through the AsyncIo lane already lit and meshed instead of being generated.
+	// Takes the seed the chunks were baked with, and is ignored while a chunk source is set
+	bool LoadBake(const char *fileName);
+
+	// Fills a chunk with the generator's terrain, the chunk's voxels must be locked. Used by generation jobs and by the baker
+	static void GenerateTerrain(uint32_t seed, int x, int z, WorldChunk &chunk);
+
+	// Modified chunks are snapshotted at the next update and written on the job system, ignored while the previous save is still being written.
+	// Each chunk is saved as of that update, edits that are still being applied may be left out
+	void Save(const char *fileName);
+
+	// Called by the render thread
+	void SetCamera(const glm::vec3 &position);
+	void RemoveVoxel(const glm::vec3 &origin, const glm::vec3 &direction, float radius = 0.0f); // Removes the first solid voxel hit, or a sphere around it
+	void Advance(float seconds); // Block updates run at a fixed rate on the world thread, a few ticks at most per update
+	void SetViewers(const std::vector<glm::vec3> &positions); // Chunks are loaded around every viewer, or around the camera when there are none
+	void SetDistances(float loadDistance, float renderDistance); // Used from the next update, chunks beyond the new load distance are unloaded then
+
+	// Chunks stop being queued for generation while more jobs than this are waiting, so edits and remeshes are not stuck behind them. Unlimited if 0
+	void SetMaxQueuedJobs(size_t maxQueuedJobs);
+
+	// Edits are applied in order on the job system with one remesh per affected chunk per update, voxels in chunks that are not loaded are left untouched
+	void Edit(const VoxelShape &shape, uint8_t voxel);
+
+	// Safe on any thread, chunks that are not generated yet read as empty. The world thread cannot load or unload chunks while a query runs
+	uint64_t CountSolid(const VoxelShape &shape);
+	void ForEachSolid(const VoxelShape &shape, const std::function<void(const glm::ivec3 &position, uint8_t voxel)> &function);
+	bool GetSnapshot(int x, int z, WorldChunk::Snapshot &snapshot); // False if the chunk is not loaded or not generated yet
+	bool TryGetSnapshot(int x, int z, WorldChunk::Snapshot &snapshot, bool &busy); // Never waits, false with busy set if a lock it needs is held
+
+	// Called from jobs and the world thread with the positions, local to the chunk, whose voxels were edited or updated. Set before Start
+	using ChangeListener = std::function<void(int x, int z, const std::vector<glm::ivec3> &positions)>;
+	void SetChangeListener(ChangeListener listener);
+
+	const RenderList &AcquireRenderList();
+	void WaitForUpdate(); // Blocks until the world thread has processed all camera updates and edits sent so far
+private:
+	// Either a shape, or a pick ray that edits the first solid voxel it hits and a sphere of radius around it
+	struct PendingEdit
+	{
+		VoxelShape shape;
+		uint8_t    voxel;
+		bool       isPick;
+		glm::vec3  origin;
+		glm::vec3  direction;
+		float      radius;
+	};
+
+	struct ChunkEdit
+	{
+		std::shared_ptr<const VoxelShape> shape;
+		uint8_t                           voxel;
+	};
+
+	// Either decoded when the save was loaded, or the location of its runs in saveFile
+	struct SavedChunk
+	{
+		std::optional<WorldChunk::Snapshot> snapshot;
+		uint64_t                            offset   = 0;
+		uint32_t                            runCount = 0;
+	};
+
+	// Where a chunk's voxels, light and faces are in bakeFile
+	struct BakedChunk
+	{
+		uint64_t offset = 0;
+		uint32_t size   = 0;
+	};
+
+	float                loadDistance;   // Only the world thread reads these, they are copied from the requested ones at the start of each update
+	float                renderDistance;
+	const bool           meshing;
+	uint32_t             seed = 0;
+	std::atomic<size_t>  maxQueuedJobs{0};
+
+	Pool::Map<uint64_t, std::shared_ptr<WorldChunk>> chunks;     // Only the world thread changes the map, and only while holding chunksLock
+	std::shared_mutex                                chunksLock;
+	Pool::Map<uint64_t, std::vector<ChunkEdit>>      chunkEdits; // Waiting for their chunk to be settled, an empty list only remeshes
+	std::shared_ptr<Lighting>                        lighting;
+	std::shared_ptr<BlockUpdates>                    blockUpdates;
+	std::shared_ptr<ChunkSource>                     source;
+	std::map<uint64_t, SavedChunk>                   savedChunks; // Loaded from the save and not generated since, so every save includes them
+	std::shared_ptr<const AsyncIo::File>             saveFile;    // Kept open, so its chunks can still be read after a save replaces it
+	std::map<uint64_t, BakedChunk>                   bakedChunks; // Read from the bake whenever they are loaded, they match the generator so they can be unloaded
+	std::shared_ptr<const AsyncIo::File>             bakeFile;
+	std::shared_ptr<std::atomic<bool>>               saving;      // Set while a save is being written
+	ChangeListener                                   changeListener;
+	uint64_t tick          = 0;
+	bool     budgetLimited = false;
+
+	// Lowered while a budget is exceeded, chunks are only loaded nearer than the load limit and drawn within the render limit
+	static constexpr uint64_t limitInterval = 4; // Updates between changes to the limits
+	float                     loadLimit     = std::numeric_limits<float>::infinity();
+	float                     renderLimit   = std::numeric_limits<float>::infinity();
+	uint64_t                  limitTick     = 0;
+
+	std::thread              thread;
+	std::atomic<bool>        stop{false};
+	std::mutex               inputLock;
+	std::condition_variable  inputChanged;
+	std::condition_variable  updateFinished;
+	glm::vec3                cameraPosition  = {0.0f, 0.0f, 0.0f};
+	std::vector<glm::vec3>   viewers;
+	float                    requestedLoadDistance;
+	float                    requestedRenderDistance;
+	float                    blockTime       = 0.0f; // Simulated time not yet ticked
+	std::string              saveFileName;           // Save requested for the next update
+	std::vector<PendingEdit> edits;
+	bool                     inputPending    = false;
+	uint64_t                 requestedUpdate = 0;
+	uint64_t                 completedUpdate = 0;
+
+	static constexpr int maxBlockTicks = 4; // Time beyond this is dropped so a slow tick cannot fall further and further behind
+
+	// Triple buffered so neither thread ever waits on the other, the middle index carries a flag when it holds a list the render thread has not seen
+	static const int freshList = 4;
+
+	std::array<RenderList, 3> renderLists;
+	int                       writeIndex = 0;
+	int                       readIndex  = 1;
+	std::atomic<int>          middleIndex{2};
+
+	static uint64_t GetChunkIndex(int x, int z);
+	static glm::ivec3 GetChunkOrigin(uint64_t index);
+	static bool IsSettled(ChunkState state);
+	static bool BeginRemesh(WorldChunk &chunk);
+	static bool BeginEviction(WorldChunk &chunk);
+	static void ApplyChunkEdits(std::shared_ptr<WorldChunk> chunk, std::shared_ptr<Lighting> lighting, std::shared_ptr<BlockUpdates> blockUpdates, const ChangeListener &listener, const glm::ivec3 &origin, const std::vector<ChunkEdit> &edits);
+
+	void ThreadLoop();
+	void QueueEdit(const PendingEdit &edit);
+	void DispatchEdits();
+	void TickBlocks();
+	void StartSave(const std::string &fileName);
+	template<typename Function>
+	void VisitSolid(const VoxelShape &shape, Function &&function);
+	static float GetDistance(const std::vector<glm::vec3> &centers, int x, int z); // To the nearest center
+	void UnloadChunks(const std::vector<glm::vec3> &centers);
+	void EvictOverBudget(const std::vector<glm::vec3> &centers);
+	void RaiseBudgetLimits();
+	void LoadChunks(const std::vector<glm::vec3> &centers);
+	void ReadSavedChunk(std::shared_ptr<WorldChunk> chunk, const SavedChunk &saved, int x, int z);
+	void ReadBakedChunk(std::shared_ptr<WorldChunk> chunk, const BakedChunk &baked, int x, int z);
+	void ReadSourceTile(std::shared_ptr<WorldChunk> chunk, const ChunkSource::Tile &tile, int x, int z);
+	void PublishRenderList(const glm::vec3 &position);
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+// Times entity movement and terrain collision for a growing number of entities falling onto the terrain, built with -DBENCHMARKS=ON
+// Usage: EntityBenchmark [max entities] [updates per step]
+#include "Entities.hpp"
+#include "JobSystem.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+const float loadDistance = 256.0f;
+const float spawnRadius  = 200.0f;
+const float timestep     = 1.0f / 60.0f;
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()))];
+}
+
+int main(int argc, char **argv)
+{
+	const size_t maxEntities = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 40000;
+	const int    updates     = argc > 2 ? std::atoi(argv[2]) : 120;
+
+	Log::Initialize();
+	Log::SetMinimumSeverity(Log::Severity::Warning);
+	JobSystem::StartThreads();
+	World world(loadDistance, 0.0f, false);
+	world.Start();
+	for (int i = 0; i < 3; i++) {
+		world.SetCamera({0.0f, 0.0f, 0.0f});
+		world.WaitForUpdate();
+		JobSystem::WaitForIdle();
+	}
+
+	std::printf("%zu thread(s), %d updates of %.1fms per step\n\n", static_cast<size_t>(std::thread::hardware_concurrency()), updates, timestep * 1000.0f);
+	std::printf("%-10s %10s %10s %10s %12s\n", "Entities", "p50 (ms)", "p95 (ms)", "max (ms)", "Landed (%)");
+	for (size_t count = 1250; count <= maxEntities; count *= 2) {
+		// Scattered above the terrain and thrown in random directions, falling at a fixed speed
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> spread(-spawnRadius, spawnRadius);
+		std::uniform_real_distribution<float> speed(-8.0f, 8.0f);
+		Entities entities;
+		for (size_t i = 0; i < count; i++) {
+			const Entities::Id id = entities.Add({spread(random), 56.0f, spread(random)}, {0.4f, 0.9f, 0.4f});
+			entities.SetVelocity(id, {speed(random), -20.0f, speed(random)});
+		}
+
+		// Landed entities had their fall stopped by the terrain in the last update
+		std::vector<double> times;
+		size_t landed = 0;
+		for (int update = 0; update < updates; update++) {
+			const auto startTime = std::chrono::steady_clock::now();
+			entities.Update(world, timestep);
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+			landed = 0;
+			for (Entities::Id id = 0; id < count; id++) {
+				const glm::vec3 velocity = entities.GetVelocity(id);
+				if (velocity.y == 0.0f) landed++;
+				entities.SetVelocity(id, {velocity.x, -20.0f, velocity.z});
+			}
+		}
+		std::printf("%-10zu %10.3f %10.3f %10.3f %12.1f\n", count, Percentile(times, 0.5), Percentile(times, 0.95), *std::max_element(times.begin(), times.end()), 100.0 * landed / count);
+	}
+
+	world.Stop();
+	JobSystem::StopThreads();
+	Log::Cleanup();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+// Times random chunk sized reads through AsyncIo with io_uring and with the fallback threads, built with -DBENCHMARKS=ON
+// Usage: IoBenchmark [file] [reads] [read size]. The file is filled with 64MB of data first if it does not exist, a file that was
+// just written is in the page cache, so drop the cache first to time the disk rather than the submission overhead
+#include "AsyncIo.hpp"
+#include "JobSystem.hpp"
+#include "Log.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+static void Run(const char *fileName, bool allowUring, int reads, uint64_t readSize)
+{
+	AsyncIo::Start(allowUring);
+	const auto     file     = std::make_shared<AsyncIo::File>(fileName);
+	const uint64_t fileSize = std::filesystem::file_size(fileName);
+
+	std::atomic<uint64_t> checksum{0};
+	std::atomic<int>      failed{0};
+	std::mt19937_64       random(1);
+	const auto startTime = std::chrono::steady_clock::now();
+	for (int i = 0; i < reads; i++) {
+		const uint64_t offset = (random() % (fileSize / readSize)) * readSize;
+		AsyncIo::Read(file, offset, readSize, [&checksum, &failed](const uint8_t *data, uint64_t size) {
+			if (!data) {
+				failed++;
+				return;
+			}
+			checksum += data[0] + data[size - 1];
+		});
+	}
+	AsyncIo::WaitForIdle();
+	JobSystem::WaitForIdle();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::printf("%-8s %8.0f reads/s %8.1f MB/s, %d failed, checksum %llu\n", allowUring ? "io_uring" : "threads", reads / seconds,
+		reads * readSize / seconds / (1024.0 * 1024.0), failed.load(), static_cast<unsigned long long>(checksum.load()));
+	AsyncIo::LogReport();
+	AsyncIo::Stop();
+}
+
+int main(int argc, char **argv)
+{
+	const char    *fileName = argc > 1 ? argv[1] : "IoBenchmark.dat";
+	const int      reads    = argc > 2 ? std::atoi(argv[2]) : 100000;
+	const uint64_t readSize = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 16 * 1024;
+
+	Log::Initialize();
+	if (!std::filesystem::exists(fileName)) {
+		std::ofstream file(fileName, std::ios::binary);
+		std::vector<uint8_t> block(1024 * 1024);
+		for (int i = 0; i < 64; i++) {
+			for (size_t j = 0; j < block.size(); j++) block[j] = static_cast<uint8_t>(i + j);
+			file.write(reinterpret_cast<const char*>(block.data()), block.size());
+		}
+	}
+
+	JobSystem::StartThreads();
+	Run(fileName, true, reads, readSize);
+	Run(fileName, false, reads, readSize);
+	JobSystem::StopThreads();
+	Log::Cleanup();
+	return 0;
+}
\ No newline at end of file
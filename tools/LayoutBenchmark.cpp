@@ -0,0 +1,107 @@
+// Compares the chunk voxel layouts on meshing and on random access edits, built with -DBENCHMARKS=ON
+#include "Chunk.hpp"
+#include <glm/gtc/noise.hpp>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+const int width  = 64;
+const int height = 64;
+const int depth  = 64;
+
+const int meshIterations = 20;
+const int editCount      = 1 << 22;
+
+struct Result
+{
+	double meshTime;
+	double editTime;
+	double neighbourTime;
+	double stepTime;
+};
+
+static double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<template<int, int, int> class Layout>
+Result Run()
+{
+	using ChunkType = Chunk<width, height, depth, uint8_t, 0, Layout>;
+	auto chunk = std::make_unique<ChunkType>();
+	chunk->TransitionState(ChunkState::Queued, ChunkState::Generating);
+
+	// Same terrain as the world generator, plus caves so the mesher sees more than a heightmap
+	for (int z = 0; z < depth; z++) {
+		for (int x = 0; x < width; x++) {
+			const float noise = 12.0f + (24.0f * glm::simplex(glm::vec2(x / 512.0f, z / 512.0f))) + (12.0f * glm::simplex(glm::vec2(x / 64.0f, z / 64.0f)));
+			for (int y = 0; y <= noise + 2 && y < height; y++) {
+				if (glm::simplex(glm::vec3(x, y, z) / 16.0f) < 0.5f) chunk->SetVoxel(x, y, z, 1);
+			}
+		}
+	}
+	chunk->TransitionState(ChunkState::Generating, ChunkState::Meshing);
+
+	Result result = {};
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < meshIterations; i++) {
+		chunk->UpdateVertices();
+		chunk->TransitionState(ChunkState::ReadyToUpload, ChunkState::Meshing);
+	}
+	result.meshTime = Milliseconds(start) / meshIterations;
+
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int> distribution(0, width * height * depth - 1);
+	std::vector<glm::ivec3> positions(editCount);
+	for (glm::ivec3 &position : positions) {
+		const int value = distribution(random);
+		position = glm::ivec3(value % width, (value / width) % height, value / (width * height));
+	}
+
+	start = std::chrono::steady_clock::now();
+	for (const glm::ivec3 &position : positions) {
+		chunk->SetVoxel(position.x, position.y, position.z, chunk->TestPos(position.x, position.y, position.z) ? 0 : 1);
+	}
+	result.editTime = Milliseconds(start);
+
+	// Reads all six neighbours like lighting and flood fills do
+	uint64_t solidNeighbours = 0;
+	start = std::chrono::steady_clock::now();
+	for (const glm::ivec3 &position : positions) {
+		solidNeighbours += chunk->TestPos(position.x - 1, position.y, position.z) + chunk->TestPos(position.x + 1, position.y, position.z) +
+		                   chunk->TestPos(position.x, position.y - 1, position.z) + chunk->TestPos(position.x, position.y + 1, position.z) +
+		                   chunk->TestPos(position.x, position.y, position.z - 1) + chunk->TestPos(position.x, position.y, position.z + 1);
+	}
+	result.neighbourTime = Milliseconds(start);
+
+	// The same reads stepped to from the voxel's index through the layout, as the mesher does
+	start = std::chrono::steady_clock::now();
+	for (const glm::ivec3 &position : positions) {
+		const uint64_t index = ChunkType::VoxelLayout::Index(position.x, position.y, position.z);
+		for (int face = 0; face < static_cast<int>(Face::Count); face++) {
+			solidNeighbours += chunk->TestNeighbour(index, position.x, position.y, position.z, static_cast<Face>(face));
+		}
+	}
+	result.stepTime = Milliseconds(start);
+	if (solidNeighbours == UINT64_MAX) std::printf("\n"); // Keeps the loops from being optimised out
+	return result;
+}
+
+static void Print(const char *name, const Result &result)
+{
+	std::printf("%-8s %10.3f %12.3f %16.3f %12.3f\n", name, result.meshTime, result.editTime, result.neighbourTime, result.stepTime);
+}
+
+int main()
+{
+	std::printf("%dx%dx%d chunk, mesh time is per chunk, edit and neighbour times are for %d random positions\n\n", width, height, depth, editCount);
+	std::printf("%-8s %10s %12s %16s %12s\n", "Layout", "Mesh (ms)", "Edits (ms)", "Neighbours (ms)", "Steps (ms)");
+	Print("Linear",  Run<LinearLayout>());
+	Print("Morton",  Run<MortonLayout>());
+	Print("Brick4",  Run<Brick4Layout>());
+	Print("Brick8",  Run<Brick8Layout>());
+	return 0;
+}
\ No newline at end of file
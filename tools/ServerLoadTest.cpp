@@ -0,0 +1,202 @@
+// Connects a growing number of clients to a running VoxelServer and reports bandwidth and latency per client, built with -DBENCHMARKS=ON
+// Usage: ServerLoadTest [port] [max clients] [seconds per step]
+#include "ServerProtocol.hpp"
+#include <glm/vec3.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using ServerProtocol::MessageType;
+
+const int   chunkSize      = 64;
+const float clientRadius   = 160.0f;
+const float clientSpeed    = 16.0f; // Units per second along x
+const int   pingInterval   = 100;   // Milliseconds
+const int   editInterval   = 250;
+const int   moveInterval   = 100;
+
+struct Stats
+{
+	uint64_t              bytes  = 0;
+	uint64_t              chunks = 0;
+	uint64_t              deltas = 0;
+	double                firstChunkTime = 0.0; // Milliseconds from connecting
+	std::vector<double>   pings;                // Round trips in milliseconds
+	std::vector<double>   edits;                // From sending an edit to receiving its delta
+	bool                  failed = false;
+};
+
+static uint64_t Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void Send(int connection, MessageType type, const void *data, uint32_t size)
+{
+	std::vector<uint8_t> message(sizeof(ServerProtocol::MessageHeader) + size);
+	const ServerProtocol::MessageHeader header = {static_cast<uint8_t>(type), size};
+	memcpy(message.data(), &header, sizeof(header));
+	memcpy(message.data() + sizeof(header), data, size);
+	send(connection, message.data(), message.size(), MSG_NOSIGNAL);
+}
+
+// Each client flies along x from its own start and toggles a voxel above the terrain in front of it
+static void RunClient(uint16_t port, int index, int seconds, Stats &stats)
+{
+	const int connection = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		stats.failed = true;
+		close(connection);
+		return;
+	}
+	const int noDelay = 1;
+	setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+	timeval timeout = {0, 10000};
+	setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	const uint64_t start = Now();
+	const uint64_t end   = start + (seconds * 1000000000ull);
+	glm::vec3 position(index * 96.0f, 60.0f, (index % 2) * 96.0f);
+	uint64_t   lastPing = 0, lastEdit = 0, lastMove = 0;
+	int        editCount = 0;
+	glm::ivec3 target;
+
+	struct PendingEdit
+	{
+		glm::ivec3 position;
+		uint8_t    voxel;
+		uint64_t   time;
+	};
+	std::vector<PendingEdit> pendingEdits;
+	std::vector<uint8_t>     input;
+	uint8_t                  buffer[65536];
+
+	while (Now() < end) {
+		const uint64_t now = Now();
+		if (now - lastMove >= moveInterval * 1000000ull) {
+			position.x += clientSpeed * (now - lastMove) / 1e9f * (lastMove != 0);
+			const ServerProtocol::PositionMessage message = {position.x, position.y, position.z, clientRadius};
+			Send(connection, MessageType::Position, &message, sizeof(message));
+			lastMove = now;
+		}
+		if (now - lastPing >= pingInterval * 1000000ull) {
+			const ServerProtocol::PingMessage message = {now};
+			Send(connection, MessageType::Ping, &message, sizeof(message));
+			lastPing = now;
+		}
+		if (stats.chunks > 0 && now - lastEdit >= editInterval * 1000000ull) {
+			// Every other edit clears the voxel the one before placed, so each of them changes something
+			if (editCount % 2 == 0) target = glm::ivec3(static_cast<int>(position.x), 62, static_cast<int>(position.z));
+			const uint8_t voxel = editCount % 2 == 0 ? 1 : 0;
+			const ServerProtocol::EditMessage message = {target.x, target.y, target.z, target.x + 1, target.y + 1, target.z + 1, voxel, {}};
+			Send(connection, MessageType::Edit, &message, sizeof(message));
+			pendingEdits.push_back({target, voxel, now});
+			lastEdit = now;
+			editCount++;
+		}
+
+		const ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+		if (received == 0) break;
+		if (received < 0) continue;
+		stats.bytes += received;
+		input.insert(input.end(), buffer, buffer + received);
+
+		size_t offset = 0;
+		while (input.size() - offset >= sizeof(ServerProtocol::MessageHeader)) {
+			ServerProtocol::MessageHeader header;
+			memcpy(&header, input.data() + offset, sizeof(header));
+			if (input.size() - offset - sizeof(header) < header.length) break;
+			const uint8_t *payload = input.data() + offset + sizeof(header);
+			const uint64_t arrival = Now();
+			switch (static_cast<MessageType>(header.type)) {
+				case MessageType::Chunk:
+					if (stats.chunks++ == 0) stats.firstChunkTime = (arrival - start) / 1e6;
+					break;
+				case MessageType::Pong: {
+					ServerProtocol::PingMessage message;
+					memcpy(&message, payload, sizeof(message));
+					stats.pings.push_back((arrival - message.time) / 1e6);
+					break;
+				}
+				case MessageType::Delta: {
+					ServerProtocol::DeltaMessage message;
+					memcpy(&message, payload, sizeof(message));
+					stats.deltas++;
+					for (uint32_t i = 0; i < message.count; i++) {
+						ServerProtocol::VoxelChange change;
+						memcpy(&change, payload + sizeof(message) + (i * sizeof(change)), sizeof(change));
+						const glm::ivec3 world(message.x * chunkSize + change.x, change.y, message.z * chunkSize + change.z);
+						for (auto it = pendingEdits.begin(); it != pendingEdits.end(); it++) {
+							if (it->position != world || it->voxel != change.voxel) continue;
+							stats.edits.push_back((arrival - it->time) / 1e6);
+							pendingEdits.erase(it);
+							break;
+						}
+					}
+					break;
+				}
+				default:
+					break;
+			}
+			offset += sizeof(header) + header.length;
+		}
+		input.erase(input.begin(), input.begin() + offset);
+	}
+	close(connection);
+}
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+	if (values.empty()) return 0.0;
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<size_t>(percentile * values.size()))];
+}
+
+int main(int argc, char **argv)
+{
+	const uint16_t port       = argc > 1 ? static_cast<uint16_t>(std::stoi(argv[1])) : ServerProtocol::defaultPort;
+	const int      maxClients = argc > 2 ? std::stoi(argv[2]) : 8;
+	const int      seconds    = argc > 3 ? std::stoi(argv[3]) : 10;
+
+	std::printf("Clients fly at %.0f units/s with a %.0f unit radius, values are per client\n\n", clientSpeed, clientRadius);
+	std::printf("%-8s %12s %8s %8s %14s %10s %10s %10s %10s\n", "Clients", "KB/s", "Chunks", "Deltas", "First (ms)", "Ping p50", "Ping p95", "Edit p50", "Edit p95");
+	for (int clientCount = 1; clientCount <= maxClients; clientCount *= 2) {
+		std::vector<Stats>       stats(clientCount);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < clientCount; i++) threads.emplace_back(RunClient, port, i, seconds, std::ref(stats[i]));
+		for (std::thread &thread : threads) thread.join();
+
+		Stats total;
+		for (const Stats &client : stats) {
+			if (client.failed) {
+				std::printf("Failed to connect to port %d\n", port);
+				return 1;
+			}
+			total.bytes          += client.bytes;
+			total.chunks         += client.chunks;
+			total.deltas         += client.deltas;
+			total.firstChunkTime += client.firstChunkTime;
+			total.pings.insert(total.pings.end(), client.pings.begin(), client.pings.end());
+			total.edits.insert(total.edits.end(), client.edits.begin(), client.edits.end());
+		}
+		std::printf("%-8d %12.1f %8llu %8llu %14.1f %10.2f %10.2f %10.2f %10.2f\n", clientCount,
+			total.bytes / 1024.0 / seconds / clientCount, (unsigned long long)(total.chunks / clientCount), (unsigned long long)(total.deltas / clientCount),
+			total.firstChunkTime / clientCount, Percentile(total.pings, 0.5), Percentile(total.pings, 0.95), Percentile(total.edits, 0.5), Percentile(total.edits, 0.95));
+	}
+	return 0;
+}
\ No newline at end of file